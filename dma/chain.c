@@ -0,0 +1,240 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup dma */
+/*@{*/
+
+/** \file
+	Software chaining of DMA segments.
+	
+	dsPIC33F DMA channels transfer one block, or two in ping-pong mode.
+	A DMA chain sends or receives a list of segments from different buffers, for instance a header,
+	a payload and a CRC, without copying them into one buffer: when a segment is completed,
+	the DMA interrupt immediately programs the next one and re-enables the channel.
+	
+	The channel must be configured with dma_init_channel() in \ref DMA_OPERATING_ONE_SHOT mode,
+	with \ref DMA_INTERRUPT_AT_FULL and with dma_chain_interrupt() as callback; buffers passed to dma_init_channel() are ignored.
+	
+	\code
+	static const DMA_Descriptor packet[] = {
+		{ header, sizeof(header) },
+		{ payload, sizeof(payload) },
+		{ crc, sizeof(crc) },
+	};
+	
+	dma_init_channel(DMA_CHANNEL_3, DMA_INTERRUPT_SOURCE_UART_1_TX, DMA_SIZE_BYTE, DMA_DIR_FROM_RAM_TO_PERIPHERAL,
+		DMA_INTERRUPT_AT_FULL, DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL, DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT,
+		DMA_OPERATING_ONE_SHOT, 0, 0, (void*)&U1TXREG, 1, dma_chain_interrupt);
+	dma_chain_start(&chain, DMA_CHANNEL_3, packet, 3, false, true, packet_sent, 0);
+	\endcode
+	
+	A circular chain restarts at its first segment after the last one, until dma_chain_stop().
+	
+	Between two segments, the peripheral waits for the DMA interrupt to reprogram the channel,
+	so the priority of the DMA channel must be high enough for this gap to be acceptable.
+	
+	The channel registers are accessed through \ref DMA_CHANNEL_REGISTERS, which a host register model
+	can redefine to run this file off-target; tests/dma-chain-test.c does so on the host (make -C tests check).
+	
+	The chain holds the idle mode lock of Errata 38, taken by dma_enable_channel() in dma_chain_start(),
+	until it is done or stopped.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "dma.h"
+#include "../error/error.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Chain running on each DMA channel, 0 if none */
+static DMA_Chain* DMA_Chains[DMA_CHANNELS_COUNT];
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Program a segment into a disabled channel and enable it */
+static void program_segment(DMA_Chain* chain, const DMA_Descriptor* descriptor)
+{
+	DMA_Channel_Registers* registers = DMA_CHANNEL_REGISTERS(chain->channel);
+	
+	registers->sta = (unsigned int)descriptor->buffer - (unsigned int)&_DMA_BASE;
+	registers->cnt = descriptor->count - 1;
+	registers->con |= DMA_CON_CHEN;
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Start a DMA chain.
+	
+	\param	chain
+			Chain storage, owned by the caller, must remain valid until the chain is done or stopped.
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7, configured as described in the \ref dma documentation.
+	\param	descriptors
+			Segments, must remain valid until the chain is done or stopped. Their buffers must be inside the DMA memory.
+	\param	count
+			Number of segments.
+	\param	circular
+			If true, restart at the first segment after the last one.
+	\param	force
+			If true, force the first transfer of the chain. Required when the peripheral does not request
+			a new transfer by itself, for instance when transmitting on an idle UART.
+			Later segments are not forced: the peripheral, busy with the previous segment, requests them,
+			and forcing them could overrun it, for instance a full UART transmit FIFO.
+	\param	done
+			Function to call when the last segment is completed, may be 0.
+	\param	user_data
+			Argument passed to done.
+*/
+void dma_chain_start(DMA_Chain* chain, int channel, const DMA_Descriptor* descriptors, unsigned int count, bool circular, bool force, dma_chain_callback done, void* user_data)
+{
+	unsigned int i;
+	
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	if (count == 0)
+		ERROR(DMA_ERROR_INVALID_DESCRIPTOR, &count);
+	for (i = 0; i < count; i++)
+	{
+		if (descriptors[i].count == 0)
+			ERROR(DMA_ERROR_INVALID_DESCRIPTOR, &i);
+		if ((unsigned int)descriptors[i].buffer < (unsigned int)&_DMA_BASE)
+			ERROR(DMA_ERROR_INVALID_ADDRESS, (void*)&descriptors[i].buffer);
+	}
+	
+	// A chain still running holds an idle mode lock (Errata 38) through dma_enable_channel(), release it;
+	// otherwise just make sure the channel is off, without touching the lock count
+	if (DMA_Chains[channel] && DMA_Chains[channel]->busy)
+		dma_chain_stop(DMA_Chains[channel]);
+	else
+		DMA_CHANNEL_REGISTERS(channel)->con &= ~DMA_CON_CHEN;
+	
+	chain->descriptors = descriptors;
+	chain->count = count;
+	chain->index = 0;
+	chain->channel = channel;
+	chain->circular = circular;
+	chain->busy = true;
+	chain->done = done;
+	chain->user_data = user_data;
+	chain->segments = 0;
+	DMA_Chains[channel] = chain;
+	
+	DMA_CHANNEL_REGISTERS(channel)->sta = (unsigned int)descriptors[0].buffer - (unsigned int)&_DMA_BASE;
+	DMA_CHANNEL_REGISTERS(channel)->cnt = descriptors[0].count - 1;
+	// Go through dma_enable_channel() for the idle errata handling
+	dma_enable_channel(channel);
+	if (force)
+		dma_start_transfer(channel);
+}
+
+/**
+	Stop a DMA chain, the segment in progress is aborted.
+	
+	Does nothing if the chain is not busy.
+	
+	\param	chain
+			Chain to stop.
+*/
+void dma_chain_stop(DMA_Chain* chain)
+{
+	if (!chain->busy)
+		return;
+	
+	dma_disable_channel(chain->channel);
+	DMA_Chains[chain->channel] = 0;
+	chain->busy = false;
+}
+
+/**
+	Return whether a chain is still transferring.
+	
+	\param	chain
+			Chain to query.
+	\return	true until the last segment of a one-shot chain is completed, or until the chain is stopped.
+*/
+bool dma_chain_is_busy(DMA_Chain* chain)
+{
+	return chain->busy;
+}
+
+/**
+	DMA callback of the channels running a chain.
+	
+	Pass this function as callback to dma_init_channel(). Do not call it directly.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+	\param	first_buffer
+			Unused, chains do not use ping-pong mode.
+*/
+void dma_chain_interrupt(int channel, bool first_buffer)
+{
+	DMA_Chain* chain = DMA_Chains[channel];
+	
+	if (!chain)
+		return;
+	
+	chain->segments++;
+	chain->index++;
+	if (chain->index == chain->count)
+	{
+		chain->index = 0;
+		if (!chain->circular)
+		{
+			// The channel is already off, this releases the idle mode lock taken by dma_chain_start()
+			dma_disable_channel(channel);
+			DMA_Chains[channel] = 0;
+			chain->busy = false;
+			if (chain->done)
+				chain->done(chain, chain->user_data);
+			return;
+		}
+	}
+	
+	// Reprogram first, the peripheral is waiting
+	program_segment(chain, &chain->descriptors[chain->index]);
+	
+	if (chain->index == 0 && chain->done)
+		chain->done(chain, chain->user_data);
+}
+
+/*@}*/
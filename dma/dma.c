@@ -31,6 +31,12 @@
 	
 	Wrapper around DMA, with a callback oriented interface.
 	
+	Each channel is owned by the request source it was initialized with, so that two drivers
+	configured on the same channel are detected by dma_init_channel() instead of on the bench.
+	Drivers can also ask for a free channel with dma_allocate_channel(), and give it back with dma_release_channel().
+	The number of interrupts served and the worst duration of the callback are recorded per channel,
+	see dma_get_channel_statistics().
+	
 	Device specific configurations are implemented in their respective modules.
 */
 /*@{*/
@@ -73,6 +79,15 @@ switch (channel)
 static dma_callback DMA_Data[8];
 /* Keep track of which buffer is used for ping-pong mode */
 static unsigned char pingpong_dma[8];
+/** Request source owning each channel, or DMA_CHANNEL_FREE */
+static int DMA_Owner[DMA_CHANNELS_COUNT] = {
+	DMA_CHANNEL_FREE, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE,
+	DMA_CHANNEL_FREE, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE
+};
+/** Activity statistics of each channel */
+static DMA_Channel_Statistics DMA_Statistics[DMA_CHANNELS_COUNT];
+/** Source of time to measure the callbacks, 0 if not measured */
+static dma_time_source DMA_Time_Source;
 
 
 //-------------------
@@ -93,6 +108,70 @@ static unsigned int get_offset(void * addr, unsigned int size)
 	return offset;
 }
 
+/** Throw an error if request_source is not one of dma_requests_sources */
+static void check_request_source(int request_source)
+{
+	if (!(
+		request_source == DMA_INTERRUPT_SOURCE_INT_0 ||
+		request_source == DMA_INTERRUPT_SOURCE_IC_1 ||
+		request_source == DMA_INTERRUPT_SOURCE_OC_1 ||
+		request_source == DMA_INTERRUPT_SOURCE_IC_2 ||
+		request_source == DMA_INTERRUPT_SOURCE_OC_2 ||
+		request_source == DMA_INTERRUPT_SOURCE_TIMER_2 ||
+		request_source == DMA_INTERRUPT_SOURCE_TIMER_3 ||
+		request_source == DMA_INTERRUPT_SOURCE_SPI_1 ||
+		request_source == DMA_INTERRUPT_SOURCE_UART_1_RX ||
+		request_source == DMA_INTERRUPT_SOURCE_UART_1_TX ||
+		request_source == DMA_INTERRUPT_SOURCE_ADC_1 ||
+		request_source == DMA_INTERRUPT_SOURCE_ADC_2 ||
+		request_source == DMA_INTERRUPT_SOURCE_UART_2_RX ||
+		request_source == DMA_INTERRUPT_SOURCE_UART_2_TX ||
+		request_source == DMA_INTERRUPT_SOURCE_SPI_2 ||
+		request_source == DMA_INTERRUPT_SOURCE_ECAN_1_RX ||
+		request_source == DMA_INTERRUPT_SOURCE_ECAN_2_RX ||
+		request_source == DMA_INTERRUPT_SOURCE_DCI ||
+		request_source == DMA_INTERRUPT_SOURCE_ECAN_1_TX ||
+		request_source == DMA_INTERRUPT_SOURCE_ECAN_2_TX ||
+		request_source == DMA_INTERRUPT_SOURCE_DAC1_RC ||
+		request_source == DMA_INTERRUPT_SOURCE_DAC1_LC
+	))
+		ERROR(DMA_ERROR_INVALID_REQUEST_SOURCE, &request_source);
+}
+
+/** Give channel to request_source, throw an error if it is used by another request source */
+static void claim_channel(int channel, int request_source)
+{
+	if (DMA_Owner[channel] != DMA_CHANNEL_FREE && DMA_Owner[channel] != request_source)
+		ERROR(DMA_ERROR_CHANNEL_IN_USE, &channel);
+	DMA_Owner[channel] = request_source;
+}
+
+/** Call the user-defined function of channel from its interrupt, and update its statistics */
+static inline void dispatch(int channel)
+{
+	unsigned int start = 0;
+	unsigned int duration;
+	bool first_buffer;
+	
+	if (DMA_Time_Source)
+		start = DMA_Time_Source();
+	
+	// Toggle before the call, the callback may lower the IPL and let the next interrupt of this channel nest
+	first_buffer = pingpong_dma[channel] == 0;
+	pingpong_dma[channel] ^= 1;
+	
+	// Call use-defined function with true as argument if first buffer, false if second buffer
+	DMA_Data[channel](channel, first_buffer);
+	
+	DMA_Statistics[channel].completions++;
+	if (DMA_Time_Source)
+	{
+		duration = DMA_Time_Source() - start;
+		if (duration > DMA_Statistics[channel].max_callback_time)
+			DMA_Statistics[channel].max_callback_time = duration;
+	}
+}
+
 
 //-------------------
 // Exported functions
@@ -104,6 +183,9 @@ static unsigned int get_offset(void * addr, unsigned int size)
 	This function disable the channel if it was previously enabled, but does not re-enable it.
 	You must call dma_enable_channel() after this call to do so.
 	
+	The channel becomes owned by request_source; if it is already owned by another request source,
+	an error is thrown, call dma_release_channel() before reusing a channel for another peripheral.
+	
 	\param	channel
 			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
 	\param	request_source
@@ -135,30 +217,8 @@ static unsigned int get_offset(void * addr, unsigned int size)
 void dma_init_channel(int channel, int request_source, int data_size, int transfer_dir, int interrupt_pos, int null_write, int addressing_mode, int operating_mode, void * a, void * b, void* peripheral_address, unsigned transfer_count, dma_callback callback)
 {
 	// validate arguments
-	if (request_source != DMA_INTERRUPT_SOURCE_INT_0 &&
-		request_source != DMA_INTERRUPT_SOURCE_IC_1 &&
-		request_source != DMA_INTERRUPT_SOURCE_OC_1 &&
-		request_source != DMA_INTERRUPT_SOURCE_IC_2 &&
-		request_source != DMA_INTERRUPT_SOURCE_OC_2 &&
-		request_source != DMA_INTERRUPT_SOURCE_TIMER_2 &&
-		request_source != DMA_INTERRUPT_SOURCE_TIMER_3 &&
-		request_source != DMA_INTERRUPT_SOURCE_SPI_1 &&
-		request_source != DMA_INTERRUPT_SOURCE_UART_1_RX &&
-		request_source != DMA_INTERRUPT_SOURCE_UART_1_TX &&
-		request_source != DMA_INTERRUPT_SOURCE_ADC_1 &&
-		request_source != DMA_INTERRUPT_SOURCE_ADC_2 &&
-		request_source != DMA_INTERRUPT_SOURCE_UART_2_RX &&
-		request_source != DMA_INTERRUPT_SOURCE_UART_2_TX &&
-		request_source != DMA_INTERRUPT_SOURCE_SPI_2 &&
-		request_source != DMA_INTERRUPT_SOURCE_ECAN_1_RX &&
-		request_source != DMA_INTERRUPT_SOURCE_ECAN_2_RX &&
-		request_source != DMA_INTERRUPT_SOURCE_DCI &&
-		request_source != DMA_INTERRUPT_SOURCE_ECAN_1_TX &&
-		request_source != DMA_INTERRUPT_SOURCE_ECAN_2_TX &&
-		request_source != DMA_INTERRUPT_SOURCE_DAC1_RC && 
-		request_source != DMA_INTERRUPT_SOURCE_DAC1_LC
-	)
-		ERROR(DMA_ERROR_INVALID_REQUEST_SOURCE, &request_source);
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	check_request_source(request_source);
 	
 	ERROR_CHECK_RANGE(data_size, 0, 1, DMA_ERROR_INVALID_DATA_SIZE);
 	ERROR_CHECK_RANGE(transfer_dir , 0, 1, DMA_ERROR_INVALID_TRANSFER_DIRECTION);
@@ -166,6 +226,7 @@ void dma_init_channel(int channel, int request_source, int data_size, int transf
 	ERROR_CHECK_RANGE(null_write, 0, 1, DMA_ERROR_INVALID_WRITE_NULL_MODE);
 	ERROR_CHECK_RANGE(addressing_mode, 0, 2, DMA_ERROR_INVALID_ADDRESSING_MODE);
 	ERROR_CHECK_RANGE(operating_mode, 0, 3, DMA_ERROR_INVALID_OPERATING_MODE);
+	claim_channel(channel, request_source);
 	
 
 	// setup DMA
@@ -344,7 +405,7 @@ void dma_init_channel(int channel, int request_source, int data_size, int transf
 			_DMA5IF = 0;
 			if (callback)
 			{
-				DMA_Data[0] = callback;
+				DMA_Data[5] = callback;
 				_DMA5IE = 1;
 			}
 			else
@@ -606,6 +667,147 @@ void dma_set_priority(int channel, int prio) {
 
 }
 
+/**
+	Allocate a free DMA channel to a request source.
+	
+	Drivers can use this function instead of hard-coding channel numbers.
+	The returned channel is then configured with dma_init_channel() using the same request source.
+	Channels are given from \ref DMA_CHANNEL_7 downwards, so that they are unlikely to conflict with hard-coded ones.
+	
+	\param	request_source
+			Source of requests that will use the channel, one of \ref dma_requests_sources
+	\return	The allocated channel. If no channel is free, an error is thrown.
+*/
+int dma_allocate_channel(int request_source)
+{
+	int channel;
+	
+	check_request_source(request_source);
+	
+	for (channel = DMA_CHANNEL_7; channel >= DMA_CHANNEL_0; channel--)
+	{
+		if (DMA_Owner[channel] == DMA_CHANNEL_FREE)
+		{
+			DMA_Owner[channel] = request_source;
+			return channel;
+		}
+	}
+	
+	ERROR(DMA_ERROR_NO_FREE_CHANNEL, &request_source);
+	return DMA_CHANNEL_FREE;
+}
+
+/**
+	Release a DMA channel, so that another request source can use it.
+	
+	The channel and its interrupt are disabled.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+*/
+void dma_release_channel(int channel)
+{
+	dma_disable_channel(channel);
+	
+	switch (channel)
+	{
+		case DMA_CHANNEL_0: _DMA0IE = 0; break;
+		case DMA_CHANNEL_1: _DMA1IE = 0; break;
+		case DMA_CHANNEL_2: _DMA2IE = 0; break;
+		case DMA_CHANNEL_3: _DMA3IE = 0; break;
+		case DMA_CHANNEL_4: _DMA4IE = 0; break;
+		case DMA_CHANNEL_5: _DMA5IE = 0; break;
+		case DMA_CHANNEL_6: _DMA6IE = 0; break;
+		case DMA_CHANNEL_7: _DMA7IE = 0; break;
+		default: ERROR(DMA_ERROR_INVALID_CHANNEL, &channel);
+	}
+	
+	DMA_Owner[channel] = DMA_CHANNEL_FREE;
+}
+
+/**
+	Return the request source using a DMA channel.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+	\return	One of \ref dma_requests_sources, or \ref DMA_CHANNEL_FREE if the channel is not used.
+*/
+int dma_get_channel_owner(int channel)
+{
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	
+	return DMA_Owner[channel];
+}
+
+/**
+	Return which DMA channels are in use.
+	
+	\return	A bit mask, bit n being set if channel n is used by a request source.
+*/
+unsigned char dma_get_used_channels(void)
+{
+	unsigned char used = 0;
+	int channel;
+	
+	for (channel = DMA_CHANNEL_0; channel <= DMA_CHANNEL_7; channel++)
+		if (DMA_Owner[channel] != DMA_CHANNEL_FREE)
+			used |= 1 << channel;
+	
+	return used;
+}
+
+/**
+	Set the source of time used to measure the duration of DMA callbacks.
+	
+	For instance, a function returning the value of a free-running timer.
+	The measure includes the call to the time source itself.
+	
+	\param	source
+			Function returning the current time, or 0 to stop measuring.
+*/
+void dma_set_time_source(dma_time_source source)
+{
+	DMA_Time_Source = source;
+}
+
+/**
+	Get the activity statistics of a DMA channel.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+	\param	statistics
+			Structure to fill.
+*/
+void dma_get_channel_statistics(int channel, DMA_Channel_Statistics* statistics)
+{
+	int flags;
+	
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	
+	// The interrupt may update the statistics while we copy them
+	RAISE_IPL(flags, 7);
+	*statistics = DMA_Statistics[channel];
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Clear the activity statistics of a DMA channel.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+*/
+void dma_reset_channel_statistics(int channel)
+{
+	int flags;
+	
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	
+	RAISE_IPL(flags, 7);
+	DMA_Statistics[channel].completions = 0;
+	DMA_Statistics[channel].max_callback_time = 0;
+	IRQ_ENABLE(flags);
+}
+
 //--------------------------
 // Interrupt service routine
 //--------------------------
@@ -620,9 +822,7 @@ void _ISR  _DMA0Interrupt(void)
 	// Clear interrupt flag
 	_DMA0IF = 0;	
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[0](DMA_CHANNEL_0, pingpong_dma[0] == 0);
-	pingpong_dma[0] ^= 1;
+	dispatch(DMA_CHANNEL_0);
 	
 }
 
@@ -636,9 +836,7 @@ void _ISR  _DMA1Interrupt(void)
 	// Clear interrupt flag
 	_DMA1IF = 0;
 	
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[1](DMA_CHANNEL_1, pingpong_dma[1] == 0);
-	pingpong_dma[1] ^= 1;
+	dispatch(DMA_CHANNEL_1);
 }
 
 /**
@@ -651,9 +849,7 @@ void _ISR  _DMA2Interrupt(void)
 	// Clear interrupt flag
 	_DMA2IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[2](DMA_CHANNEL_2, pingpong_dma[2] == 0);
-	pingpong_dma[2] ^= 1;
+	dispatch(DMA_CHANNEL_2);
 }
 
 /**
@@ -666,9 +862,7 @@ void _ISR  _DMA3Interrupt(void)
 	// Clear interrupt flag
 	_DMA3IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[3](DMA_CHANNEL_3, pingpong_dma[3] == 0);
-	pingpong_dma[3] ^= 1;
+	dispatch(DMA_CHANNEL_3);
 }
 
 /**
@@ -681,9 +875,7 @@ void _ISR  _DMA4Interrupt(void)
 	// Clear interrupt flag
 	_DMA4IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[4](DMA_CHANNEL_4, pingpong_dma[4] == 0);
-	pingpong_dma[4] ^= 1;
+	dispatch(DMA_CHANNEL_4);
 }
 
 /**
@@ -696,9 +888,7 @@ void _ISR  _DMA5Interrupt(void)
 	// Clear interrupt flag
 	_DMA5IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[5](DMA_CHANNEL_5, pingpong_dma[5] == 0);
-	pingpong_dma[5] ^= 1;
+	dispatch(DMA_CHANNEL_5);
 }
 
 /**
@@ -711,9 +901,7 @@ void _ISR  _DMA6Interrupt(void)
 	// Clear interrupt flag
 	_DMA6IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[6](DMA_CHANNEL_6, pingpong_dma[6] == 0);
-	pingpong_dma[6] ^= 1;
+	dispatch(DMA_CHANNEL_6);
 }
 
 /**
@@ -726,9 +914,7 @@ void _ISR  _DMA7Interrupt(void)
 	// Clear interrupt flag
 	_DMA7IF = 0;
 
-	// Call use-defined function with true as argument if first buffer, false if second buffer
-	DMA_Data[7](DMA_CHANNEL_7, pingpong_dma[7] == 0);
-	pingpong_dma[7] ^= 1;
+	dispatch(DMA_CHANNEL_7);
 }
 
 /*@}*/
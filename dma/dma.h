@@ -48,7 +48,13 @@ enum dma_errors
 	DMA_ERROR_INVALID_WRITE_NULL_MODE,		/**< The specified null data write mode is not one of dma_null_data_peripheral_write_mode_select. */
 	DMA_ERROR_INVALID_ADDRESSING_MODE,		/**< The specified addressing mode is not one of dma_addressing_mode. */
 	DMA_ERROR_INVALID_OPERATING_MODE,		/**< The specified operating mode is not one of dma_operating_mode. */
-	DMA_ERROR_INVALID_ADDRESS				/**< The specified address is not a DMA address. Declare your dma storage space with __attribute__((space(dma))) */
+	DMA_ERROR_INVALID_ADDRESS,				/**< The specified address is not a DMA address. Declare your dma storage space with __attribute__((space(dma))) */
+	DMA_ERROR_INVALID_ALIGNMENT,			/**< The requested alignment is not a power of two */
+	DMA_ERROR_OUT_OF_MEMORY,				/**< There is not enough free space in the DMA memory arena */
+	DMA_ERROR_ARENA_NOT_INITIALIZED,		/**< dma_memory_init() was not called */
+	DMA_ERROR_CHANNEL_IN_USE,				/**< The specified DMA channel is already used by another request source. Call dma_release_channel() first */
+	DMA_ERROR_NO_FREE_CHANNEL,				/**< All DMA channels are in use */
+	DMA_ERROR_INVALID_DESCRIPTOR,			/**< A DMA chain is empty or has an empty segment */
 };
 	
 
@@ -65,6 +71,12 @@ enum dma_channels_identifiers
 	DMA_CHANNEL_7,							/**< DMA channel 7 */
 };
 
+/** Number of DMA channels */
+#define DMA_CHANNELS_COUNT 8
+
+/** Owner of a DMA channel not used by any request source, returned by dma_get_channel_owner() */
+#define DMA_CHANNEL_FREE -1
+
 /** Sources of requests that can initiate DMA. */
 enum dma_requests_sources
 {
@@ -137,9 +149,111 @@ enum dma_operating_mode
 	DMA_OPERATING_ONE_SHOT_PING_PONG = 3,					/**< One-Shot, Ping-Pong modes enabled (one block transfer from/to each DMA RAM buffer) */
 };
 
+/** Registers of a DMA channel, in their memory order, to reprogram a configured channel without dma_init_channel() */
+typedef struct
+{
+	volatile unsigned int con;		/**< DMAxCON */
+	volatile unsigned int req;		/**< DMAxREQ */
+	volatile unsigned int sta;		/**< DMAxSTA */
+	volatile unsigned int stb;		/**< DMAxSTB */
+	volatile unsigned int pad;		/**< DMAxPAD */
+	volatile unsigned int cnt;		/**< DMAxCNT */
+} DMA_Channel_Registers;
+
+#ifndef DMA_CHANNEL_REGISTERS
+/** Registers of a DMA channel; the channels are contiguous in the SFR space */
+#define DMA_CHANNEL_REGISTERS(channel) (((DMA_Channel_Registers*)&DMA0CON) + (channel))
+#endif
+
+/** Channel enable bit of DMAxCON */
+#define DMA_CON_CHEN	(1 << 15)
+/** Data size bit of DMAxCON, set for bytes */
+#define DMA_CON_SIZE	(1 << 14)
+/** Null data peripheral write bit of DMAxCON */
+#define DMA_CON_NULLW	(1 << 11)
+/** Addressing mode bits of DMAxCON, see \ref dma_addressing_mode */
+#define DMA_CON_AMODE	(3 << 4)
+/** Force transfer bit of DMAxREQ */
+#define DMA_REQ_FORCE	(1 << 15)
+
 /** DMA callback when a buffer is half or fully filled (depends on dma_interrupt_position) */
 typedef void(*dma_callback)(int channel, bool first_buffer);
 
+/** Declare a static buffer in DMA memory, aligned on a power of two, checked at compile time */
+#define DMA_STATIC_BUFFER(name, size, alignment) \
+	typedef char name##_alignment_must_be_a_power_of_two[((alignment) & ((alignment) - 1)) ? -1 : 1]; \
+	unsigned char name[size] __attribute__((space(dma), aligned(alignment)))
+
+/** Function returning the current time, in any free-running unit, used to measure the duration of DMA callbacks */
+typedef unsigned int(*dma_time_source)(void);
+
+/** Activity statistics of a DMA channel */
+typedef struct
+{
+	unsigned long completions;			/**< number of DMA interrupts served, that is of half or full buffers transferred */
+	unsigned int max_callback_time;		/**< worst time from entering the DMA interrupt to returning from the callback, in units of the dma_time_source */
+} DMA_Channel_Statistics;
+
+/** Continuous ping-pong stream over a DMA channel */
+typedef struct _DMA_Stream DMA_Stream;
+
+/** Deferred processing of a completed buffer of a stream, called at the stream IPL */
+typedef void(*dma_stream_callback)(DMA_Stream* stream, void* buffer, void* user_data);
+
+/** Continuous ping-pong stream over a DMA channel; the caller owns the storage, the fields are private */
+struct _DMA_Stream
+{
+	void* buffers[2];				/**< buffers A and B */
+	int channel;					/**< DMA channel */
+	signed char ready;				/**< index of the completed buffer not yet acquired, -1 if none */
+	signed char acquired;			/**< index of the buffer held by the consumer, -1 if none */
+	bool corrupted;					/**< the DMA started reusing the acquired buffer before its release */
+	bool processing;				/**< the deferred processing is running */
+	dma_stream_callback process;	/**< deferred processing, 0 if the consumer polls */
+	void* user_data;				/**< argument of process */
+	unsigned int ipl;				/**< IPL of the deferred processing */
+	unsigned long blocks;			/**< number of buffers completed by the DMA */
+	unsigned long overruns;			/**< number of buffers lost or overwritten because the consumer was late */
+};
+
+/** One segment of a DMA chain */
+typedef struct
+{
+	void* buffer;					/**< buffer inside the DMA memory */
+	unsigned int count;				/**< number of transfers (of 1 or 2 bytes depending on the channel data size), at least 1 */
+} DMA_Descriptor;
+
+/** Software chain of DMA segments, see dma_chain_start() */
+typedef struct _DMA_Chain DMA_Chain;
+
+/** Called from the DMA interrupt when the last segment of a chain is completed; for circular chains, at each lap */
+typedef void(*dma_chain_callback)(DMA_Chain* chain, void* user_data);
+
+/** Software chain of DMA segments; the caller owns the storage, the fields are private */
+struct _DMA_Chain
+{
+	const DMA_Descriptor* descriptors;	/**< segments */
+	unsigned int count;					/**< number of segments */
+	unsigned int index;					/**< segment being transferred */
+	int channel;						/**< DMA channel */
+	bool circular;						/**< restart at the first segment after the last one */
+	bool busy;							/**< a one-shot chain is in progress */
+	dma_chain_callback done;			/**< end of chain callback, may be 0 */
+	void* user_data;					/**< argument of done */
+	unsigned long segments;				/**< number of segments completed */
+};
+
+/** Usage statistics of the DMA memory arena */
+typedef struct
+{
+	unsigned int size;			/**< total size of the arena, in bytes */
+	unsigned int used;			/**< bytes handed out by dma_memory_alloc() */
+	unsigned int free;			/**< bytes still available, including the reusable alignment holes */
+	unsigned int largest_free;	/**< largest block that can still be allocated without alignment constraint */
+	unsigned int wasted;		/**< alignment padding that could not be kept for reuse */
+	unsigned int allocations;	/**< number of successful calls to dma_memory_alloc() */
+} DMA_Memory_Statistics;
+
 
 // Functions, doc in the .c
 
@@ -153,6 +267,48 @@ void dma_disable_channel(int channel);
 
 void dma_start_transfer(int channel);
 
+int dma_allocate_channel(int request_source);
+
+void dma_release_channel(int channel);
+
+int dma_get_channel_owner(int channel);
+
+unsigned char dma_get_used_channels(void);
+
+void dma_set_time_source(dma_time_source source);
+
+void dma_get_channel_statistics(int channel, DMA_Channel_Statistics* statistics);
+
+void dma_reset_channel_statistics(int channel);
+
+void dma_stream_init(DMA_Stream* stream, int channel, void* a, void* b, dma_stream_callback process, void* user_data, int process_ipl);
+
+void dma_stream_close(DMA_Stream* stream);
+
+void dma_stream_interrupt(int channel, bool first_buffer);
+
+void* dma_stream_acquire(DMA_Stream* stream);
+
+bool dma_stream_release(DMA_Stream* stream);
+
+void dma_stream_get_counters(DMA_Stream* stream, unsigned long* blocks, unsigned long* overruns);
+
+void dma_chain_start(DMA_Chain* chain, int channel, const DMA_Descriptor* descriptors, unsigned int count, bool circular, bool force, dma_chain_callback done, void* user_data);
+
+void dma_chain_stop(DMA_Chain* chain);
+
+bool dma_chain_is_busy(DMA_Chain* chain);
+
+void dma_chain_interrupt(int channel, bool first_buffer);
+
+void dma_memory_init(void* arena, unsigned int size);
+
+void* dma_memory_alloc(unsigned int size, unsigned int alignment);
+
+void dma_memory_reset(void);
+
+void dma_memory_get_statistics(DMA_Memory_Statistics* statistics);
+
 /*@}*/
 
 #endif
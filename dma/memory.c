@@ -0,0 +1,256 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup dma */
+/*@{*/
+
+/** \file
+	Allocator of buffers inside the DMA memory (DPSRAM).
+	
+	DMA buffers must lie in the DPSRAM, which is only 2 KB on most dsPIC33.
+	Instead of placing each buffer by hand, the application declares one arena
+	in DMA space and the drivers' buffers are carved out of it at initialization time:
+	
+	\code
+	DMA_STATIC_BUFFER(dma_arena, 1024, 2);
+	
+	dma_memory_init(dma_arena, sizeof(dma_arena));
+	
+	adc_buffer = dma_memory_alloc(2 * 32 * sizeof(int), 2);
+	can_buffer = dma_memory_alloc(32 * 16, 32 * 16);		// ECAN needs the buffer aligned on its size
+	\endcode
+	
+	Allocations cannot be freed individually, so the arena never fragments.
+	The padding created by large alignments, for instance the power-of-two alignment required by
+	ECAN and by the peripheral indirect addressing mode, is kept in a small list of holes
+	and reused by later allocations that fit in it.
+	
+	Buffers that must be placed at compile time can be declared with \ref DMA_STATIC_BUFFER,
+	which checks the alignment at compile time.
+	
+	These functions are not reentrant, and are meant to be called at initialization time.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "dma.h"
+#include "../error/error.h"
+
+/** Maximum number of alignment holes kept for reuse */
+#define DMA_MEMORY_MAX_HOLES 4
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** A free area of the arena, created by alignment padding */
+typedef struct
+{
+	unsigned int start;		/**< offset of the hole in the arena */
+	unsigned int size;		/**< size of the hole, 0 if unused */
+} DMA_Memory_Hole;
+
+/** DMA memory arena data */
+static struct
+{
+	unsigned char* base;							/**< start of the arena, 0 if not initialized */
+	unsigned int size;								/**< size of the arena */
+	unsigned int top;								/**< offset of the first never allocated byte */
+	unsigned int used;								/**< bytes handed out */
+	unsigned int wasted;							/**< padding lost because no hole slot was free */
+	unsigned int allocations;						/**< number of successful allocations */
+	DMA_Memory_Hole holes[DMA_MEMORY_MAX_HOLES];	/**< reusable padding */
+} DMA_Memory_Data;
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Return the offset of the first address after offset aligned on alignment, which must be a power of two */
+static unsigned int align_offset(unsigned int offset, unsigned int alignment)
+{
+	unsigned int address = (unsigned int)DMA_Memory_Data.base + offset;
+	
+	return ((address + alignment - 1) & ~(alignment - 1)) - (unsigned int)DMA_Memory_Data.base;
+}
+
+/** Keep a free area for reuse, or account it as wasted if no slot is free */
+static void add_hole(unsigned int start, unsigned int size)
+{
+	unsigned int i;
+	
+	if (size == 0)
+		return;
+	
+	for (i = 0; i < DMA_MEMORY_MAX_HOLES; i++)
+	{
+		if (DMA_Memory_Data.holes[i].size == 0)
+		{
+			DMA_Memory_Data.holes[i].start = start;
+			DMA_Memory_Data.holes[i].size = size;
+			return;
+		}
+	}
+	
+	DMA_Memory_Data.wasted += size;
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize the DMA memory arena.
+	
+	Any previous allocation is forgotten.
+	
+	\param	arena
+			Start of the arena, must be inside the DMA memory, for instance declared with \ref DMA_STATIC_BUFFER.
+	\param	size
+			Size of the arena, in bytes.
+*/
+void dma_memory_init(void* arena, unsigned int size)
+{
+	if ((unsigned int)arena < (unsigned int)&_DMA_BASE)
+		ERROR(DMA_ERROR_INVALID_ADDRESS, &arena);
+	
+	DMA_Memory_Data.base = (unsigned char*)arena;
+	DMA_Memory_Data.size = size;
+	dma_memory_reset();
+}
+
+/**
+	Allocate a buffer inside the DMA memory arena.
+	
+	The buffer is taken from a reusable alignment hole if one is large enough, otherwise from the free end of the arena.
+	
+	\param	size
+			Size of the buffer, in bytes; it is rounded up to a whole number of words.
+	\param	alignment
+			Alignment of the address of the buffer, in bytes; must be a power of two. Values lower than 2 mean word aligned.
+	\return	The address of the buffer. If the arena is full, an error is thrown.
+*/
+void* dma_memory_alloc(unsigned int size, unsigned int alignment)
+{
+	DMA_Memory_Hole* hole;
+	unsigned int start;
+	unsigned int end;
+	unsigned int i;
+
+	if (!DMA_Memory_Data.base)
+		ERROR(DMA_ERROR_ARENA_NOT_INITIALIZED, &size);
+	if (alignment & (alignment - 1))
+		ERROR(DMA_ERROR_INVALID_ALIGNMENT, &alignment);
+	
+	if (alignment < 2)
+		alignment = 2;
+	size = (size + 1) & ~1;
+	
+	// First fit among the holes
+	for (i = 0; i < DMA_MEMORY_MAX_HOLES; i++)
+	{
+		hole = &DMA_Memory_Data.holes[i];
+		if (hole->size < size)
+			continue;
+		
+		start = align_offset(hole->start, alignment);
+		if (start + size > hole->start + hole->size)
+			continue;
+		
+		// Split the hole in the part before and the part after the buffer
+		end = hole->start + hole->size;
+		hole->size = start - hole->start;
+		add_hole(start + size, end - (start + size));
+		goto allocated;
+	}
+	
+	// Otherwise, take it from the free end
+	start = align_offset(DMA_Memory_Data.top, alignment);
+	if (start + size > DMA_Memory_Data.size || start + size < start)
+		ERROR(DMA_ERROR_OUT_OF_MEMORY, &size);
+	
+	add_hole(DMA_Memory_Data.top, start - DMA_Memory_Data.top);
+	DMA_Memory_Data.top = start + size;
+	
+allocated:
+	DMA_Memory_Data.used += size;
+	DMA_Memory_Data.allocations++;
+	
+	return DMA_Memory_Data.base + start;
+}
+
+/**
+	Free all the buffers of the DMA memory arena at once.
+	
+	The buffers must not be in use by any DMA channel anymore.
+*/
+void dma_memory_reset(void)
+{
+	unsigned int i;
+	
+	DMA_Memory_Data.top = 0;
+	DMA_Memory_Data.used = 0;
+	DMA_Memory_Data.wasted = 0;
+	DMA_Memory_Data.allocations = 0;
+	for (i = 0; i < DMA_MEMORY_MAX_HOLES; i++)
+		DMA_Memory_Data.holes[i].size = 0;
+}
+
+/**
+	Get the usage statistics of the DMA memory arena.
+	
+	\param	statistics
+			Structure to fill.
+*/
+void dma_memory_get_statistics(DMA_Memory_Statistics* statistics)
+{
+	unsigned int i;
+	
+	statistics->size = DMA_Memory_Data.size;
+	statistics->used = DMA_Memory_Data.used;
+	statistics->wasted = DMA_Memory_Data.wasted;
+	statistics->allocations = DMA_Memory_Data.allocations;
+	statistics->free = DMA_Memory_Data.size - DMA_Memory_Data.top;
+	statistics->largest_free = statistics->free;
+	
+	for (i = 0; i < DMA_MEMORY_MAX_HOLES; i++)
+	{
+		statistics->free += DMA_Memory_Data.holes[i].size;
+		if (DMA_Memory_Data.holes[i].size > statistics->largest_free)
+			statistics->largest_free = DMA_Memory_Data.holes[i].size;
+	}
+}
+
+/*@}*/
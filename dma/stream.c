@@ -0,0 +1,279 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup dma */
+/*@{*/
+
+/** \file
+	Streaming over continuous ping-pong DMA channels.
+	
+	In continuous ping-pong mode, the DMA fills (or empties) buffers A and B alternately.
+	Once the DMA has completed a buffer, the consumer can use it only until the DMA completes the other one,
+	then the DMA starts reusing it. A stream tracks which buffer belongs to the consumer
+	and counts the buffers lost because the consumer was late.
+	
+	The stream replaces the user callback of the channel: pass dma_stream_interrupt() as callback
+	to dma_init_channel(), or to the DMA init function of a driver such as adc1_init_scan_dma().
+	The channel must be configured in \ref DMA_OPERATING_CONTINUOUS_PING_PONG mode with \ref DMA_INTERRUPT_AT_FULL.
+	
+	The consumer can either poll:
+	
+	\code
+	dma_stream_init(&stream, DMA_CHANNEL_2, adc_a, adc_b, 0, 0, 0);
+	adc1_init_scan_dma(inputs, event, sample_time, DMA_CHANNEL_2, adc_a, adc_b, size, mode, dma_stream_interrupt);
+	
+	while (1)
+	{
+		int* samples = dma_stream_acquire(&stream);
+		if (samples)
+		{
+			filter(samples);
+			if (!dma_stream_release(&stream))
+				; // the DMA overwrote samples while we were filtering
+		}
+	}
+	\endcode
+	
+	or provide a process callback, which is called for each completed buffer from the DMA interrupt,
+	after the IPL has been lowered to process_ipl. The DMA interrupts, at a higher priority, thus keep being served
+	while the buffer is processed, and heavy block processing never delays them.
+	
+	For transfers from RAM to a peripheral, such as the DAC, the completed buffer is the one the DMA just finished reading,
+	and the consumer acquires it to refill it.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "dma.h"
+#include "../error/error.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Stream attached to each DMA channel, 0 if none */
+static DMA_Stream* DMA_Streams[DMA_CHANNELS_COUNT];
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Give the ready buffer to the consumer, must be called at the DMA IPL */
+static void* acquire_ready(DMA_Stream* stream)
+{
+	stream->acquired = stream->ready;
+	stream->ready = -1;
+	stream->corrupted = false;
+	
+	return stream->buffers[(int)stream->acquired];
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Attach a stream to a DMA channel.
+	
+	The channel itself is configured separately, with dma_stream_interrupt() as callback.
+	
+	\param	stream
+			Stream storage, owned by the caller, must remain valid until dma_stream_close().
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+	\param	a
+			Buffer A of the channel.
+	\param	b
+			Buffer B of the channel.
+	\param	process
+			Function to call from the DMA interrupt, at process_ipl, for each completed buffer.
+			If 0, the consumer polls with dma_stream_acquire().
+	\param	user_data
+			Argument passed to process.
+	\param	process_ipl
+			IPL at which process runs, must be lower than the priority of the DMA channel. Ignored if process is 0.
+*/
+void dma_stream_init(DMA_Stream* stream, int channel, void* a, void* b, dma_stream_callback process, void* user_data, int process_ipl)
+{
+	ERROR_CHECK_RANGE(channel, DMA_CHANNEL_0, DMA_CHANNEL_7, DMA_ERROR_INVALID_CHANNEL);
+	if (process)
+		ERROR_CHECK_RANGE(process_ipl, 1, 6, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
+	
+	stream->buffers[0] = a;
+	stream->buffers[1] = b;
+	stream->channel = channel;
+	stream->ready = -1;
+	stream->acquired = -1;
+	stream->corrupted = false;
+	stream->processing = false;
+	stream->process = process;
+	stream->user_data = user_data;
+	stream->ipl = process_ipl;
+	stream->blocks = 0;
+	stream->overruns = 0;
+	
+	DMA_Streams[channel] = stream;
+}
+
+/**
+	Detach a stream from its DMA channel.
+	
+	Completed buffers are then ignored; disable the channel first to stop the transfers.
+	
+	\param	stream
+			Stream to detach.
+*/
+void dma_stream_close(DMA_Stream* stream)
+{
+	DMA_Streams[stream->channel] = 0;
+}
+
+/**
+	DMA callback of the channels carrying a stream.
+	
+	Pass this function as callback to dma_init_channel() or to the DMA init function of a driver.
+	Do not call it directly.
+	
+	\param	channel
+			DMA channel, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7.
+	\param	first_buffer
+			Whether buffer A or B was completed.
+*/
+void dma_stream_interrupt(int channel, bool first_buffer)
+{
+	DMA_Stream* stream = DMA_Streams[channel];
+	signed char done = first_buffer ? 0 : 1;
+	unsigned int ipl;
+	void* buffer;
+	
+	if (!stream)
+		return;
+	
+	// The DMA now reuses the other buffer
+	stream->blocks++;
+	if (stream->acquired == 1 - done)
+	{
+		stream->corrupted = true;
+		stream->overruns++;
+	}
+	if (stream->ready == 1 - done)
+		stream->overruns++;
+	stream->ready = done;
+	
+	// If a nested interrupt, the outer one will process the new buffer
+	if (!stream->process || stream->processing)
+		return;
+	
+	// Process at low IPL, so that DMA interrupts keep being served
+	ipl = SRbits.IPL;
+	stream->processing = true;
+	while (stream->ready >= 0)
+	{
+		buffer = acquire_ready(stream);
+		SET_IPL(stream->ipl);
+		stream->process(stream, buffer, stream->user_data);
+		SET_IPL(ipl);
+		stream->acquired = -1;
+	}
+	stream->processing = false;
+}
+
+/**
+	Take the last buffer completed by the DMA.
+	
+	The buffer belongs to the consumer until dma_stream_release(), which must be called before
+	the DMA completes the other buffer. A stream with a process callback must not be acquired.
+	
+	\param	stream
+			Stream to take the buffer from.
+	\return	The buffer, or 0 if no new buffer was completed since the last call, or if the previous buffer was not released.
+*/
+void* dma_stream_acquire(DMA_Stream* stream)
+{
+	void* buffer = 0;
+	int flags;
+	
+	RAISE_IPL(flags, 7);
+	if (stream->ready >= 0 && stream->acquired < 0)
+		buffer = acquire_ready(stream);
+	IRQ_ENABLE(flags);
+	
+	return buffer;
+}
+
+/**
+	Give the acquired buffer back to the DMA.
+	
+	\param	stream
+			Stream the buffer was acquired from.
+	\return	false if the DMA started reusing the buffer before this call, in which case its content is unreliable.
+*/
+bool dma_stream_release(DMA_Stream* stream)
+{
+	bool intact;
+	int flags;
+	
+	RAISE_IPL(flags, 7);
+	intact = !stream->corrupted;
+	stream->acquired = -1;
+	stream->corrupted = false;
+	IRQ_ENABLE(flags);
+	
+	return intact;
+}
+
+/**
+	Read the counters of a stream.
+	
+	\param	stream
+			Stream to read.
+	\param	blocks
+			Filled with the number of buffers completed by the DMA; ignored if 0.
+	\param	overruns
+			Filled with the number of buffers lost or overwritten because the consumer was late; ignored if 0.
+*/
+void dma_stream_get_counters(DMA_Stream* stream, unsigned long* blocks, unsigned long* overruns)
+{
+	int flags;
+	
+	RAISE_IPL(flags, 7);
+	if (blocks)
+		*blocks = stream->blocks;
+	if (overruns)
+		*overruns = stream->overruns;
+	IRQ_ENABLE(flags);
+}
+
+/*@}*/
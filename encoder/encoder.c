@@ -372,6 +372,147 @@ void encoder_reset(int type)
 	}	
 }
 
+/**
+	Get the positions of several encoders, sampled at the same instant.
+	
+	All the encoders are sampled inside one critical section, at the highest IPL of the
+	encoders of the set, so the returned positions form a consistent snapshot.
+	If any encoder interrupt fires during the sampling, the whole set is sampled again.
+	
+	Compared to calling encoder_get_position() for each encoder, this saves one function call,
+	one switch dispatch and one retry loop per encoder; the raw registers are read back to back
+	and the 32 bits positions are only reconstructed after leaving the critical section.
+	The critical section, which adds to the interrupt latency, does per encoder of the set:
+	for the QEI, two loads of the driver state and a load of POS1CNT; for a software encoder,
+	a 32 bits load of the position, a call to timer_get_value() and a load of the direction;
+	plus the stores of the raw values. Its duration in cycles has not been measured on the target.
+	
+	\param	types
+			Array of encoder types, each one of \ref encoder_type. An encoder must not be present twice.
+	\param	positions
+			Array of count elements in which the positions are written, in the same order as types.
+	\param	count
+			Number of encoders in types, at most \ref ENCODER_TYPE_HARD + 1.
+*/
+void encoder_get_position_multiple(const int* types, long* positions, unsigned int count)
+{
+	unsigned int raw_low[ENCODER_TYPE_HARD + 1];
+	unsigned int raw_high[ENCODER_TYPE_HARD + 1];
+	unsigned int ipl = 0;
+	unsigned int got_irq;
+	unsigned int i;
+	int type;
+	int flags;
+	
+	if (count > ENCODER_TYPE_HARD + 1)
+		ERROR(ENCODER_INVALID_COUNT, &count);
+	
+	// Validate the set and find the IPL protecting all its encoders
+	for (i = 0; i < count; i++)
+	{
+		type = types[i];
+		switch (type)
+		{
+			case ENCODER_TIMER_1 ... ENCODER_TIMER_9:
+				if (Software_Encoder_Data[type].ipl > ipl)
+					ipl = Software_Encoder_Data[type].ipl;
+				break;
+			case ENCODER_TYPE_HARD:
+				if (QEI_Encoder_Data.ipl > ipl)
+					ipl = QEI_Encoder_Data.ipl;
+				break;
+			default:
+				ERROR(ENCODER_INVALID_TYPE, &type);
+		}
+	}
+	
+	do {
+		for (i = 0; i < count; i++)
+		{
+			if (types[i] == ENCODER_TYPE_HARD)
+				QEI_Encoder_Data.got_irq = 0;
+			else
+				Software_Encoder_Data[types[i]].got_irq = 0;
+		}
+		
+		RAISE_IPL(flags, ipl);
+		
+		for (i = 0; i < count; i++)
+		{
+			type = types[i];
+			if (type == ENCODER_TYPE_HARD)
+			{
+				raw_low[i] = POS1CNT + QEI_Encoder_Data.poscnt_b15;
+				raw_high[i] = QEI_Encoder_Data.high_word;
+			}
+			else
+			{
+				positions[i] = Software_Encoder_Data[type].tpos;
+				raw_low[i] = timer_get_value(type);
+				raw_high[i] = Software_Encoder_Data[type].sens;
+			}
+		}
+		
+		// Any interrupt which was pending during the sampling runs here
+		IRQ_ENABLE(flags);
+		
+		got_irq = 0;
+		for (i = 0; i < count; i++)
+		{
+			if (types[i] == ENCODER_TYPE_HARD)
+				got_irq |= QEI_Encoder_Data.got_irq;
+			else
+				got_irq |= Software_Encoder_Data[types[i]].got_irq;
+		}
+		barrier();
+	} while (got_irq);
+	
+	// Reconstruct the 32 bits positions outside of the critical section
+	for (i = 0; i < count; i++)
+	{
+		type = types[i];
+		if (type == ENCODER_TYPE_HARD)
+			positions[i] = ((long) raw_high[i]) << 16 | raw_low[i];
+		else if (raw_high[i] == Software_Encoder_Data[type].up)
+			positions[i] += raw_low[i];
+		else
+			positions[i] -= raw_low[i];
+	}
+}
+
+/**
+	Update the position and speed variables of several encoders in one pass.
+	
+	The positions are sampled with encoder_get_position_multiple(), so all the speeds
+	are computed over the same time interval.
+	
+	\param	types
+			Array of encoder types, each one of \ref encoder_type. An encoder must not be present twice.
+	\param	count
+			Number of encoders in types, at most \ref ENCODER_TYPE_HARD + 1.
+*/
+void encoder_step_multiple(const int* types, unsigned int count)
+{
+	long pos[ENCODER_TYPE_HARD + 1];
+	unsigned int i;
+	
+	encoder_get_position_multiple(types, pos, count);
+	
+	for (i = 0; i < count; i++)
+	{
+		if (types[i] == ENCODER_TYPE_HARD)
+		{
+			*QEI_Encoder_Data.speed = pos[i] - *QEI_Encoder_Data.pos;
+			*QEI_Encoder_Data.pos = pos[i];
+		}
+		else
+		{
+			*(Software_Encoder_Data[types[i]].speed) = pos[i] - *(Software_Encoder_Data[types[i]].pos);
+			*(Software_Encoder_Data[types[i]].pos) = pos[i];
+		}
+	}
+}
+
 //! Callback for Input Capture 
 static void ic_tmr2_cb(int __attribute__((unused)) foo, unsigned int value, void * __attribute__((unused)) bar)
 {
@@ -43,6 +43,7 @@ enum encoder_errors
 	ENCODER_ERROR_BASE = 0x0800,
 	ENCODER_INVALID_TYPE,				/**< The specified encoder type is invalid, must be one of \ref encoder_type */
 	ENCODER_INVALID_MODE,				/**< The specified encoder speed is invalid, must be one of \ref encoder_mode */
+	ENCODER_INVALID_COUNT,				/**< The number of encoders passed to a batched function is larger than the number of encoders available */
 };
 
 
@@ -85,6 +86,10 @@ long encoder_get_position(int type);
 
 void encoder_reset(int type);
 
+void encoder_get_position_multiple(const int* types, long* positions, unsigned int count);
+
+void encoder_step_multiple(const int* types, unsigned int count);
+
 /*@}*/
 
 #endif
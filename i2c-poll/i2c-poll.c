@@ -0,0 +1,231 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+	\defgroup i2c-poll I2C polling
+	
+	Periodic polling of I2C devices, with cached values.
+	
+	Each job reads a register of a device at a fixed period, without involving the main loop:
+	a \ref soft-timer timer queues the read on the I2C transaction queue (see i2c_master_queue_transaction()),
+	so the jobs due at the same tick are executed back-to-back from the interrupts.
+	The bytes read are stored in a double-buffered cache: the device is read into the back cache,
+	which becomes the front cache once the read has succeeded.
+	The application gets the last value with i2c_poll_get(), which only copies the front cache and never touches the bus.
+	
+	\code
+	I2C_Poll_Job accelerometer;
+	unsigned char acceleration[6];
+	
+	soft_timer_init(TIMER_1, 1, 3, 1);
+	i2c_init_master(I2C_1, 400000, 5);
+	i2c_poll_add(&accelerometer, I2C_1, 0x1D, 0x01, 6, 10, NULL, NULL);		// every 10 ms
+	...
+	if (i2c_poll_get(&accelerometer, acceleration))
+		...
+	\endcode
+	
+	If a read is not completed when the job is due again, for instance because the bus is overloaded, the period is skipped.
+	All accesses to a polled bus must go through the transaction queue.
+*/
+/*@{*/
+
+/** \file
+	Implementation of the periodic polling of I2C devices.
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include <string.h> //memcpy
+
+#include "i2c-poll.h"
+#include "../error/error.h"
+
+
+//-------------------
+// Internal functions
+//-------------------
+
+/** The read of a job has completed, in the I2C interrupt */
+static void i2c_poll_read_done(int i2c_id, I2C_Transaction* transaction, bool result)
+{
+	I2C_Poll_Job* job = (I2C_Poll_Job*)transaction->user_data;
+	
+	if (result)
+	{
+		// The back cache becomes the front one, the sequence tells readers that it changed; it skips 0, meaning no value
+		job->front ^= 1;
+		barrier();
+		if (++job->sequence == 0)
+			job->sequence = 1;
+		job->statistics.updates++;
+	}
+	else
+	{
+		job->statistics.failures++;
+	}
+	
+	if (job->callback)
+		job->callback(job, job->cache[job->front], result);
+}
+
+/** A job is due, queue its read */
+static void i2c_poll_timer(Soft_Timer* timer, void* user_data)
+{
+	I2C_Poll_Job* job = (I2C_Poll_Job*)user_data;
+	
+	if (i2c_master_is_transaction_pending(&job->transaction))
+	{
+		job->statistics.skipped++;
+		return;
+	}
+	
+	i2c_master_queue_transaction(job->i2c_id, &job->transaction, job->address, &job->reg, 1, job->cache[job->front ^ 1], job->length, i2c_poll_read_done, job);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Add a polling job.
+	
+	The soft-timer and the I2C master must be initialized.
+	
+	\param	job
+			Job to add, must remain valid until it is removed. A removed job can be added again once its last read has completed.
+	\param	i2c_id
+			Identifier of the I2C, \ref I2C_1 or \ref I2C_2.
+	\param	address
+			I2C address of the device (7 bits, unshifted).
+	\param	reg
+			Register to read, written before each read.
+	\param	length
+			Number of bytes to read, from 1 to \ref I2C_POLL_MAX_LENGTH.
+	\param	period
+			Period of the reads, in soft-timer ticks; the first read occurs after one period.
+	\param	callback
+			Function to call after each read, in the I2C interrupt, may be 0.
+	\param	user_data
+			Pointer free for the user.
+*/
+void i2c_poll_add(I2C_Poll_Job* job, int i2c_id, unsigned char address, unsigned char reg, unsigned int length, unsigned long period, i2c_poll_callback callback, void* user_data)
+{
+	if (length == 0 || length > I2C_POLL_MAX_LENGTH)
+		ERROR(I2C_POLL_ERROR_INVALID_LENGTH, &length);
+	// The transaction may not be initialized yet, so look for it in the queues rather than trusting its pending flag
+	if (i2c_master_is_transaction_queued(&job->transaction))
+		ERROR(I2C_ERROR_TRANSACTION_PENDING, &job);
+	
+	job->i2c_id = i2c_id;
+	job->address = address;
+	job->reg = reg;
+	job->length = length;
+	job->callback = callback;
+	job->user_data = user_data;
+	job->transaction.pending = false;
+	job->front = 0;
+	job->sequence = 0;
+	job->statistics.updates = 0;
+	job->statistics.failures = 0;
+	job->statistics.skipped = 0;
+	
+	soft_timer_add(&job->timer, period, period, i2c_poll_timer, job);
+}
+
+/**
+	Remove a polling job.
+	
+	A read in progress is completed, but its callback must tolerate being called after this function returns.
+	The job can be added again once its last read has completed, i2c_poll_add() raises I2C_ERROR_TRANSACTION_PENDING otherwise.
+	
+	\param	job
+			Job to remove.
+*/
+void i2c_poll_remove(I2C_Poll_Job* job)
+{
+	soft_timer_cancel(&job->timer);
+}
+
+/**
+	Get the last value read by a job.
+	
+	\param	job
+			Polling job.
+	\param	data
+			Where to copy the value, the length of the job.
+	\return	true if a value has been read since i2c_poll_add(), false otherwise and data is not written.
+*/
+bool i2c_poll_get(I2C_Poll_Job* job, unsigned char* data)
+{
+	unsigned int sequence;
+	
+	// Copy again if the caches were swapped during the copy, as the copied one may then have been overwritten;
+	// the sequence is an int, so that it is read in one instruction
+	do
+	{
+		sequence = job->sequence;
+		barrier();
+		if (sequence == 0)
+			return false;
+		memcpy(data, job->cache[job->front], job->length);
+		barrier();
+	}
+	while (sequence != job->sequence);
+	
+	return true;
+}
+
+/**
+	Get the statistics of a polling job.
+	
+	\param	job
+			Polling job.
+	\param	statistics
+			Structure to fill.
+*/
+void i2c_poll_get_statistics(I2C_Poll_Job* job, I2C_Poll_Statistics* statistics)
+{
+	I2C_Poll_Statistics copy;
+	
+	do
+	{
+		copy = job->statistics;
+	}
+	while (copy.updates != job->statistics.updates || copy.failures != job->statistics.failures || copy.skipped != job->statistics.skipped);
+	
+	*statistics = copy;
+}
+
+/*@}*/
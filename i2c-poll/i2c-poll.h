@@ -0,0 +1,98 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_I2C_POLL_H
+#define _MOLOLE_I2C_POLL_H
+
+#include "../types/types.h"
+#include "../i2c/i2c.h"
+#include "../soft-timer/soft-timer.h"
+
+/** \addtogroup i2c-poll */
+/*@{*/
+
+/** \file
+	\brief Periodic polling of I2C devices, with cached values.
+*/
+
+// Defines
+
+/** Errors i2c-poll can throw */
+enum i2c_poll_errors
+{
+	I2C_POLL_ERROR_BASE = 0x1900,
+	I2C_POLL_ERROR_INVALID_LENGTH,		/**< The length to read is not from 1 to \ref I2C_POLL_MAX_LENGTH. */
+};
+
+/** Maximum number of bytes read by a job */
+#define I2C_POLL_MAX_LENGTH 8
+
+/** Polling job */
+typedef struct _I2C_Poll_Job I2C_Poll_Job;
+
+/** Callback when a job has been executed, in the I2C interrupt; data is the new cached value if result is true */
+typedef void (*i2c_poll_callback)(I2C_Poll_Job* job, const unsigned char* data, bool result);
+
+/** Statistics of a polling job */
+typedef struct
+{
+	unsigned long updates;			/**< successful reads */
+	unsigned long failures;			/**< reads not acknowledged by the device */
+	unsigned long skipped;			/**< periods skipped because the previous read was not completed */
+} I2C_Poll_Statistics;
+
+// Structures definitions
+
+/** Data associated with a polling job; the storage is provided by the caller, the fields are private */
+struct _I2C_Poll_Job
+{
+	int i2c_id;									/**< identifier of the I2C */
+	unsigned char address;						/**< I2C address (7 bits, unshifted) */
+	unsigned char reg;							/**< register to read */
+	unsigned int length;						/**< number of bytes to read */
+	i2c_poll_callback callback;					/**< function to call after each read, may be 0 */
+	void* user_data;							/**< free for the user */
+	
+	Soft_Timer timer;							/**< timer triggering the reads */
+	I2C_Transaction transaction;				/**< read transaction */
+	unsigned char cache[2][I2C_POLL_MAX_LENGTH];	/**< front cache, read by the application, and back cache, being read from the device */
+	unsigned char front;						/**< index of the front cache */
+	unsigned int sequence;						/**< changed at each update, read atomically by i2c_poll_get(); 0 if no value yet */
+	I2C_Poll_Statistics statistics;				/**< statistics of the job */
+};
+
+// Functions, doc in the .c
+
+void i2c_poll_add(I2C_Poll_Job* job, int i2c_id, unsigned char address, unsigned char reg, unsigned int length, unsigned long period, i2c_poll_callback callback, void* user_data);
+
+void i2c_poll_remove(I2C_Poll_Job* job);
+
+bool i2c_poll_get(I2C_Poll_Job* job, unsigned char* data);
+
+void i2c_poll_get_statistics(I2C_Poll_Job* job, I2C_Poll_Statistics* statistics);
+
+/*@}*/
+
+#endif
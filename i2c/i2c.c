@@ -69,7 +69,7 @@ void i2c_init(int i2c_id )
 		I2C1CONbits.SCLREL = 1;			// Release SCLx clock
 		I2C1CONbits.IPMIEN = 0;			// Only acknowledge own address
 		I2C1CONbits.A10M = 0;			// 7bit slave address
-		I2C1CONbits.DISSLW = 1;			// Slew rate control disabled (enable for 400kHz operation!)
+		I2C1CONbits.DISSLW = 1;			// Slew rate control disabled, i2c_init_master() enables it for 400kHz operation
 		I2C1CONbits.SMEN = 0;			// Disable SMBus Input thresholds (set for 3.3V operation!)
 		I2C1CONbits.GCEN = 0;			// General call address disabled
 		I2C1CONbits.STREN = 0;			// Disable software or receive clock stretching
@@ -88,7 +88,7 @@ void i2c_init(int i2c_id )
 		I2C2CONbits.SCLREL = 1;			// Release SCLx clock
 		I2C2CONbits.IPMIEN = 0;			// Only acknowledge own address
 		I2C2CONbits.A10M = 0;			// 7bit slave address
-		I2C2CONbits.DISSLW = 1;			// Slew rate control disabled (enable for 400kHz operation!)
+		I2C2CONbits.DISSLW = 1;			// Slew rate control disabled, i2c_init_master() enables it for 400kHz operation
 		I2C2CONbits.SMEN = 0;			// Disable SMBus Input thresholds (set for 3.3V operation!)
 		I2C2CONbits.GCEN = 0;			// General call address disabled
 		I2C2CONbits.STREN = 0;			// Disable software or receive clock stretching
@@ -108,7 +108,7 @@ void i2c_init(int i2c_id )
 		I2C3CONbits.SCLREL = 1;			// Release SCLx clock
 		I2C3CONbits.IPMIEN = 0;			// Only acknowledge own address
 		I2C3CONbits.A10M = 0;			// 7bit slave address
-		I2C3CONbits.DISSLW = 1;			// Slew rate control disabled (enable for 400kHz operation!)
+		I2C3CONbits.DISSLW = 1;			// Slew rate control disabled, i2c_init_master() enables it for 400kHz operation
 		I2C3CONbits.SMEN = 0;			// Disable SMBus Input thresholds (set for 3.3V operation!)
 		I2C3CONbits.GCEN = 0;			// General call address disabled
 		I2C3CONbits.STREN = 0;			// Disable software or receive clock stretching
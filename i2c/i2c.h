@@ -27,6 +27,7 @@
 
 #include "../types/types.h"
 #include "../error/error.h"
+#include "../gpio/gpio.h"
 
 /** Errors I2C can throw */
 enum i2c_errors
@@ -37,6 +38,8 @@ enum i2c_errors
 	I2C_ERROR_MASTER_BUSY,				/**< A master start was called while the master was busy. */
 	I2C_INVALID_OPERATION,				/**< The operation asked is invalid */
 	I2C_PROTOCOL_INTERNAL_ERROR,		/**< The state machine is confused. Please report a such bug it should never happens */
+	I2C_ERROR_TRANSACTION_PENDING,		/**< A transaction was queued while it was already in a queue. */
+	I2C_ERROR_INVALID_REGISTER,			/**< A register range is outside of the register map. */
 };
 
 /** \addtogroup i2c */
@@ -89,6 +92,55 @@ void i2c_disable_slave(int i2c_id);
 
 void i2c_slave_return_to_idle(int i2c_id);
 
+void i2c_slave_set_end_callback(int i2c_id, i2c_status_callback message_end_callback);
+
+// register map for I2C slave
+
+/** Register map exposed by an I2C slave */
+typedef struct _I2C_Register_Map I2C_Register_Map;
+
+/** I2C callback when the master has written or read registers of a register map, at the end of the message */
+typedef void (*i2c_register_map_callback)(int i2c_id, I2C_Register_Map* map, unsigned int first, unsigned int count);
+
+/** Register map exposed by an I2C slave; the caller owns the storage, the fields are private */
+struct _I2C_Register_Map
+{
+	unsigned char* registers;						/**< registers, as seen by the application */
+	unsigned char* shadow;							/**< copy of the registers seen by the master during a message */
+	const unsigned char* readable;					/**< bit i set if register i can be read by the master, 0 if all can */
+	const unsigned char* writable;					/**< bit i set if register i can be written by the master, 0 if all can */
+	unsigned int size;								/**< number of registers */
+	i2c_register_map_callback written_callback;		/**< function to call when registers were written, may be 0 */
+	i2c_register_map_callback read_callback;		/**< function to call when registers were read, may be 0 */
+	int ipl;										/**< priority of the slave interrupt */
+	int state;										/**< state of the current message */
+	unsigned int pointer;							/**< register pointer */
+	unsigned int first;								/**< first register of the current message */
+	unsigned int position;							/**< next register of the current message */
+};
+
+// Functions, doc in the .c
+
+void i2c_init_slave_register_map(
+	int i2c_id,
+	unsigned char address,
+	I2C_Register_Map* map,
+	unsigned char* registers,
+	unsigned char* shadow,
+	unsigned int size,
+	const unsigned char* readable,
+	const unsigned char* writable,
+	i2c_register_map_callback written_callback,
+	i2c_register_map_callback read_callback,
+	int priority
+);
+
+void i2c_register_map_set(I2C_Register_Map* map, unsigned int first, const void* data, unsigned int count);
+
+void i2c_register_map_get(I2C_Register_Map* map, unsigned int first, void* data, unsigned int count);
+
+void i2c_register_map_flush(int i2c_id);
+
 /** I2C master operations the protocol layer can do */
 enum i2c_master_operation
 {
@@ -112,7 +164,7 @@ typedef int (*i2c_master_operation_completed_callback)(int i2c_id, unsigned char
 
 // Functions, doc in the .c
 
-void i2c_init_master(int i2c_id, long speed, int priority);
+long i2c_init_master(int i2c_id, long speed, int priority);
 
 void i2c_master_start_operations(int i2c_id, i2c_master_operation_completed_callback operation_completed_callback, void* user_data);
 
@@ -120,6 +172,8 @@ void i2c_master_reset(int i2c_id);
 
 bool i2c_master_is_busy(int i2c_id);
 
+bool i2c_master_recover_bus(int i2c_id, gpio scl, gpio sda);
+
 // high level helpers for I2C master
 
 /** Results of I2C high level protocol operations */
@@ -135,12 +189,70 @@ enum i2c_protocol_results
 /** I2C callback when async master transfert has finished operations, result is true if successfull, false otherwise */
 typedef void (*i2c_master_transfert_result_callback)(int i2c_id, bool result);
 
+/** I2C callback when a stuck bus has been recovered after a timeout, released is false if the bus is still stuck */
+typedef void (*i2c_bus_error_callback)(int i2c_id, bool released);
+
 // Functions, doc in the .c
 
 void i2c_master_transfert_async(int i2c_id, unsigned char addr, unsigned char* write_data, unsigned write_count, unsigned char* read_data, unsigned read_count, i2c_master_transfert_result_callback result_callback);
 
 int i2c_master_transfert_block(int i2c_id, unsigned char addr, unsigned char* write_data, unsigned write_count, unsigned char* read_data, unsigned read_count);
 
+void i2c_master_set_timeout(int i2c_id, unsigned int timeout, gpio scl, gpio sda, i2c_bus_error_callback callback);
+
+void i2c_master_check_timeout(int i2c_id);
+
+// queued transactions for I2C master
+
+/** Queued I2C master transaction; the caller owns the storage */
+typedef struct _I2C_Transaction I2C_Transaction;
+
+/** I2C callback when a queued transaction has completed, result is true if successfull, false otherwise */
+typedef void (*i2c_transaction_callback)(int i2c_id, I2C_Transaction* transaction, bool result);
+
+/** Queued I2C master transaction, filled by i2c_master_queue_transaction() */
+struct _I2C_Transaction
+{
+	unsigned char address;				/**< I2C address (7 bits, unshifted) */
+	unsigned char* write_data;			/**< data to write to the device */
+	unsigned write_count;				/**< amount of data to write */
+	unsigned char* read_data;			/**< where to store data read from the device */
+	unsigned read_count;				/**< amount of data to read */
+	i2c_transaction_callback callback;	/**< function to call when the transaction has completed, may be 0 */
+	void* user_data;					/**< free for the user, for instance for the callback */
+	unsigned int bus_time;				/**< time the last run of the transaction spent on the bus, in units of the i2c_time_source, 0 if not measured */
+	I2C_Transaction* next;				/**< private, next transaction in the queue */
+	bool pending;						/**< private, true while the transaction is queued or in progress */
+};
+
+/** I2C callback returning the time, to measure the bus busy time */
+typedef unsigned int (*i2c_time_source)(void);
+
+/** Statistics of the transaction queue of an I2C master */
+typedef struct
+{
+	unsigned long transactions;		/**< transactions completed */
+	unsigned long nacks;			/**< transactions aborted because the device did not acknowledge */
+	unsigned int queue_depth;		/**< transactions queued or in progress */
+	unsigned int max_queue_depth;	/**< largest queue_depth */
+	unsigned long busy_time;		/**< time spent in transactions, in units of the i2c_time_source */
+	unsigned long bytes;			/**< bytes transferred by successful transactions, including the address bytes, to compute the throughput with busy_time */
+} I2C_Master_Statistics;
+
+// Functions, doc in the .c
+
+void i2c_master_queue_transaction(int i2c_id, I2C_Transaction* transaction, unsigned char addr, unsigned char* write_data, unsigned write_count, unsigned char* read_data, unsigned read_count, i2c_transaction_callback callback, void* user_data);
+
+bool i2c_master_is_transaction_pending(I2C_Transaction* transaction);
+
+bool i2c_master_is_transaction_queued(I2C_Transaction* transaction);
+
+void i2c_master_set_time_source(i2c_time_source source);
+
+void i2c_master_get_statistics(int i2c_id, I2C_Master_Statistics* statistics);
+
+void i2c_master_reset_statistics(int i2c_id);
+
 bool __attribute((deprecated)) i2c_read(int i2c_id, unsigned char device_add, unsigned char reg, unsigned char *data, unsigned int size);
 bool __attribute((deprecated)) i2c_write(int i2c_id, unsigned char device_add, unsigned char reg, unsigned char *data, unsigned int size);
 
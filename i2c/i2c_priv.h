@@ -16,5 +16,8 @@ static __attribute__ ((always_inline)) void i2c_check_range(int i2c_id)
 #endif
 }
 
+// Priority of the master interrupt, at which the transferts complete
+int i2c_master_get_ipl(int i2c_id);
+
 #endif // _I2C_PRIV_H
 
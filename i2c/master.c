@@ -32,6 +32,13 @@
 
 /** \file
 	Implementation of the wrapper around I2C master.
+	
+	The baud rate generator reloads I2CxBRG only after the pulse gobbler delay, so the datasheet formula is
+	I2CxBRG = (1/Fscl - Tpgd) * Fcy - 2 on the dsPIC33F and (Fcy/Fscl - Fcy/10000000) - 1 on the PIC24F.
+	i2c_init_master() rounds I2CxBRG up so that the bus never runs faster than requested, and returns
+	the achieved speed.
+	Standard (100 kHz), fast (400 kHz) and fast-mode plus (1 MHz) speeds are supported;
+	the slew rate control is enabled for fast mode only, as required by the datasheet.
 */
 
 //------------
@@ -44,6 +51,26 @@
 #include "../types/uc.h"
 #include "../error/error.h"
 #include "../clock/clock.h"
+#include "../gpio/gpio.h"
+
+/** Half period of the SCL pulses generated by i2c_master_recover_bus(), in us */
+#define I2C_RECOVERY_HALF_PERIOD	5
+
+/** Mask of the bits of I2CxCON that start a bus event (SEN, RSEN, PEN, RCEN and ACKEN) */
+#define I2C_CON_EVENTS_MASK			0x001F
+
+#if defined __dsPIC33F__
+/** Pulse gobbler delay, in ns */
+#define I2C_PULSE_GOBBLER_DELAY		120
+/** Constant term of the BRG formula */
+#define I2C_BRG_OFFSET				2
+/** Largest valid I2CxBRG */
+#define I2C_BRG_MAX					65535
+#elif defined __PIC24F__
+#define I2C_PULSE_GOBBLER_DELAY		100
+#define I2C_BRG_OFFSET				1
+#define I2C_BRG_MAX					511
+#endif
 
 
 //-----------------------
@@ -74,30 +101,41 @@ static struct
 	\param	i2c_id
 			identifier of the I2C, \ref I2C_1 or \ref I2C_2
 	\param	speed
-			I2C line speed in bps
+			I2C line speed in bps, up to 1000000 (fast-mode plus)
 	\param 	priority
 			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
+	\return	the achieved line speed in bps, lower than or equal to speed
 */
-void i2c_init_master(int i2c_id, long speed, int priority)
+long i2c_init_master(int i2c_id, long speed, int priority)
 {
+	unsigned long fcy = clock_get_cycle_frequency();
+	unsigned long period;
+	unsigned long delay;
 	unsigned long brg;
+	bool slew_rate_control;
 	
 	i2c_check_range(i2c_id);
 	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
-#if defined __dsPIC33F__
-	brg = (clock_get_cycle_frequency()/speed - clock_get_cycle_frequency()/1111111) - 1;
-	ERROR_CHECK_RANGE(brg, 1, 65535, I2C_INVALID_CLOCK);
-#elif defined __PIC24F__
-	brg = (clock_get_cycle_frequency()/speed - clock_get_cycle_frequency()/10000000l) - 1;
-	ERROR_CHECK_RANGE(brg, 1, 511, I2C_INVALID_CLOCK);
+	ERROR_CHECK_RANGE(speed, 1, 1000000, I2C_INVALID_CLOCK);
+#if defined __dsPIC33F__ || defined __PIC24F__
+	// Work in 1/16 of instruction cycles to keep precision without overflowing
+	period = (fcy * 16) / (unsigned long)speed;
+	delay = ((fcy / 1000) * I2C_PULSE_GOBBLER_DELAY * 16) / 1000000;
+	if (period < delay + (I2C_BRG_OFFSET + 1) * 16)
+		ERROR(I2C_INVALID_CLOCK, &speed);
+	brg = (period - delay - I2C_BRG_OFFSET * 16 + 15) / 16;
+	ERROR_CHECK_RANGE(brg, 1, I2C_BRG_MAX, I2C_INVALID_CLOCK);
+	speed = (fcy * 16) / ((brg + I2C_BRG_OFFSET) * 16 + delay);
 #else
 	brg = 0;
 	ERROR(I2C_INVALID_CLOCK, "Unsupported architecture");
 #endif
+	slew_rate_control = speed > 100000 && speed <= 400000;
 
 	if (i2c_id == I2C_1)
 	{
 		I2C1BRG = (unsigned int) brg;
+		I2C1CONbits.DISSLW = !slew_rate_control;
 		_MI2C1IF = 0;					// clear the master interrupt
 		_MI2C1IP = priority;			// set the master interrupt priority
 	
@@ -107,6 +145,7 @@ void i2c_init_master(int i2c_id, long speed, int priority)
 	else if (i2c_id == I2C_2)
 	{
 		I2C2BRG = (unsigned int) brg;
+		I2C2CONbits.DISSLW = !slew_rate_control;
 		_MI2C2IF = 0;					// clear the master interrupt
 		_MI2C2IP = priority;			// set the master interrupt priority
 	
@@ -117,12 +156,15 @@ void i2c_init_master(int i2c_id, long speed, int priority)
 	else if (i2c_id == I2C_3)
 	{
 		I2C3BRG = (unsigned int) brg;
+		I2C3CONbits.DISSLW = !slew_rate_control;
 		_MI2C3IF = 0;					// clear the master interrupt
 		_MI2C3P = priority;			// set the master interrupt priority
 	
 		_MI2C3IE = 1;					// enable the master interrupt*/
 	}
 #endif
+	
+	return speed;
 }
 
 /**
@@ -194,6 +236,137 @@ void i2c_master_reset(int i2c_id)
 	I2C_Master_Data[i2c_id].operation_completed_callback = 0;
 }
 
+/**
+	Return the priority of the master interrupt of an I2C, given to i2c_init_master().
+	
+	\param 	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+*/
+int i2c_master_get_ipl(int i2c_id)
+{
+	i2c_check_range(i2c_id);
+	
+#ifdef _MI2C2IF
+	if (i2c_id == I2C_2)
+		return _MI2C2IP;
+#endif
+#ifdef _MI2C3IF
+	if (i2c_id == I2C_3)
+		return _MI2C3IP;
+#endif
+	return _MI2C1IP;
+}
+
+/**
+	Free a bus blocked by a slave holding SDA low, for instance after a brown-out during a read.
+	
+	The I2C module is disabled and SCL is pulsed with GPIOs up to nine times, until the slave releases SDA;
+	a stop condition is then generated and the I2C module is re-enabled with its previous configuration.
+	This takes about 100 us, during which the master interrupt is disabled but other interrupts run.
+	
+	This function only acts on the hardware; any transfert in progress must be aborted by the caller,
+	i2c_master_check_timeout() does both.
+	
+	\param 	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param	scl
+			GPIO of the SCL pin of the I2C
+	\param	sda
+			GPIO of the SDA pin of the I2C
+	
+	\return	true if both lines are released after the recovery, false if the bus is still stuck
+*/
+bool i2c_master_recover_bus(int i2c_id, gpio scl, gpio sda)
+{
+	unsigned int con = 0;
+	bool released;
+	int flags;
+	int i;
+	
+	i2c_check_range(i2c_id);
+	
+	// Take the pins from the I2C module
+	RAISE_IPL(flags, 7);
+	if (i2c_id == I2C_1)
+	{
+		_MI2C1IE = 0;
+		con = I2C1CON;
+		I2C1CONbits.I2CEN = 0;
+	}
+#ifdef _MI2C2IF
+	else if (i2c_id == I2C_2)
+	{
+		_MI2C2IE = 0;
+		con = I2C2CON;
+		I2C2CONbits.I2CEN = 0;
+	}
+#endif
+#ifdef _MI2C3IF
+	else if (i2c_id == I2C_3)
+	{
+		_MI2C3IE = 0;
+		con = I2C3CON;
+		I2C3CONbits.I2CEN = 0;
+	}
+#endif
+	IRQ_ENABLE(flags);
+	
+	// Emulate open drain outputs by toggling the direction of low outputs
+	gpio_write(scl, false);
+	gpio_write(sda, false);
+	gpio_set_dir(scl, GPIO_INPUT);
+	gpio_set_dir(sda, GPIO_INPUT);
+	clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	
+	// Clock the slave until it releases SDA, it has at most 8 data bits and the acknowledge left to send
+	for (i = 0; i < 9 && !gpio_read(sda); i++)
+	{
+		gpio_set_dir(scl, GPIO_OUTPUT);
+		clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+		gpio_set_dir(scl, GPIO_INPUT);
+		clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	}
+	
+	// Stop condition: SDA rises while SCL is high
+	gpio_set_dir(scl, GPIO_OUTPUT);
+	clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	gpio_set_dir(sda, GPIO_OUTPUT);
+	clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	gpio_set_dir(scl, GPIO_INPUT);
+	clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	gpio_set_dir(sda, GPIO_INPUT);
+	clock_delay_us(I2C_RECOVERY_HALF_PERIOD);
+	
+	released = gpio_read(scl) && gpio_read(sda);
+	
+	// Give the pins back to the I2C module, without the event that was in progress
+	con &= ~I2C_CON_EVENTS_MASK;
+	if (i2c_id == I2C_1)
+	{
+		I2C1CON = con;
+		_MI2C1IF = 0;
+		_MI2C1IE = 1;
+	}
+#ifdef _MI2C2IF
+	else if (i2c_id == I2C_2)
+	{
+		I2C2CON = con;
+		_MI2C2IF = 0;
+		_MI2C2IE = 1;
+	}
+#endif
+#ifdef _MI2C3IF
+	else if (i2c_id == I2C_3)
+	{
+		I2C3CON = con;
+		_MI2C3IF = 0;
+		_MI2C3IE = 1;
+	}
+#endif
+	
+	return released;
+}
+
 //--------------------------
 // Interrupt service routine
 //--------------------------
@@ -31,6 +31,24 @@
 
 /** \file
 	Implementation of the I2C master protocols.
+	
+	A slave that holds SDA low, for instance after a brown-out, blocks the bus and the transfert in progress
+	never completes. To detect this, give a timeout with i2c_master_set_timeout() and call i2c_master_check_timeout()
+	periodically, for instance from a timer or a soft-timer callback:
+	
+	\code
+	static void i2c_watchdog(Soft_Timer* timer, void* user_data)
+	{
+		i2c_master_check_timeout(I2C_1);
+	}
+	
+	i2c_master_set_timeout(I2C_1, 5, GPIO_MAKE_ID(GPIO_PORTG, 2), GPIO_MAKE_ID(GPIO_PORTG, 3), i2c_bus_error);
+	soft_timer_add(&i2c_watchdog_timer, 1, 1, i2c_watchdog, 0);
+	\endcode
+	
+	When a transfert lasts more than the timeout, the bus is recovered with i2c_master_recover_bus(),
+	the error callback is called and the transfert completes with a failure, so blocking transferts return false
+	and the transaction queue proceeds with the next transaction.
 */
 
 //------------
@@ -62,6 +80,7 @@ enum I2C_master_transfert_states
 	I2C_ACK_DONE,
 	I2C_NACK_DONE,
 	I2C_STOP_DONE,
+	I2C_RECOVERY,
 };
 
 // TODO: doc
@@ -79,6 +98,19 @@ typedef struct {
 /** data for the master I2C 1 and 2 high level protocol */
 static I2C_Master_Protocol_Data I2C_master_transfert_datas[3];
 
+/** Timeout of the transferts of an I2C master */
+typedef struct
+{
+	unsigned int timeout;			/**< maximum duration of a transfert, in calls to i2c_master_check_timeout(), 0 if disabled */
+	unsigned int elapsed;			/**< calls to i2c_master_check_timeout() since the start of the transfert in progress */
+	gpio scl;						/**< GPIO of the SCL pin, to recover the bus */
+	gpio sda;						/**< GPIO of the SDA pin, to recover the bus */
+	i2c_bus_error_callback callback;	/**< function to call when the bus has been recovered, may be 0 */
+} I2C_Master_Timeout;
+
+/** timeouts for the I2C 1 to 3 masters */
+static I2C_Master_Timeout I2C_Master_Timeouts[3];
+
 //-------------------
 // Internal callbacks
 //-------------------
@@ -187,6 +219,11 @@ static int i2c_master_transfert_op(int i2c_id, unsigned char** data, void* user_
 				I2C_master_transfert_datas[i2c_id].result_callback(i2c_id, I2C_master_transfert_datas[i2c_id].result);
 			break;
 
+		case I2C_RECOVERY:
+			/* A late interrupt of an aborted transfert, the bus is being recovered */
+			ret = I2C_MASTER_QUIT;
+			break;
+
 		case I2C_IDLE:
 		default:
 			ERROR(I2C_PROTOCOL_INTERNAL_ERROR, &I2C_master_transfert_datas[i2c_id].state);
@@ -235,6 +272,7 @@ void i2c_master_transfert_async(int i2c_id, unsigned char addr, unsigned char* w
 	I2C_master_transfert_datas[i2c_id].write_data_size = write_count;
 	I2C_master_transfert_datas[i2c_id].read_data = read_data;
 	I2C_master_transfert_datas[i2c_id].read_data_size = read_count;
+	I2C_Master_Timeouts[i2c_id].elapsed = 0;
 	i2c_master_start_operations(i2c_id, i2c_master_transfert_op, NULL);
 }
 
@@ -265,6 +303,86 @@ bool i2c_master_transfert_block(int i2c_id, unsigned char addr, unsigned char* w
 	return I2C_master_transfert_datas[i2c_id].result;
 }
 
+/**
+	Set the timeout of the transferts of an I2C master, and how to recover the bus when it expires.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param	timeout
+			maximum duration of a transfert, in calls to i2c_master_check_timeout(); 0 to disable
+	\param	scl
+			GPIO of the SCL pin of the I2C
+	\param	sda
+			GPIO of the SDA pin of the I2C
+	\param	callback
+			function to call after the bus has been recovered, may be 0
+*/
+void i2c_master_set_timeout(int i2c_id, unsigned int timeout, gpio scl, gpio sda, i2c_bus_error_callback callback)
+{
+	I2C_Master_Timeout* t;
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	t = &I2C_Master_Timeouts[i2c_id];
+	
+	RAISE_IPL(flags, 7);
+	t->timeout = timeout;
+	t->elapsed = 0;
+	t->scl = scl;
+	t->sda = sda;
+	t->callback = callback;
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Check whether the transfert in progress on an I2C master has timed out, and if so recover the bus.
+	
+	This function must be called periodically, at an IPL lower than or equal to the one of the I2C master interrupt,
+	but not from the I2C interrupt.
+	A stuck transfert is aborted after timeout calls: the bus is recovered with i2c_master_recover_bus(),
+	the error callback is called, and then the result callback of the transfert is called with a failure.
+	Both callbacks are called at the IPL of the I2C master interrupt, as for a transfert completing normally,
+	so that the transaction queue is not preempted by the I2C interrupt while it updates.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+*/
+void i2c_master_check_timeout(int i2c_id)
+{
+	I2C_Master_Timeout* t;
+	I2C_Master_Protocol_Data* data;
+	bool released;
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	t = &I2C_Master_Timeouts[i2c_id];
+	data = &I2C_master_transfert_datas[i2c_id];
+	
+	RAISE_IPL(flags, 7);
+	if (t->timeout == 0 || data->state == I2C_IDLE || data->state == I2C_RECOVERY || ++t->elapsed < t->timeout)
+	{
+		IRQ_ENABLE(flags);
+		return;
+	}
+	// From now on, interrupts of this transfert are ignored
+	data->state = I2C_RECOVERY;
+	data->result = false;
+	IRQ_ENABLE(flags);
+	
+	released = i2c_master_recover_bus(i2c_id, t->scl, t->sda);
+	
+	// Complete the transfert as the I2C interrupt would
+	RAISE_IPL(flags, i2c_master_get_ipl(i2c_id));
+	data->state = I2C_IDLE;
+	i2c_master_reset(i2c_id);
+	
+	if (t->callback)
+		t->callback(i2c_id, released);
+	if (data->result_callback)
+		data->result_callback(i2c_id, false);
+	IRQ_ENABLE(flags);
+}
+
 /**
 	Read data from a device using the register/value protocol.
 
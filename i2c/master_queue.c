@@ -0,0 +1,310 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup i2c */
+/*@{*/
+
+/** \file
+	Queue of asynchronous I2C master transactions.
+	
+	i2c_master_transfert_async() accepts only one transfert per bus at a time.
+	With i2c_master_queue_transaction(), any number of transactions can be requested:
+	each one is described by an \ref I2C_Transaction owned by the caller, and the transactions
+	of a bus are executed in order. The next transaction is started from the interrupt routine
+	as soon as the stop bit of the previous one has been sent, and the callback of the previous one
+	is then called; the main loop is never involved.
+	
+	\code
+	static I2C_Transaction read_temperature;
+	static unsigned char temperature_register = 0;
+	static unsigned char temperature[2];
+	
+	i2c_master_queue_transaction(I2C_1, &read_temperature, 0x48, &temperature_register, 1, temperature, 2, temperature_read, 0);
+	\endcode
+	
+	A transaction must not be modified while i2c_master_is_transaction_pending() returns true,
+	but can be queued again from its own callback.
+	On a bus used with the queue, do not call i2c_master_transfert_async() or i2c_master_transfert_block() directly.
+	
+	Per-bus statistics are available through i2c_master_get_statistics(); the bus busy time is measured
+	if a time source is given with i2c_master_set_time_source(). In that case, the time each transaction
+	spent on the bus is also available in its bus_time field from its callback on, and the effective
+	throughput of the bus is bytes / busy_time.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include "i2c.h"
+#include "i2c_priv.h"
+
+#include "../types/uc.h"
+#include "../error/error.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Transaction queue of an I2C master */
+typedef struct
+{
+	I2C_Transaction* head;				/**< transaction in progress, 0 if the queue is empty */
+	I2C_Transaction* tail;				/**< last transaction of the queue */
+	unsigned int start_time;			/**< time at which the transaction in progress started */
+	I2C_Master_Statistics statistics;	/**< statistics of the queue */
+} I2C_Master_Queue;
+
+/** data for the transaction queues of I2C 1 to 3 */
+static I2C_Master_Queue I2C_Master_Queues[3];
+
+/** time source for the bus busy time, 0 if not measured */
+static i2c_time_source I2C_Time_Source;
+
+//-------------------
+// Internal callbacks
+//-------------------
+
+static void i2c_master_queue_result(int i2c_id, bool result);
+
+/** Start the transaction at the head of the queue */
+static void i2c_master_queue_start(int i2c_id)
+{
+	I2C_Master_Queue* queue = &I2C_Master_Queues[i2c_id];
+	I2C_Transaction* transaction = queue->head;
+	
+	if (I2C_Time_Source)
+		queue->start_time = I2C_Time_Source();
+	
+	i2c_master_transfert_async(i2c_id, transaction->address, transaction->write_data, transaction->write_count, transaction->read_data, transaction->read_count, i2c_master_queue_result);
+}
+
+/** callback from the protocol layer when the stop bit of a transaction has been sent */
+static void i2c_master_queue_result(int i2c_id, bool result)
+{
+	I2C_Master_Queue* queue = &I2C_Master_Queues[i2c_id];
+	I2C_Transaction* transaction = queue->head;
+	
+	// Account for the completed transaction
+	queue->statistics.transactions++;
+	if (!result)
+		queue->statistics.nacks++;
+	if (I2C_Time_Source)
+	{
+		transaction->bus_time = I2C_Time_Source() - queue->start_time;
+		queue->statistics.busy_time += transaction->bus_time;
+	}
+	else
+	{
+		transaction->bus_time = 0;
+	}
+	if (result)
+	{
+		queue->statistics.bytes += transaction->write_count + transaction->read_count;
+		if (transaction->write_count)
+			queue->statistics.bytes++;
+		if (transaction->read_count)
+			queue->statistics.bytes++;
+	}
+	queue->statistics.queue_depth--;
+	
+	// Start the next one right away, before calling the user
+	queue->head = transaction->next;
+	if (queue->head)
+		i2c_master_queue_start(i2c_id);
+	
+	transaction->pending = false;
+	if (transaction->callback)
+		transaction->callback(i2c_id, transaction, result);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Queue an I2C master transaction, consisting of a combined write/read cycle.
+	
+	The transaction starts immediately if the bus is idle, otherwise after the transactions already queued.
+	Both write_count and read_count may be zero, for write/read only cycle.
+	This function can be called from interrupts, including from the callback of a transaction.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param	transaction
+			descriptor of the transaction, must remain valid until the transaction has completed
+	\param	addr
+			I2C address (7 bits, unshifted)
+	\param	write_data
+			pointer to data to write to device
+	\param	write_count
+			amount of data to write to device
+	\param	read_data
+			pointer where data read from the device will be written
+	\param	read_count
+			amount of data to read from device
+	\param	callback
+			user-defined function to call when the transaction is completed or aborted because of an error, may be 0
+	\param	user_data
+			pointer stored in the transaction, for use by the callback
+*/
+void i2c_master_queue_transaction(int i2c_id, I2C_Transaction* transaction, unsigned char addr, unsigned char* write_data, unsigned write_count, unsigned char* read_data, unsigned read_count, i2c_transaction_callback callback, void* user_data)
+{
+	I2C_Master_Queue* queue;
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	if (transaction->pending)
+		ERROR(I2C_ERROR_TRANSACTION_PENDING, &transaction);
+	
+	transaction->address = addr;
+	transaction->write_data = write_data;
+	transaction->write_count = write_count;
+	transaction->read_data = read_data;
+	transaction->read_count = read_count;
+	transaction->callback = callback;
+	transaction->user_data = user_data;
+	transaction->next = 0;
+	transaction->pending = true;
+	
+	queue = &I2C_Master_Queues[i2c_id];
+	
+	RAISE_IPL(flags, 7);
+	if (++queue->statistics.queue_depth > queue->statistics.max_queue_depth)
+		queue->statistics.max_queue_depth = queue->statistics.queue_depth;
+	
+	if (queue->head)
+	{
+		queue->tail->next = transaction;
+		queue->tail = transaction;
+	}
+	else
+	{
+		queue->head = transaction;
+		queue->tail = transaction;
+		i2c_master_queue_start(i2c_id);
+	}
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Return whether a transaction is queued or in progress.
+	
+	\param	transaction
+			descriptor of the transaction
+	
+	\return	true until the transaction has completed and its callback has been called, false otherwise
+*/
+bool i2c_master_is_transaction_pending(I2C_Transaction* transaction)
+{
+	return transaction->pending;
+}
+
+/**
+	Return whether a transaction is in the queue of an I2C master, waiting or in progress.
+	
+	Unlike i2c_master_is_transaction_pending(), this does not rely on the content of the transaction,
+	so it can be used on a descriptor that may not be initialized yet.
+	
+	\param	transaction
+			descriptor of the transaction
+	
+	\return	true if the transaction is in the queue of any I2C master, false otherwise
+*/
+bool i2c_master_is_transaction_queued(I2C_Transaction* transaction)
+{
+	I2C_Transaction* queued;
+	bool found = false;
+	int flags;
+	int i;
+	
+	RAISE_IPL(flags, 7);
+	for (i = 0; i < 3 && !found; i++)
+		for (queued = I2C_Master_Queues[i].head; queued && !found; queued = queued->next)
+			found = (queued == transaction);
+	IRQ_ENABLE(flags);
+	
+	return found;
+}
+
+/**
+	Set the time source used to measure the bus busy time of all I2C masters.
+	
+	\param	source
+			function returning the current time, for instance a free running timer; 0 to stop measuring
+*/
+void i2c_master_set_time_source(i2c_time_source source)
+{
+	I2C_Time_Source = source;
+}
+
+/**
+	Get the statistics of the transaction queue of an I2C master.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param	statistics
+			structure to fill
+*/
+void i2c_master_get_statistics(int i2c_id, I2C_Master_Statistics* statistics)
+{
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	
+	RAISE_IPL(flags, 7);
+	*statistics = I2C_Master_Queues[i2c_id].statistics;
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Reset the statistics of the transaction queue of an I2C master, except the current queue depth.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+*/
+void i2c_master_reset_statistics(int i2c_id)
+{
+	I2C_Master_Statistics* statistics;
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	statistics = &I2C_Master_Queues[i2c_id].statistics;
+	
+	RAISE_IPL(flags, 7);
+	statistics->transactions = 0;
+	statistics->nacks = 0;
+	statistics->max_queue_depth = statistics->queue_depth;
+	statistics->busy_time = 0;
+	statistics->bytes = 0;
+	IRQ_ENABLE(flags);
+}
+
+/*@}*/
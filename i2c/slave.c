@@ -65,6 +65,7 @@ typedef struct
 	i2c_status_callback message_to_master_callback; /**< function to call upon new read message */
 	i2c_set_data_callback data_from_master_callback; /**< function to call with data from master */
 	i2c_get_data_callback data_to_master_callback; /**< function to call with data to master */
+	i2c_status_callback message_end_callback; /**< function to call when a message ends before its callbacks said so, may be 0 */
 	int state; /**< transmission direction */
 } I2C_Slave_Data;
 
@@ -123,6 +124,7 @@ void i2c_init_slave(
 		I2C_1_Slave_Data.message_to_master_callback = message_to_master_callback;
 		I2C_1_Slave_Data.data_from_master_callback = data_from_master_callback;
 		I2C_1_Slave_Data.data_to_master_callback = data_to_master_callback;
+		I2C_1_Slave_Data.message_end_callback = 0;
 		
 		I2C_1_Slave_Data.state = I2C_IDLE;
 			
@@ -143,6 +145,7 @@ void i2c_init_slave(
 		I2C_2_Slave_Data.message_to_master_callback = message_to_master_callback;
 		I2C_2_Slave_Data.data_from_master_callback = data_from_master_callback;
 		I2C_2_Slave_Data.data_to_master_callback = data_to_master_callback;
+		I2C_2_Slave_Data.message_end_callback = 0;
 		
 		I2C_2_Slave_Data.state = I2C_IDLE;
 
@@ -163,6 +166,7 @@ void i2c_init_slave(
 		I2C_3_Slave_Data.message_to_master_callback = message_to_master_callback;
 		I2C_3_Slave_Data.data_from_master_callback = data_from_master_callback;
 		I2C_3_Slave_Data.data_to_master_callback = data_to_master_callback;
+		I2C_3_Slave_Data.message_end_callback = 0;
 		
 		I2C_3_Slave_Data.state = I2C_IDLE;
 
@@ -204,6 +208,39 @@ void i2c_disable_slave(int i2c_id) {
 #endif
 }
 
+/**
+	Set the function to call when the end of a message is detected by the hardware.
+	
+	The slave wrapper does not get any interrupt at the stop bit, so it relies on the data callbacks
+	returning true to know that a message is over. When they do not know the length of the message,
+	the end is detected when the master does not acknowledge a byte sent by the slave, or when the next message starts,
+	and this function is then called before the callbacks of the next message.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param	message_end_callback
+			function to call, may be 0
+*/
+void i2c_slave_set_end_callback(int i2c_id, i2c_status_callback message_end_callback)
+{
+	i2c_check_range(i2c_id);
+	
+	if (i2c_id == I2C_1)
+		I2C_1_Slave_Data.message_end_callback = message_end_callback;
+#if defined _SI2C2IF
+	else if (i2c_id == I2C_2)
+	{
+		I2C_2_Slave_Data.message_end_callback = message_end_callback;
+	}
+#endif
+#if defined _SI2C3IF
+	else if (i2c_id == I2C_3)
+	{
+		I2C_3_Slave_Data.message_end_callback = message_end_callback;
+	}
+#endif
+}
+
 /**
 	Force I2C internal state machine to return to IDLE,
 	This can be useful, for instance after an electric problem
@@ -246,17 +283,27 @@ void i2c_slave_return_to_idle(int i2c_id)
 void _ISR _SI2C1Interrupt(void)
 {
 	unsigned char data;
+	bool started = false;
 	
 	_SI2C1IF = 0;				// Clear Slave interrupt flag
 
 	// no interrupt is generated at the end of cycle,
 	// nor all way to detect beginning of cycle are buggy
 	// and do not behave as the doc predicts
+	// An address byte however always starts a new message, even if the callbacks did not end the previous one
+	if (I2C_1_Slave_Data.state != I2C_IDLE && !I2C1STATbits.D_A)
+	{
+		I2C_1_Slave_Data.state = I2C_IDLE;
+		if (I2C_1_Slave_Data.message_end_callback)
+			I2C_1_Slave_Data.message_end_callback(I2C_1);
+	}
+	
 	if (I2C_1_Slave_Data.state == I2C_IDLE)
 	{
 		if (I2C1STATbits.R_W)
 		{
 			data = I2C1RCV;
+			started = true;
 			I2C_1_Slave_Data.state = I2C_TO_MASTER;
 			I2C_1_Slave_Data.message_to_master_callback(I2C_1);	
 		}
@@ -274,6 +321,15 @@ void _ISR _SI2C1Interrupt(void)
 	{
 		case I2C_TO_MASTER:
 		{
+			if (!started && I2C1STATbits.ACKSTAT)
+			{
+				// The master did not acknowledge the last byte, the message is over
+				I2C_1_Slave_Data.state = I2C_IDLE;
+				if (I2C_1_Slave_Data.message_end_callback)
+					I2C_1_Slave_Data.message_end_callback(I2C_1);
+				I2C1CONbits.SCLREL = 1;							// Release clock
+				break;
+			}
 			if (I2C_1_Slave_Data.data_to_master_callback(I2C_1, &data))
 				I2C_1_Slave_Data.state = I2C_END_TO_MASTER;
 			I2C1TRN = data; 									// Write data
@@ -309,16 +365,26 @@ void _ISR _SI2C1Interrupt(void)
 void _ISR _SI2C2Interrupt(void)
 {
 	unsigned char data;
+	bool started = false;
 	_SI2C2IF = 0;				// Clear Slave interrupt flag
 	
 	// no interrupt is generated at the end of cycle,
 	// nor all way to detect beginning of cycle are buggy
 	// and do not behave as the doc predicts
+	// An address byte however always starts a new message, even if the callbacks did not end the previous one
+	if (I2C_2_Slave_Data.state != I2C_IDLE && !I2C2STATbits.D_A)
+	{
+		I2C_2_Slave_Data.state = I2C_IDLE;
+		if (I2C_2_Slave_Data.message_end_callback)
+			I2C_2_Slave_Data.message_end_callback(I2C_2);
+	}
+	
 	if (I2C_2_Slave_Data.state == I2C_IDLE)
 	{
 		if (I2C2STATbits.R_W)
 		{
 			data = I2C2RCV;
+			started = true;
 			I2C_2_Slave_Data.state = I2C_TO_MASTER;
 			I2C_2_Slave_Data.message_to_master_callback(I2C_2);
 		}
@@ -336,6 +402,15 @@ void _ISR _SI2C2Interrupt(void)
 	{
 		case I2C_TO_MASTER:
 		{
+			if (!started && I2C2STATbits.ACKSTAT)
+			{
+				// The master did not acknowledge the last byte, the message is over
+				I2C_2_Slave_Data.state = I2C_IDLE;
+				if (I2C_2_Slave_Data.message_end_callback)
+					I2C_2_Slave_Data.message_end_callback(I2C_2);
+				I2C2CONbits.SCLREL = 1;							// Release clock
+				break;
+			}
 			if (I2C_2_Slave_Data.data_to_master_callback(I2C_2, &data))
 				I2C_2_Slave_Data.state = I2C_END_TO_MASTER;
 			I2C2TRN = data; 									// Write data
@@ -370,16 +445,26 @@ void _ISR _SI2C2Interrupt(void)
 void _ISR _SI2C3Interrupt(void)
 {
 	unsigned char data;
+	bool started = false;
 	_SI2C3IF = 0;				// Clear Slave interrupt flag
 	
 	// no interrupt is generated at the end of cycle,
 	// nor all way to detect beginning of cycle are buggy
 	// and do not behave as the doc predicts
+	// An address byte however always starts a new message, even if the callbacks did not end the previous one
+	if (I2C_3_Slave_Data.state != I2C_IDLE && !I2C3STATbits.D_A)
+	{
+		I2C_3_Slave_Data.state = I2C_IDLE;
+		if (I2C_3_Slave_Data.message_end_callback)
+			I2C_3_Slave_Data.message_end_callback(I2C_3);
+	}
+	
 	if (I2C_3_Slave_Data.state == I2C_IDLE)
 	{
 		if (I2C3STATbits.R_W)
 		{
 			data = I2C3RCV;
+			started = true;
 			I2C_3_Slave_Data.state = I2C_TO_MASTER;
 			I2C_3_Slave_Data.message_to_master_callback(I2C_3);
 		}
@@ -397,6 +482,15 @@ void _ISR _SI2C3Interrupt(void)
 	{
 		case I2C_TO_MASTER:
 		{
+			if (!started && I2C3STATbits.ACKSTAT)
+			{
+				// The master did not acknowledge the last byte, the message is over
+				I2C_3_Slave_Data.state = I2C_IDLE;
+				if (I2C_3_Slave_Data.message_end_callback)
+					I2C_3_Slave_Data.message_end_callback(I2C_3);
+				I2C3CONbits.SCLREL = 1;							// Release clock
+				break;
+			}
 			if (I2C_3_Slave_Data.data_to_master_callback(I2C_3, &data))
 				I2C_3_Slave_Data.state = I2C_END_TO_MASTER;
 			I2C3TRN = data; 									// Write data
@@ -0,0 +1,349 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup i2c */
+/*@{*/
+
+/** \file
+	Register map exposed by an I2C slave.
+	
+	Instead of handling each byte in callbacks, an I2C slave can expose an array of byte registers,
+	accessed by the master like most I2C devices:
+	- a write message starts with the register pointer, followed by the values of the registers from this pointer on;
+	- a read message returns the registers from the register pointer on;
+	- the register pointer is incremented after each register, and keeps its value between messages.
+	
+	\code
+	static unsigned char registers[16];
+	static unsigned char shadow[16];
+	static const unsigned char writable[2] = { 0x00, 0xF0 };	// only registers 12 to 15 can be written
+	static I2C_Register_Map map;
+	
+	i2c_init_slave_register_map(I2C_1, 0x20, &map, registers, shadow, 16, NULL, writable, settings_written, NULL, 5);
+	...
+	i2c_register_map_set(&map, 0, &speed, sizeof(speed));
+	\endcode
+	
+	Reads of registers that are not readable return 0, writes to registers that are not writable are ignored,
+	reads past the end of the map return 0xFF and writes past the end are ignored.
+	
+	The master accesses a shadow copy of the registers, so that multi-byte values are never torn:
+	at the start of a read, the registers from the pointer on are copied to the shadow,
+	and the bytes written by the master are copied from the shadow to the registers at the end of the message.
+	The application must access the registers with i2c_register_map_set() and i2c_register_map_get(),
+	which are atomic with respect to the slave interrupt.
+	
+	The written and read callbacks are called at the end of a message, from the slave interrupt.
+	The end of a read is detected when the master does not acknowledge the last byte; as the I2C of the dsPIC33F
+	does not generate an interrupt at the stop bit, the end of a write is only detected at the start of the next message,
+	or when the application calls i2c_register_map_flush(), for instance from its main loop.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <string.h> //memcpy
+
+#include "i2c.h"
+#include "i2c_priv.h"
+
+#include "../types/uc.h"
+#include "../error/error.h"
+
+/** States of a register map message */
+enum I2C_Register_Map_States
+{
+	I2C_REGISTER_MAP_IDLE = 0,		/**< no message */
+	I2C_REGISTER_MAP_POINTER,		/**< write message, waiting for the register pointer */
+	I2C_REGISTER_MAP_WRITING,		/**< write message, receiving register values */
+	I2C_REGISTER_MAP_READING,		/**< read message */
+};
+
+/** Return whether bit i of mask is set, a null mask having all bits set */
+#define I2C_REGISTER_MAP_BIT(mask, i) (!(mask) || ((mask)[(i) >> 3] & (1 << ((i) & 7))))
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** register maps of the I2C 1 to 3 slaves */
+static I2C_Register_Map* I2C_Register_Maps[3];
+
+//-------------------
+// Internal callbacks
+//-------------------
+
+/** End of a message, commit the written registers and call the user */
+static void i2c_register_map_end(int i2c_id)
+{
+	I2C_Register_Map* map = I2C_Register_Maps[i2c_id];
+	unsigned int count = map->position - map->first;
+	unsigned int i;
+	
+	if (map->state == I2C_REGISTER_MAP_WRITING)
+	{
+		for (i = map->first; i < map->position && i < map->size; i++)
+			if (I2C_REGISTER_MAP_BIT(map->writable, i))
+				map->registers[i] = map->shadow[i];
+		map->pointer = map->position;
+		map->state = I2C_REGISTER_MAP_IDLE;
+		if (count && map->written_callback)
+			map->written_callback(i2c_id, map, map->first, count);
+	}
+	else if (map->state == I2C_REGISTER_MAP_READING)
+	{
+		map->pointer = map->position;
+		map->state = I2C_REGISTER_MAP_IDLE;
+		if (count && map->read_callback)
+			map->read_callback(i2c_id, map, map->first, count);
+	}
+	else
+	{
+		map->state = I2C_REGISTER_MAP_IDLE;
+	}
+}
+
+/** Start of a write message */
+static void i2c_register_map_write_start(int i2c_id)
+{
+	I2C_Register_Maps[i2c_id]->state = I2C_REGISTER_MAP_POINTER;
+}
+
+/** Start of a read message, take a snapshot of the registers */
+static void i2c_register_map_read_start(int i2c_id)
+{
+	I2C_Register_Map* map = I2C_Register_Maps[i2c_id];
+	
+	if (map->pointer < map->size)
+		memcpy(map->shadow + map->pointer, map->registers + map->pointer, map->size - map->pointer);
+	map->first = map->pointer;
+	map->position = map->pointer;
+	map->state = I2C_REGISTER_MAP_READING;
+}
+
+/** Byte written by the master */
+static bool i2c_register_map_data_from_master(int i2c_id, unsigned char data)
+{
+	I2C_Register_Map* map = I2C_Register_Maps[i2c_id];
+	
+	if (map->state == I2C_REGISTER_MAP_POINTER)
+	{
+		map->pointer = data;
+		map->first = data;
+		map->position = data;
+		map->state = I2C_REGISTER_MAP_WRITING;
+	}
+	else
+	{
+		if (map->position < map->size)
+			map->shadow[map->position] = data;
+		map->position++;
+	}
+	
+	// The end is detected by the slave wrapper
+	return false;
+}
+
+/** Byte read by the master */
+static bool i2c_register_map_data_to_master(int i2c_id, unsigned char* data)
+{
+	I2C_Register_Map* map = I2C_Register_Maps[i2c_id];
+	
+	if (map->position >= map->size)
+		*data = 0xFF;
+	else if (I2C_REGISTER_MAP_BIT(map->readable, map->position))
+		*data = map->shadow[map->position];
+	else
+		*data = 0;
+	map->position++;
+	
+	// The end is detected by the slave wrapper
+	return false;
+}
+
+/** Return whether the last event on the bus was a stop bit */
+static bool i2c_stop_detected(int i2c_id)
+{
+	if (i2c_id == I2C_1)
+		return I2C1STATbits.P;
+#if defined _SI2C2IF
+	else if (i2c_id == I2C_2)
+		return I2C2STATbits.P;
+#endif
+#if defined _SI2C3IF
+	else if (i2c_id == I2C_3)
+		return I2C3STATbits.P;
+#endif
+	return false;
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Init I2C slave subsystem with a register map.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+	\param  address 
+			Slave address
+	\param	map
+			register map, must remain valid while the slave is enabled
+	\param	registers
+			registers, the register pointer sent by the master being an index in this array
+	\param	shadow
+			array of the same size as registers, used by the slave interrupt
+	\param	size
+			number of registers, up to 256
+	\param	readable
+			bit array, bit i (bit i & 7 of byte i >> 3) being set if register i can be read, 0 if all registers can
+	\param	writable
+			bit array, bit i being set if register i can be written, 0 if all registers can
+	\param	written_callback
+			function to call at the end of a message in which registers were written, may be 0
+	\param	read_callback
+			function to call at the end of a message in which registers were read, may be 0
+	\param 	priority
+			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
+*/
+void i2c_init_slave_register_map(
+	int i2c_id,
+	unsigned char address,
+	I2C_Register_Map* map,
+	unsigned char* registers,
+	unsigned char* shadow,
+	unsigned int size,
+	const unsigned char* readable,
+	const unsigned char* writable,
+	i2c_register_map_callback written_callback,
+	i2c_register_map_callback read_callback,
+	int priority
+)
+{
+	i2c_check_range(i2c_id);
+	ERROR_CHECK_RANGE(size, 1, 256, I2C_ERROR_INVALID_REGISTER);
+	
+	map->registers = registers;
+	map->shadow = shadow;
+	map->readable = readable;
+	map->writable = writable;
+	map->size = size;
+	map->written_callback = written_callback;
+	map->read_callback = read_callback;
+	map->ipl = priority;
+	map->state = I2C_REGISTER_MAP_IDLE;
+	map->pointer = 0;
+	map->first = 0;
+	map->position = 0;
+	
+	I2C_Register_Maps[i2c_id] = map;
+	
+	i2c_init_slave(i2c_id, address, i2c_register_map_write_start, i2c_register_map_read_start, i2c_register_map_data_from_master, i2c_register_map_data_to_master, priority);
+	i2c_slave_set_end_callback(i2c_id, i2c_register_map_end);
+}
+
+/**
+	Write registers of a register map, atomically with respect to the master.
+	
+	\param	map
+			register map
+	\param	first
+			first register to write
+	\param	data
+			values of the registers
+	\param	count
+			number of registers to write
+*/
+void i2c_register_map_set(I2C_Register_Map* map, unsigned int first, const void* data, unsigned int count)
+{
+	int flags;
+	
+	if (first + count > map->size)
+		ERROR(I2C_ERROR_INVALID_REGISTER, &first);
+	
+	RAISE_IPL(flags, map->ipl);
+	memcpy(map->registers + first, data, count);
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Read registers of a register map, atomically with respect to the master.
+	
+	\param	map
+			register map
+	\param	first
+			first register to read
+	\param	data
+			where to copy the values of the registers
+	\param	count
+			number of registers to read
+*/
+void i2c_register_map_get(I2C_Register_Map* map, unsigned int first, void* data, unsigned int count)
+{
+	int flags;
+	
+	if (first + count > map->size)
+		ERROR(I2C_ERROR_INVALID_REGISTER, &first);
+	
+	RAISE_IPL(flags, map->ipl);
+	memcpy(data, map->registers + first, count);
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Commit a write message of the master that ended with a stop bit.
+	
+	The end of a write message is otherwise only detected at the start of the next message.
+	
+	\param	i2c_id
+			identifier of the I2C, \ref I2C_1 or \ref I2C_2
+*/
+void i2c_register_map_flush(int i2c_id)
+{
+	I2C_Register_Map* map;
+	int flags;
+	
+	i2c_check_range(i2c_id);
+	map = I2C_Register_Maps[i2c_id];
+	if (!map)
+		return;
+	
+	RAISE_IPL(flags, map->ipl);
+	if (map->state == I2C_REGISTER_MAP_WRITING && i2c_stop_detected(i2c_id))
+	{
+		i2c_slave_return_to_idle(i2c_id);
+		i2c_register_map_end(i2c_id);
+	}
+	IRQ_ENABLE(flags);
+}
+
+/*@}*/
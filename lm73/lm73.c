@@ -24,6 +24,7 @@
 
 #include "../error/error.h"
 #include "../i2c/i2c.h"
+#include "../i2c-poll/i2c-poll.h"
 
 
 #include "lm73.h"
@@ -33,28 +34,39 @@ lm73_temp_cb temp_cb;
 // For the async temperature updated
 static unsigned char swdata[1] = {0x0};
 static unsigned char srdata[2];
+static I2C_Transaction stransaction;
 
-void cb_i2c(int i2c_id, bool result) {
+void cb_i2c(int i2c_id, I2C_Transaction* transaction, bool result) {
 	temp_cb((((int) srdata[0]) << 8) | srdata[1]);
 }
 
+// Blocking transfert through the transaction queue, so that the bus can be shared with polling jobs
+static void lm73_transfert(int i2c_bus, int addr, unsigned char* wdata, unsigned wcount, unsigned char* rdata, unsigned rcount) {
+	I2C_Transaction transaction;
+	
+	transaction.pending = false;
+	i2c_master_queue_transaction(i2c_bus, &transaction, addr, wdata, wcount, rdata, rcount, NULL, NULL);
+	while (i2c_master_is_transaction_pending(&transaction))
+		barrier();
+}
+
 void lm73_set_fault_condition(int i2c_bus, int addr, int templow, int temphigh, int pol) {
 	unsigned char wdata[3];
 	
 	wdata[0] = 0x02;
 	wdata[1] = temphigh >> 8;
 	wdata[2] = temphigh & 0xF0;
-	i2c_master_transfert_block(i2c_bus, addr, wdata, 3, NULL, 0);
+	lm73_transfert(i2c_bus, addr, wdata, 3, NULL, 0);
 	
 	wdata[0] = 0x03;
 	wdata[1] = templow >> 8;
 	wdata[2] = templow & 0xF0;
-	i2c_master_transfert_block(i2c_bus, addr, wdata, 3, NULL, 0);
+	lm73_transfert(i2c_bus, addr, wdata, 3, NULL, 0);
 	
 	
 	wdata[0] = 0x01;
 	wdata[1] = 0x40 | ((pol & 0x1) << 4) ; // Enable fault pin
-	i2c_master_transfert_block(i2c_bus, addr, wdata, 2, NULL, 0);
+	lm73_transfert(i2c_bus, addr, wdata, 2, NULL, 0);
 }
 
 
@@ -63,21 +75,36 @@ void lm73_set_resolution(int i2c_bus, int addr, int res) {
 
 	wdata[0] = 0x4;
 	wdata[1] = (res & 0x3) << 5;
-	i2c_master_transfert_block(i2c_bus, addr, wdata, 2, NULL, 0);
+	lm73_transfert(i2c_bus, addr, wdata, 2, NULL, 0);
 }
 
 int  lm73_temp_read_b(int i2c_bus, int addr) {
 	unsigned char wdata[1];
 	unsigned char rdata[2];
 	wdata[0] = 0x0;
-	i2c_master_transfert_block(i2c_bus, addr, wdata, 1, rdata, 2);
+	lm73_transfert(i2c_bus, addr, wdata, 1, rdata, 2);
 	return (((int) rdata[0]) << 8) | (rdata[1]);
 }
 
 
 void lm73_temp_read_a(int i2c_bus, int addr, lm73_temp_cb cb) {
 	temp_cb = cb;
-	i2c_master_transfert_async(i2c_bus, addr, swdata, 1, srdata, 2, cb_i2c);
+	i2c_master_queue_transaction(i2c_bus, &stransaction, addr, swdata, 1, srdata, 2, cb_i2c, NULL);
+}
+
+// Read the temperature every period soft-timer ticks, without blocking
+void lm73_poll_start(I2C_Poll_Job* job, int i2c_bus, int addr, unsigned long period) {
+	i2c_poll_add(job, i2c_bus, addr, 0x0, 2, period, NULL, NULL);
+}
+
+// Return false if the temperature has not been read yet
+bool lm73_poll_get(I2C_Poll_Job* job, int* temperature) {
+	unsigned char rdata[2];
+	
+	if (!i2c_poll_get(job, rdata))
+		return false;
+	*temperature = (((int) rdata[0]) << 8) | rdata[1];
+	return true;
 }
 
 
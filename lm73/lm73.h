@@ -25,6 +25,8 @@
 #ifndef _MOLOLE_LM73_H
 #define _MOLOLE_LM73_H
 
+#include "../i2c-poll/i2c-poll.h"
+
 #define LM73_FAULT_POLARITY_HIGH 1
 #define LM73_FAULT_POLARITY_LOW 0
 
@@ -39,6 +41,8 @@ void lm73_set_fault_condition(int i2c_bus, int addr, int templow, int temphigh,
 void lm73_set_resolution(int i2c_bus, int addr, int res);
 int  lm73_temp_read_b(int i2c_bus, int addr);
 void lm73_temp_read_a(int i2c_bus, int addr, lm73_temp_cb cb);
+void lm73_poll_start(I2C_Poll_Job* job, int i2c_bus, int addr, unsigned long period);
+bool lm73_poll_get(I2C_Poll_Job* job, int* temperature);
 
 
 #endif
@@ -0,0 +1,566 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+	\defgroup packet Packet
+	
+	Framed packet transport over an UART, with COBS framing and CRC-16.
+	
+	Each packet is followed by a CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF, most significant byte first),
+	then encoded with Consistent Overhead Byte Stuffing (COBS), and terminated by a 0 byte.
+	As the 0 byte never appears inside a frame, the receiver resynchronizes on the next delimiter after any error.
+	The overhead is 3 bytes plus 1 byte every 254 bytes.
+	
+	Reception decodes the frames directly into a pool of buffers provided by the caller, in the interrupt routine of the UART.
+	Frames with a valid CRC are passed without copy to a callback, which either releases the buffer immediately by
+	returning true, or keeps it, for instance to process it in the main loop, and releases it later with packet_release().
+	Frames arriving while all buffers are held are dropped and counted as overruns.
+	
+	Transmission encodes the frame lazily from a list of segments, for instance a header and a payload,
+	so the packet does not need to be assembled in memory. The segments must remain valid until packet_is_sending()
+	returns false.
+	
+	\code
+	unsigned char buffers[4 * 66];
+	Packet_Link link;
+	
+	packet_init(&link, UART_1, buffers, 66, 4, packet_received_callback, NULL);
+	uart_init(UART_1, 115200, false, packet_uart_byte_received, packet_uart_tx_ready, 5, &link);
+	\endcode
+	
+	The link can also be fed by packet_receive_bytes(), for instance from the block callback of uart_init_dma();
+	packet_uart_tx_ready() can be used with the byte driver of the UART or of the software flow control UART.
+	
+	tests/packet-test.c loops frames back on the host (make -C tests check), and tests/packet-bench.c
+	measures the encoding and decoding throughput (make -C tests bench).
+*/
+/*@{*/
+
+/** \file
+	Implementation of the framed packet transport.
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include "packet.h"
+#include "../uart/uart.h"
+#include "../error/error.h"
+
+/** States of the COBS decoder */
+enum packet_rx_states
+{
+	PACKET_RX_IDLE = 0,		/**< waiting for the first code of a frame */
+	PACKET_RX_RECEIVING,	/**< decoding a frame into rx */
+	PACKET_RX_DROPPING,		/**< dropping bytes until the next delimiter */
+};
+
+/** States of the COBS encoder */
+enum packet_tx_states
+{
+	PACKET_TX_CODE = 0,		/**< next byte is the code of a block */
+	PACKET_TX_BLOCK,		/**< next byte is inside a block */
+	PACKET_TX_DELIMITER,	/**< next byte is the frame delimiter */
+	PACKET_TX_DONE,			/**< frame completely sent */
+};
+
+/** CRC-16/CCITT table, polynomial 0x1021 */
+static const unsigned int packet_crc_table[256] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+/** Update a CRC-16/CCITT with one byte */
+#define PACKET_CRC_UPDATE(crc, byte) (((crc) << 8) ^ packet_crc_table[(((crc) >> 8) ^ (byte)) & 0xFF])
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Read the next byte of the segments and CRC being sent, return false at the end */
+static bool next_input_byte(Packet_Link* link, unsigned int* segment, unsigned int* offset, unsigned char* byte)
+{
+	// Skip empty segments
+	while (*segment < link->tx_count && *offset >= link->tx_segments[*segment].length)
+	{
+		(*segment)++;
+		*offset = 0;
+	}
+	
+	if (*segment < link->tx_count)
+		*byte = link->tx_segments[*segment].data[*offset];
+	else if (*offset < 2)
+		*byte = link->tx_crc[*offset];
+	else
+		return false;
+	
+	(*offset)++;
+	return true;
+}
+
+/** Return whether all the segments and the CRC have been read */
+static bool input_ended(Packet_Link* link)
+{
+	unsigned int segment = link->tx_segment;
+	unsigned int offset = link->tx_offset;
+	unsigned char byte;
+	
+	return !next_input_byte(link, &segment, &offset, &byte);
+}
+
+/** Start the next COBS block: count the non-zero bytes that follow, up to 254 */
+static void start_block(Packet_Link* link)
+{
+	unsigned int segment = link->tx_segment;
+	unsigned int offset = link->tx_offset;
+	unsigned char byte;
+	unsigned char length = 0;
+	
+	while (length < 0xFE && next_input_byte(link, &segment, &offset, &byte) && byte != 0)
+		length++;
+	
+	link->tx_code = length + 1;
+	link->tx_remaining = length;
+}
+
+/** Move to the state following the end of a block */
+static void end_block(Packet_Link* link)
+{
+	unsigned char byte;
+	
+	if (input_ended(link))
+	{
+		link->tx_state = PACKET_TX_DELIMITER;
+		return;
+	}
+	
+	// A block shorter than 254 bytes stands for the 0 byte that follows it
+	if (link->tx_code != 0xFF)
+		next_input_byte(link, &link->tx_segment, &link->tx_offset, &byte);
+	
+	link->tx_state = PACKET_TX_CODE;
+}
+
+/** Produce the next byte of the encoded frame, return false when the frame is completely produced */
+static bool next_output_byte(Packet_Link* link, unsigned char* data)
+{
+	switch (link->tx_state)
+	{
+		case PACKET_TX_CODE:
+			start_block(link);
+			*data = link->tx_code;
+			if (link->tx_remaining)
+				link->tx_state = PACKET_TX_BLOCK;
+			else
+				end_block(link);
+			return true;
+		
+		case PACKET_TX_BLOCK:
+			next_input_byte(link, &link->tx_segment, &link->tx_offset, data);
+			if (--link->tx_remaining == 0)
+				end_block(link);
+			return true;
+		
+		case PACKET_TX_DELIMITER:
+			*data = 0;
+			link->tx_state = PACKET_TX_DONE;
+			return true;
+		
+		default:
+			return false;
+	}
+}
+
+/** Return the first buffer not held by the user, or 0 if all are held */
+static unsigned char* get_free_buffer(Packet_Link* link)
+{
+	unsigned int i;
+	
+	for (i = 0; i < link->buffer_count; i++)
+		if (!(link->held & (1U << i)))
+			return link->buffers + i * link->buffer_size;
+	
+	return 0;
+}
+
+/** Append a decoded byte to the frame being received */
+static void append_byte(Packet_Link* link, unsigned char byte)
+{
+	if (link->rx_state != PACKET_RX_RECEIVING)
+		return;
+	
+	if (link->rx_length == link->buffer_size)
+	{
+		link->statistics.overruns++;
+		link->rx_state = PACKET_RX_DROPPING;
+		return;
+	}
+	
+	link->rx[link->rx_length++] = byte;
+	link->rx_crc = PACKET_CRC_UPDATE(link->rx_crc, byte);
+}
+
+/** Handle the end of a frame, deliver it if valid */
+static void end_frame(Packet_Link* link)
+{
+	unsigned int index;
+	
+	if (link->rx_state == PACKET_RX_RECEIVING)
+	{
+		// A frame must end at the end of a block, and the CRC of the data followed by their CRC is 0
+		if (link->rx_remaining != 0 || link->rx_length < 2 || (link->rx_crc & 0xFFFF) != 0)
+		{
+			link->statistics.crc_errors++;
+		}
+		else
+		{
+			index = (link->rx - link->buffers) / link->buffer_size;
+			link->held |= 1U << index;
+			link->statistics.frames_received++;
+			if (link->received_callback(link, link->rx, link->rx_length - 2, link->user_data))
+				link->held &= ~(1U << index);
+		}
+	}
+	
+	link->rx_state = PACKET_RX_IDLE;
+	link->rx_code = 0;
+	link->rx_remaining = 0;
+}
+
+/** Decode one received byte */
+static void receive_byte(Packet_Link* link, unsigned char byte)
+{
+	if (byte == 0)
+	{
+		end_frame(link);
+		return;
+	}
+	
+	if (link->rx_state == PACKET_RX_IDLE)
+	{
+		link->rx = get_free_buffer(link);
+		link->rx_length = 0;
+		link->rx_crc = 0xFFFF;
+		if (link->rx)
+		{
+			link->rx_state = PACKET_RX_RECEIVING;
+		}
+		else
+		{
+			link->statistics.overruns++;
+			link->rx_state = PACKET_RX_DROPPING;
+		}
+	}
+	
+	if (link->rx_remaining == 0)
+	{
+		// Code byte, the previous block stands for a 0 unless it was of maximal length
+		if (link->rx_code != 0 && link->rx_code != 0xFF)
+			append_byte(link, 0);
+		link->rx_code = byte;
+		link->rx_remaining = byte - 1;
+	}
+	else
+	{
+		append_byte(link, byte);
+		link->rx_remaining--;
+	}
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Compute the CRC-16/CCITT of a block of data.
+	
+	\param	crc
+			Initial value, 0xFFFF for a new CRC, or the result of a previous call to continue it.
+	\param	data
+			Data to process.
+	\param	length
+			Number of bytes of data.
+	\return	The updated CRC.
+*/
+unsigned int packet_crc16(unsigned int crc, const unsigned char* data, unsigned int length)
+{
+	while (length--)
+		crc = PACKET_CRC_UPDATE(crc, *data++);
+	
+	return crc & 0xFFFF;
+}
+
+/**
+	Initialize a packet link.
+	
+	The UART must then be initialized with packet_uart_byte_received() and packet_uart_tx_ready() as callbacks
+	and the link as user data, or the received bytes be passed to packet_receive_bytes().
+	
+	\param	link
+			Packet link to initialize, must remain valid while the link is used.
+	\param	uart_id
+			Identifier of the UART, \ref UART_1 or \ref UART_2.
+	\param	buffers
+			Reception buffers, buffer_count contiguous buffers of buffer_size bytes.
+	\param	buffer_size
+			Size of each reception buffer, the largest packet that can be received plus 2 bytes of CRC.
+	\param	buffer_count
+			Number of reception buffers, from 1 to \ref PACKET_MAX_BUFFERS.
+	\param	received_callback
+			Function to call when a valid packet is received, in the interrupt routine of the UART.
+	\param	user_data
+			Pointer to arbitrary data passed to received_callback.
+*/
+void packet_init(Packet_Link* link, int uart_id, unsigned char* buffers, unsigned int buffer_size, unsigned int buffer_count, packet_received received_callback, void* user_data)
+{
+	if (buffer_count == 0 || buffer_count > PACKET_MAX_BUFFERS || buffer_size < 3)
+		ERROR(PACKET_ERROR_INVALID_BUFFERS, &buffer_count);
+	
+	link->uart_id = uart_id;
+	link->received_callback = received_callback;
+	link->user_data = user_data;
+	
+	link->buffers = buffers;
+	link->buffer_size = buffer_size;
+	link->buffer_count = buffer_count;
+	link->held = 0;
+	link->rx = 0;
+	link->rx_length = 0;
+	link->rx_crc = 0xFFFF;
+	link->rx_state = PACKET_RX_IDLE;
+	link->rx_code = 0;
+	link->rx_remaining = 0;
+	
+	link->tx_segments = 0;
+	link->tx_count = 0;
+	link->tx_state = PACKET_TX_DONE;
+	
+	link->statistics.frames_received = 0;
+	link->statistics.frames_sent = 0;
+	link->statistics.crc_errors = 0;
+	link->statistics.overruns = 0;
+}
+
+/**
+	Send a packet made of several segments.
+	
+	The frame is encoded while it is transmitted, so the segments and their data must not
+	be modified until packet_is_sending() returns false.
+	
+	\param	link
+			Packet link.
+	\param	segments
+			Parts of the packet, sent one after the other.
+	\param	count
+			Number of segments.
+	\return	true if the packet is being sent, false if a previous packet is still being sent.
+*/
+bool packet_send(Packet_Link* link, const Packet_Segment* segments, unsigned int count)
+{
+	unsigned int crc = 0xFFFF;
+	unsigned int i;
+	unsigned char data;
+	int flags;
+	
+	if (link->tx_segments)
+		return false;
+	
+	for (i = 0; i < count; i++)
+		crc = packet_crc16(crc, segments[i].data, segments[i].length);
+	
+	link->tx_crc[0] = crc >> 8;
+	link->tx_crc[1] = crc;
+	link->tx_count = count;
+	link->tx_segment = 0;
+	link->tx_offset = 0;
+	link->tx_state = PACKET_TX_CODE;
+	
+	// Give the first byte to the UART, the following ones are requested by its interrupt
+	RAISE_IPL(flags, 7);
+	link->tx_segments = segments;
+	next_output_byte(link, &data);
+	if (!uart_transmit_byte(link->uart_id, data))
+	{
+		// The UART is still sending the end of the previous frame, restart this one from its interrupt
+		link->tx_segment = 0;
+		link->tx_offset = 0;
+		link->tx_state = PACKET_TX_CODE;
+	}
+	IRQ_ENABLE(flags);
+	
+	return true;
+}
+
+/**
+	Return whether a packet is being sent.
+	
+	\param	link
+			Packet link.
+	\return	true if the segments of the last packet are still in use, false otherwise.
+*/
+bool packet_is_sending(Packet_Link* link)
+{
+	return link->tx_segments != 0;
+}
+
+/**
+	Release a reception buffer kept by the received callback.
+	
+	\param	link
+			Packet link.
+	\param	data
+			Data pointer passed to the received callback.
+*/
+void packet_release(Packet_Link* link, unsigned char* data)
+{
+	unsigned int index = (data - link->buffers) / link->buffer_size;
+	
+	if (data < link->buffers || index >= link->buffer_count || !(link->held & (1U << index)))
+		ERROR(PACKET_ERROR_NOT_HELD, &data);
+	
+	atomic_and(&link->held, ~(1U << index));
+}
+
+/**
+	Decode received bytes.
+	
+	Use this function when the bytes are not received through packet_uart_byte_received(),
+	for instance in the block callback of uart_init_dma(). It must be called at the
+	same interrupt priority level as packet_release() can be preempted by.
+	
+	\param	link
+			Packet link.
+	\param	data
+			Received bytes.
+	\param	length
+			Number of bytes.
+*/
+void packet_receive_bytes(Packet_Link* link, const unsigned char* data, unsigned int length)
+{
+	while (length--)
+		receive_byte(link, *data++);
+}
+
+/**
+	UART byte received callback of a packet link.
+	
+	\param	uart_id
+			Identifier of the UART.
+	\param	data
+			Received byte.
+	\param	user_data
+			Packet link.
+	\return	true, the byte is always accepted.
+*/
+bool packet_uart_byte_received(int uart_id, unsigned char data, void* user_data)
+{
+	receive_byte((Packet_Link*)user_data, data);
+	return true;
+}
+
+/**
+	UART tx ready callback of a packet link.
+	
+	\param	uart_id
+			Identifier of the UART.
+	\param	data
+			Byte to send.
+	\param	user_data
+			Packet link.
+	\return	true if a byte must be sent, false if no packet is being sent.
+*/
+bool packet_uart_tx_ready(int uart_id, unsigned char* data, void* user_data)
+{
+	Packet_Link* link = (Packet_Link*)user_data;
+	
+	if (!link->tx_segments)
+		return false;
+	
+	if (next_output_byte(link, data))
+		return true;
+	
+	link->tx_segments = 0;
+	link->statistics.frames_sent++;
+	return false;
+}
+
+/**
+	Get the counters of a packet link.
+	
+	\param	link
+			Packet link.
+	\param	statistics
+			Structure to fill.
+*/
+void packet_get_statistics(Packet_Link* link, Packet_Statistics* statistics)
+{
+	int flags;
+	
+	RAISE_IPL(flags, 7);
+	*statistics = link->statistics;
+	IRQ_ENABLE(flags);
+}
+
+/*@}*/
@@ -0,0 +1,127 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_PACKET_H
+#define _MOLOLE_PACKET_H
+
+#include "../types/types.h"
+
+/** \addtogroup packet */
+/*@{*/
+
+/** \file
+	\brief Framed packet transport over UART, with COBS framing and CRC-16.
+*/
+
+// Defines
+
+/** Errors packet can throw */
+enum packet_errors
+{
+	PACKET_ERROR_BASE = 0x1600,
+	PACKET_ERROR_INVALID_BUFFERS,		/**< The reception buffers are not between 1 and PACKET_MAX_BUFFERS buffers of at least 3 bytes. */
+	PACKET_ERROR_NOT_HELD,				/**< The released buffer is not a reception buffer held by the user. */
+};
+
+/** Maximum number of reception buffers of a link */
+#define PACKET_MAX_BUFFERS 16
+
+/** One part of a packet to send */
+typedef struct
+{
+	const unsigned char* data;			/**< bytes of the part */
+	unsigned int length;				/**< number of bytes */
+} Packet_Segment;
+
+/** Packet link over an UART */
+typedef struct _Packet_Link Packet_Link;
+
+/** Callback when a packet with a valid CRC is received.
+	data points into a reception buffer, and remains valid until the buffer is released.
+	Return true to release the buffer immediately, false to keep it until packet_release(). */
+typedef bool (*packet_received)(Packet_Link* link, unsigned char* data, unsigned int length, void* user_data);
+
+/** Counters of a packet link */
+typedef struct
+{
+	unsigned long frames_received;		/**< frames delivered to the user */
+	unsigned long frames_sent;			/**< frames completely passed to the UART */
+	unsigned long crc_errors;			/**< frames dropped because of a bad CRC or a bad COBS encoding */
+	unsigned long overruns;				/**< frames dropped because they were too long or no buffer was free */
+} Packet_Statistics;
+
+/** Packet link over an UART; the caller owns the storage, the fields are private */
+struct _Packet_Link
+{
+	int uart_id;						/**< identifier of the UART */
+	packet_received received_callback;	/**< function to call when a packet is received */
+	void* user_data;					/**< argument of received_callback */
+	
+	unsigned char* buffers;				/**< reception buffers, contiguous */
+	unsigned int buffer_size;			/**< size of each reception buffer */
+	unsigned int buffer_count;			/**< number of reception buffers */
+	unsigned int held;					/**< bit n is set if buffer n is held by the user */
+	unsigned char* rx;					/**< buffer being received, 0 if the frame is dropped */
+	unsigned int rx_length;				/**< decoded bytes in rx */
+	unsigned int rx_crc;				/**< CRC of the decoded bytes */
+	unsigned char rx_state;				/**< state of the COBS decoder */
+	unsigned char rx_code;				/**< COBS code of the current block, 0 before the first block */
+	unsigned char rx_remaining;			/**< bytes remaining in the current block, 0 if the next byte is a code */
+	
+	const Packet_Segment* tx_segments;	/**< segments being sent, 0 if idle */
+	unsigned int tx_count;				/**< number of segments */
+	unsigned int tx_segment;			/**< segment of the next byte */
+	unsigned int tx_offset;				/**< offset of the next byte in its segment */
+	unsigned char tx_crc[2];			/**< CRC, sent after the segments */
+	unsigned char tx_state;				/**< state of the COBS encoder */
+	unsigned char tx_remaining;			/**< bytes remaining in the current block */
+	unsigned char tx_code;				/**< COBS code of the current block */
+	
+	Packet_Statistics statistics;		/**< counters */
+};
+
+// Functions, doc in the .c
+
+unsigned int packet_crc16(unsigned int crc, const unsigned char* data, unsigned int length);
+
+void packet_init(Packet_Link* link, int uart_id, unsigned char* buffers, unsigned int buffer_size, unsigned int buffer_count, packet_received received_callback, void* user_data);
+
+bool packet_send(Packet_Link* link, const Packet_Segment* segments, unsigned int count);
+
+bool packet_is_sending(Packet_Link* link);
+
+void packet_release(Packet_Link* link, unsigned char* data);
+
+void packet_receive_bytes(Packet_Link* link, const unsigned char* data, unsigned int length);
+
+bool packet_uart_byte_received(int uart_id, unsigned char data, void* user_data);
+
+bool packet_uart_tx_ready(int uart_id, unsigned char* data, void* user_data);
+
+void packet_get_statistics(Packet_Link* link, Packet_Statistics* statistics);
+
+/*@}*/
+
+#endif
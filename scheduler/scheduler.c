@@ -0,0 +1,315 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+
+\defgroup scheduler Scheduler
+
+A rate-monotonic periodic task scheduler.
+
+\section Introduction
+
+This module runs periodic tasks of different rates from a single hardware timer.
+The timer runs at the base rate, and each task runs every \e divider base ticks.
+The interrupt priority of each task is derived from its rate, following the rate-monotonic rule:
+the tasks with the smallest divider run at the priority given to scheduler_init(),
+the tasks with the next smallest divider one level below, and so on down to priority 1.
+Faster tasks thus preempt slower ones, without any hand-assigned priority.
+
+For each task, the scheduler counts the overruns, that is the number of times the task was due
+while its previous run was not completed, and records the worst-case duration of a run.
+This duration includes the preemption by faster tasks, so it is the worst-case response time of the task.
+Phase offsets allow to spread slow tasks on different base ticks.
+
+\section Usage
+
+\code
+Scheduler_Task tasks[] =
+{
+	{ current_loop, NULL, 1, 0 },							// 10 kHz
+	{ speed_loop, NULL, 10, SCHEDULER_PHASE_AUTO },			// 1 kHz
+	{ position_loop, NULL, 100, SCHEDULER_PHASE_AUTO },		// 100 Hz
+	{ telemetry, NULL, 1000, SCHEDULER_PHASE_AUTO },		// 10 Hz
+};
+
+scheduler_init(TIMER_1, 100, 6, tasks, 4, 6);				// 100 us base tick, current_loop at IPL 6
+\endcode
+
+The tasks run in interrupt context, at IPL 6 to 3 in this example.
+The statistics fields of \ref Scheduler_Task can be read at any time, and cleared with scheduler_reset_statistics().
+
+*/
+/*@{*/
+
+/** \file
+	Implementation of the rate-monotonic periodic task scheduler.
+*/
+
+//---------
+// Includes
+//---------
+
+#include "scheduler.h"
+#include "../timer/timer.h"
+#include "../error/error.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Scheduler data */
+static struct
+{
+	Scheduler_Task* tasks;						/**< tasks, owned by the caller */
+	unsigned int count;							/**< number of tasks */
+	unsigned char order[SCHEDULER_MAX_TASKS];	/**< indices of the tasks, by decreasing rate */
+	int timer_id;								/**< hardware timer generating the base tick */
+	unsigned int ipl;							/**< IPL of the hardware timer interrupt */
+	unsigned long period_counts;				/**< number of timer counts in one base tick */
+	unsigned long ticks;						/**< number of base ticks since scheduler_init() */
+	unsigned int current_ipl;					/**< IPL of the innermost running task, 0 if none */
+	bool is_initialized;						/**< true if scheduler_init() was called */
+} Scheduler_Data;
+
+
+//-------------------
+// Internal functions
+//-------------------
+
+/** Return the time since scheduler_init() in timer counts, wrapping around */
+static unsigned long scheduler_now(void)
+{
+	unsigned long ticks;
+	unsigned long counts;
+	bool pending;
+	
+	do {
+		ticks = Scheduler_Data.ticks;
+		barrier();
+		counts = timer_get_value(Scheduler_Data.timer_id);
+		pending = timer_get_if(Scheduler_Data.timer_id);
+		barrier();
+	} while (ticks != Scheduler_Data.ticks);
+	
+	// A base tick elapsed but was not accounted yet, because we run at the timer IPL
+	if (pending && counts < Scheduler_Data.period_counts / 2)
+		ticks++;
+	
+	return ticks * Scheduler_Data.period_counts + counts;
+}
+
+/** Run a task at its IPL, must be called at the timer IPL */
+static void scheduler_run_task(Scheduler_Task* task, unsigned int saved_ipl)
+{
+	unsigned long start;
+	unsigned long duration;
+	
+	task->pending = false;
+	task->running = true;
+	Scheduler_Data.current_ipl = task->ipl;
+	
+	start = scheduler_now();
+	
+	// Let faster tasks preempt this one
+	SET_IPL(task->ipl);
+	task->callback(task->user_data);
+	duration = scheduler_now() - start;
+	SET_IPL(Scheduler_Data.ipl);
+	
+	if (duration > task->max_duration)
+		task->max_duration = duration;
+	task->runs++;
+	task->running = false;
+	Scheduler_Data.current_ipl = saved_ipl;
+}
+
+/** Hardware timer callback, release the due tasks and run the ones faster than the preempted task */
+static void scheduler_timer_cb(int __attribute__((unused)) timer_id)
+{
+	unsigned int saved_ipl = Scheduler_Data.current_ipl;
+	Scheduler_Task* task;
+	unsigned int i;
+	
+	Scheduler_Data.ticks++;
+	
+	// Release the due tasks
+	for (i = 0; i < Scheduler_Data.count; i++)
+	{
+		task = &Scheduler_Data.tasks[i];
+		if (task->countdown)
+		{
+			task->countdown--;
+			continue;
+		}
+		task->countdown = task->divider - 1;
+		
+		if (task->pending || task->running)
+			task->overruns++;
+		task->pending = true;
+	}
+	
+	// Run the pending tasks by decreasing rate, restarting from the fastest after each run
+	// because a nested tick may have released faster tasks. Tasks not faster than the
+	// preempted one are left to the outer invocation.
+	i = 0;
+	while (i < Scheduler_Data.count)
+	{
+		task = &Scheduler_Data.tasks[Scheduler_Data.order[i]];
+		if (task->ipl <= saved_ipl)
+			break;
+		
+		if (task->pending && !task->running)
+		{
+			scheduler_run_task(task, saved_ipl);
+			i = 0;
+		}
+		else
+			i++;
+	}
+}
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize the scheduler and start the hardware timer generating the base tick.
+	
+	\param	timer_id
+			The hardware timer, one of \ref timer_identifiers; it is reserved by this module.
+	\param	base_period
+			The period of the base tick, expressed in the unit defined by the \e unit parameter
+	\param	unit
+			Time base of the \e base_period parameter, see timer_init()
+	\param	tasks
+			Array of tasks, owned by the caller. The callback, user_data, divider and phase fields must be set,
+			the other fields are initialized by this function.
+	\param	count
+			Number of tasks, at most \ref SCHEDULER_MAX_TASKS
+	\param 	priority
+			Interrupt priority of the fastest tasks, from 1 (lowest priority) to 6 (highest normal priority).
+			Slower tasks run at lower priorities, down to 1.
+*/
+void scheduler_init(int timer_id, unsigned long base_period, int unit, Scheduler_Task* tasks, unsigned int count, int priority)
+{
+	unsigned int i, j;
+	unsigned int ipl;
+	unsigned int auto_phase = 0;
+	unsigned char index;
+	Scheduler_Task* task;
+	
+	if (Scheduler_Data.is_initialized)
+		ERROR(SCHEDULER_ERROR_ALREADY_INITIALIZED, &timer_id);
+	if (count > SCHEDULER_MAX_TASKS)
+		ERROR(SCHEDULER_ERROR_TOO_MANY_TASKS, &count);
+	ERROR_CHECK_RANGE(priority, 1, 6, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
+	
+	// Sort the tasks by increasing divider, that is by decreasing rate
+	for (i = 0; i < count; i++)
+	{
+		if (tasks[i].divider == 0)
+			ERROR(SCHEDULER_ERROR_INVALID_DIVIDER, &i);
+		
+		index = i;
+		for (j = i; j > 0 && tasks[Scheduler_Data.order[j - 1]].divider > tasks[index].divider; j--)
+			Scheduler_Data.order[j] = Scheduler_Data.order[j - 1];
+		Scheduler_Data.order[j] = index;
+	}
+	
+	// Derive the IPLs from the rates and set the phases
+	ipl = priority;
+	for (i = 0; i < count; i++)
+	{
+		task = &tasks[Scheduler_Data.order[i]];
+		if (i > 0 && task->divider != tasks[Scheduler_Data.order[i - 1]].divider && ipl > 1)
+			ipl--;
+		task->ipl = ipl;
+		
+		// Spread the slow tasks over different base ticks
+		if (task->phase == SCHEDULER_PHASE_AUTO)
+			task->phase = task->divider > 1 ? auto_phase++ % task->divider : 0;
+		task->countdown = task->phase % task->divider;
+		
+		task->overruns = 0;
+		task->runs = 0;
+		task->max_duration = 0;
+		task->pending = false;
+		task->running = false;
+	}
+	
+	Scheduler_Data.tasks = tasks;
+	Scheduler_Data.count = count;
+	Scheduler_Data.timer_id = timer_id;
+	Scheduler_Data.ipl = priority;
+	Scheduler_Data.ticks = 0;
+	Scheduler_Data.current_ipl = 0;
+	Scheduler_Data.is_initialized = true;
+	
+	timer_init(timer_id, base_period, unit);
+	Scheduler_Data.period_counts = timer_get_period(timer_id) + 1;
+	timer_enable_interrupt(timer_id, scheduler_timer_cb, priority);
+	timer_enable(timer_id);
+}
+
+/**
+	Clear the overrun counters, the run counters and the worst-case durations of all tasks.
+*/
+void scheduler_reset_statistics(void)
+{
+	unsigned int i;
+	int flags;
+	
+	RAISE_IPL(flags, Scheduler_Data.ipl);
+	
+	for (i = 0; i < Scheduler_Data.count; i++)
+	{
+		Scheduler_Data.tasks[i].overruns = 0;
+		Scheduler_Data.tasks[i].runs = 0;
+		Scheduler_Data.tasks[i].max_duration = 0;
+	}
+	
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Return the number of base ticks since scheduler_init().
+*/
+unsigned long scheduler_get_ticks(void)
+{
+	unsigned long ticks;
+	int flags;
+	
+	RAISE_IPL(flags, Scheduler_Data.ipl);
+	ticks = Scheduler_Data.ticks;
+	IRQ_ENABLE(flags);
+	
+	return ticks;
+}
+
+/*@}*/
@@ -0,0 +1,88 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_SCHEDULER_H
+#define _MOLOLE_SCHEDULER_H
+
+#include "../types/types.h"
+
+/** \addtogroup scheduler */
+/*@{*/
+
+/** \file
+	\brief A rate-monotonic periodic task scheduler.
+*/
+
+// Defines
+
+/** Errors scheduler can throw */
+enum scheduler_errors
+{
+	SCHEDULER_ERROR_BASE = 0x1500,
+	SCHEDULER_ERROR_TOO_MANY_TASKS,			/**< More than \ref SCHEDULER_MAX_TASKS tasks were passed to scheduler_init() */
+	SCHEDULER_ERROR_INVALID_DIVIDER,		/**< A task has a rate divider of 0 */
+	SCHEDULER_ERROR_ALREADY_INITIALIZED,	/**< scheduler_init() was called twice */
+};
+
+/** Maximum number of tasks */
+#define SCHEDULER_MAX_TASKS 16
+
+/** Phase value asking the scheduler to choose the phase of a task */
+#define SCHEDULER_PHASE_AUTO 0xFFFF
+
+/** Periodic task callback */
+typedef void (*scheduler_task_callback)(void* user_data);
+
+// Structures definitions
+
+/** Data associated with a periodic task; the storage is provided by the caller and must outlive the scheduler. */
+typedef struct
+{
+	scheduler_task_callback callback;	/**< function to call at each period */
+	void* user_data;					/**< pointer passed to the callback */
+	unsigned int divider;				/**< the task runs every divider base ticks, must be > 0 */
+	unsigned int phase;					/**< base tick of the first run, from 0 to divider - 1, or \ref SCHEDULER_PHASE_AUTO */
+	
+	unsigned int ipl;					/**< IPL at which the task runs, derived from its rate, set by scheduler_init() */
+	unsigned int overruns;				/**< number of times the task was due while its previous run was not completed */
+	unsigned int runs;					/**< number of completed runs */
+	unsigned long max_duration;			/**< worst-case duration of a run in timer counts, including preemption by faster tasks */
+	
+	unsigned int countdown;				/**< base ticks before the next run, internal use only */
+	bool pending;						/**< true if the task is due but not started, internal use only */
+	bool running;						/**< true if the task is running, internal use only */
+} Scheduler_Task;
+
+// Functions, doc in the .c
+
+void scheduler_init(int timer_id, unsigned long base_period, int unit, Scheduler_Task* tasks, unsigned int count, int priority);
+
+void scheduler_reset_statistics(void);
+
+unsigned long scheduler_get_ticks(void);
+
+/*@}*/
+
+#endif
@@ -0,0 +1,90 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup serial-io */
+/*@{*/
+
+/** \file
+	Default buffers of the serial input/output library.
+	
+	serial_io_init() is in its own file so that its buffers are only linked in when it is used,
+	and not by the users of serial_io_init_buffers().
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include "serial-io.h"
+#include "../error/error.h"
+
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Reception buffers used by serial_io_init(), for UART_1 and UART_2 */
+static char Serial_IO_Reception_Buffers[2][SERIAL_IO_BUFFERS_SIZE];
+
+/** Transmission buffers used by serial_io_init(), for UART_1 and UART_2 */
+static char Serial_IO_Transmission_Buffers[2][SERIAL_IO_BUFFERS_SIZE];
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize a serial input/output stream.
+	
+	This functions initializes the stream itself and open the serial port at 8 bits, 1 stop bit, no parity.
+	The buffers are the \ref SERIAL_IO_BUFFERS_SIZE bytes default buffers of the UART;
+	as the UART callbacks carry one stream, there is at most one stream per UART using them.
+	
+	\param	state
+			serial input/output stream
+	\param	uart_id
+			identifier of the UART to use, may be \ref UART_1 or \ref UART_2
+	\param	baud_rate
+			baud rate in bps
+	\param	hardware_flow_control
+			wether hardware flow control (CTS/RTS) should be used or not
+	\param 	priority
+			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
+*/
+void serial_io_init(Serial_IO_State* state, int uart_id, unsigned long baud_rate, bool hardware_flow_control, int priority)
+{
+	if (uart_id != UART_1 && uart_id != UART_2)
+		ERROR(UART_ERROR_INVALID_ID, &uart_id);
+	
+	serial_io_init_buffers(state, uart_id, baud_rate, hardware_flow_control, priority, Serial_IO_Reception_Buffers[uart_id], SERIAL_IO_BUFFERS_SIZE, Serial_IO_Transmission_Buffers[uart_id], SERIAL_IO_BUFFERS_SIZE);
+}
+
+/*@}*/
@@ -0,0 +1,332 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup serial-io */
+/*@{*/
+
+/** \file
+	Formatted output for the serial input/output library.
+	
+	serial_io_printf() implements the subset of printf needed on a terminal, without the C library:
+	the conversions %c, %s, %d, %u, %x and %X, with the l modifier for long values (%ld, %lu, %lx),
+	a minimal width, and the - (align left) and 0 (fill with zeros) flags; %% outputs a percent sign.
+	
+	\code
+	serial_io_printf(&serial, "speed %5d mm/s, status %04x, %s\r\n", speed, status, name);
+	\endcode
+	
+	Decimal digits are produced most significant first by subtracting powers of ten, without any division,
+	and characters are written directly into the transmission buffer, without an intermediate buffer.
+	Like the other send functions, serial_io_printf() waits while the transmission buffer is full.
+	
+	tests/serial-io-bench.c compares its cost with serial_io_send_unsigned(), serial_io_send_int()
+	and serial_io_send_hex() for the same output (make -C tests bench).
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include <p33fxxxx.h>
+
+#include "../clock/clock.h" // Idle() macro
+#include "serial-io.h"
+
+/** Powers of ten used to produce decimal digits, down to 10 */
+static const unsigned long serial_io_powers_of_ten[] =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL, 1000UL, 100UL, 10UL
+};
+
+/** Number of entries in serial_io_powers_of_ten */
+#define SERIAL_IO_POWERS_COUNT (sizeof(serial_io_powers_of_ten) / sizeof(serial_io_powers_of_ten[0]))
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Options of a conversion */
+typedef struct
+{
+	unsigned width;		/**< minimal number of characters */
+	bool left;			/**< pad with spaces at the right instead of the left */
+	bool zeros;			/**< pad numbers with zeros instead of spaces */
+} Serial_IO_Format;
+
+
+//-------------------
+// Internal functions
+//-------------------
+
+/** Make the characters written up to write_pos available to the transmission interrupt */
+static void publish(Serial_IO_State* state, unsigned write_pos)
+{
+	int flags = uart_disable_tx_interrupt(state->uart_id);
+	
+	// if the transmission buffer was empty, the interrupt will not be called, so give the first characters to the UART
+	if (state->transmission_buffer_transmit_pos == state->transmission_buffer_write_pos)
+	{
+		while (state->transmission_buffer_transmit_pos != write_pos && uart_transmit_byte(state->uart_id, state->transmission_buffer[state->transmission_buffer_transmit_pos]))
+			state->transmission_buffer_transmit_pos = (state->transmission_buffer_transmit_pos + 1) & state->transmission_buffer_mask;
+	}
+	
+	state->transmission_buffer_write_pos = write_pos;
+	uart_enable_tx_interrupt(state->uart_id, flags);
+}
+
+/** Write a character at write_pos in the transmission buffer, waiting for room if full */
+static void put_char(Serial_IO_State* state, unsigned* write_pos, char c)
+{
+	unsigned next = (*write_pos + 1) & state->transmission_buffer_mask;
+	
+	if (next == state->transmission_buffer_transmit_pos)
+	{
+		// let the interrupt send what is already written, and wait for room
+		publish(state, *write_pos);
+		while (next == state->transmission_buffer_transmit_pos)
+			Idle();
+	}
+	
+	state->transmission_buffer[*write_pos] = c;
+	*write_pos = next;
+}
+
+/** Write count times a character */
+static void put_repeated(Serial_IO_State* state, unsigned* write_pos, char c, unsigned count)
+{
+	while (count--)
+		put_char(state, write_pos, c);
+}
+
+/** Write a string padded to the width of the format */
+static void put_string(Serial_IO_State* state, unsigned* write_pos, const char* string, const Serial_IO_Format* format)
+{
+	const char* end = string;
+	unsigned length;
+	
+	while (*end)
+		end++;
+	length = end - string;
+	
+	if (!format->left && format->width > length)
+		put_repeated(state, write_pos, ' ', format->width - length);
+	while (string != end)
+		put_char(state, write_pos, *string++);
+	if (format->left && format->width > length)
+		put_repeated(state, write_pos, ' ', format->width - length);
+}
+
+/** Write the sign and the padding before a number of length characters, sign included */
+static void put_number_start(Serial_IO_State* state, unsigned* write_pos, bool negative, unsigned length, const Serial_IO_Format* format)
+{
+	if (!format->left && !format->zeros && format->width > length)
+		put_repeated(state, write_pos, ' ', format->width - length);
+	if (negative)
+		put_char(state, write_pos, '-');
+	if (!format->left && format->zeros && format->width > length)
+		put_repeated(state, write_pos, '0', format->width - length);
+}
+
+/** Write the padding after a number of length characters */
+static void put_number_end(Serial_IO_State* state, unsigned* write_pos, unsigned length, const Serial_IO_Format* format)
+{
+	if (format->left && format->width > length)
+		put_repeated(state, write_pos, ' ', format->width - length);
+}
+
+/** Write a number in decimal */
+static void put_decimal(Serial_IO_State* state, unsigned* write_pos, unsigned long value, bool negative, const Serial_IO_Format* format)
+{
+	unsigned first = 0;
+	unsigned length;
+	unsigned i;
+	char digit;
+	
+	// skip the powers of ten greater than value, the remaining ones give the number of digits
+	while (first < SERIAL_IO_POWERS_COUNT && value < serial_io_powers_of_ten[first])
+		first++;
+	length = SERIAL_IO_POWERS_COUNT - first + 1 + (negative ? 1 : 0);
+	
+	put_number_start(state, write_pos, negative, length, format);
+	for (i = first; i < SERIAL_IO_POWERS_COUNT; i++)
+	{
+		digit = '0';
+		while (value >= serial_io_powers_of_ten[i])
+		{
+			value -= serial_io_powers_of_ten[i];
+			digit++;
+		}
+		put_char(state, write_pos, digit);
+	}
+	put_char(state, write_pos, '0' + (char)value);
+	put_number_end(state, write_pos, length, format);
+}
+
+/** Write a number in hexadecimal */
+static void put_hex(Serial_IO_State* state, unsigned* write_pos, unsigned long value, bool upper_case, const Serial_IO_Format* format)
+{
+	const char* digits = upper_case ? "0123456789ABCDEF" : "0123456789abcdef";
+	int shift = 28;
+	unsigned length;
+	
+	while (shift > 0 && !(value >> shift))
+		shift -= 4;
+	length = shift / 4 + 1;
+	
+	put_number_start(state, write_pos, false, length, format);
+	for (; shift >= 0; shift -= 4)
+		put_char(state, write_pos, digits[(value >> shift) & 0xF]);
+	put_number_end(state, write_pos, length, format);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Queue formatted text to the transmission buffer, see serial_io_printf().
+	
+	\param	state
+			serial input/output stream
+	\param	format
+			format string
+	\param	arguments
+			values to format
+*/
+void serial_io_vprintf(Serial_IO_State* state, const char* format, va_list arguments)
+{
+	unsigned write_pos = state->transmission_buffer_write_pos;
+	Serial_IO_Format options;
+	bool is_long;
+	long value;
+	unsigned long unsigned_value;
+	char c;
+	
+	while ((c = *format++) != 0)
+	{
+		if (c != '%')
+		{
+			put_char(state, &write_pos, c);
+			continue;
+		}
+		
+		// flags, width and modifier
+		options.left = false;
+		options.zeros = false;
+		options.width = 0;
+		for (;; format++)
+		{
+			if (*format == '-')
+				options.left = true;
+			else if (*format == '0')
+				options.zeros = true;
+			else
+				break;
+		}
+		while (*format >= '0' && *format <= '9')
+			options.width = options.width * 10 + (*format++ - '0');
+		is_long = (*format == 'l');
+		if (is_long)
+			format++;
+		
+		// conversion
+		switch (c = *format++)
+		{
+			case 'c':
+				put_char(state, &write_pos, (char)va_arg(arguments, int));
+				break;
+			
+			case 's':
+				put_string(state, &write_pos, va_arg(arguments, const char*), &options);
+				break;
+			
+			case 'd':
+			case 'i':
+				value = is_long ? va_arg(arguments, long) : va_arg(arguments, int);
+				if (value < 0)
+					put_decimal(state, &write_pos, -(unsigned long)value, true, &options);
+				else
+					put_decimal(state, &write_pos, value, false, &options);
+				break;
+			
+			case 'u':
+				unsigned_value = is_long ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned);
+				put_decimal(state, &write_pos, unsigned_value, false, &options);
+				break;
+			
+			case 'x':
+			case 'X':
+				unsigned_value = is_long ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned);
+				put_hex(state, &write_pos, unsigned_value, c == 'X', &options);
+				break;
+			
+			case '%':
+				put_char(state, &write_pos, '%');
+				break;
+			
+			case 0:
+				// truncated conversion at the end of the format
+				format--;
+				break;
+			
+			default:
+				// unknown conversion, output it as is
+				put_char(state, &write_pos, '%');
+				put_char(state, &write_pos, c);
+				break;
+		}
+	}
+	
+	publish(state, write_pos);
+}
+
+/**
+	Queue formatted text to the transmission buffer.
+	
+	If the buffer is full, waits until there is room for the text.
+	See the description of the file for the supported conversions.
+	
+	\param	state
+			serial input/output stream
+	\param	format
+			format string
+*/
+void serial_io_printf(Serial_IO_State* state, const char* format, ...)
+{
+	va_list arguments;
+	
+	va_start(arguments, format);
+	serial_io_vprintf(state, format, arguments);
+	va_end(arguments);
+}
+
+/*@}*/
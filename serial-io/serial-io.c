@@ -32,6 +32,14 @@
 	An input/output library using UART.
 	It provides buffered operations, basic types parsing, and terminal support.
 	It is internally state-less, all state is contained in \ref Serial_IO_State.
+	
+	The blocking functions wait in Idle() until data are available or room is free in the buffers.
+	serial_io_try_get() and serial_io_try_send() never wait and return the number of bytes
+	actually read or queued, so that a main loop cannot be stalled by a slow terminal.
+	With serial_io_init(), the buffers are the \ref SERIAL_IO_BUFFERS_SIZE bytes default buffers of the UART,
+	defined in default-buffers.c, which is only linked in if serial_io_init() is used.
+	With serial_io_init_buffers(), they are provided by the caller, of any power-of-two size;
+	either way, \ref Serial_IO_State only points to them.
 */
 /*@{*/
 
@@ -45,7 +53,9 @@
 //------------
 
 #include <p33fxxxx.h>
-
+
+#include <string.h> // memcpy
+
 #include "../clock/clock.h" // Idle() macro
 #include "serial-io.h"
 #include "../error/error.h"
@@ -62,10 +72,10 @@ bool serial_io_byte_received(int uart_id, unsigned char data, void* user_data)
 	
 	state->reception_buffer[state->reception_buffer_reception_pos] = (char)data;
 	
-	state->reception_buffer_reception_pos = (state->reception_buffer_reception_pos + 1) % SERIAL_IO_BUFFERS_SIZE;
+	state->reception_buffer_reception_pos = (state->reception_buffer_reception_pos + 1) & state->reception_buffer_mask;
 	
 	// block if full
-	if ((state->reception_buffer_reception_pos + 1) % SERIAL_IO_BUFFERS_SIZE == state->reception_buffer_read_pos)
+	if (((state->reception_buffer_reception_pos + 1) & state->reception_buffer_mask) == state->reception_buffer_read_pos)
 		return false;
 	else
 		return true;
@@ -82,7 +92,7 @@ bool serial_io_byte_transmitted(int uart_id, unsigned char* data, void* user_dat
 	
 	*data = state->transmission_buffer[state->transmission_buffer_transmit_pos];
 	
-	state->transmission_buffer_transmit_pos = (state->transmission_buffer_transmit_pos + 1) % SERIAL_IO_BUFFERS_SIZE;
+	state->transmission_buffer_transmit_pos = (state->transmission_buffer_transmit_pos + 1) & state->transmission_buffer_mask;
 	
 	return true;
 }
@@ -101,7 +111,7 @@ bool is_digit(char c)
 //-------------------
 
 /**
-	Initialize a serial input/output stream.
+	Initialize a serial input/output stream with buffers provided by the caller.
 	
 	This functions initializes the stream itself and open the serial port at 8 bits, 1 stop bit, no parity.
 	
@@ -115,13 +125,30 @@ bool is_digit(char c)
 			wether hardware flow control (CTS/RTS) should be used or not
 	\param 	priority
 			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
+	\param	reception_buffer
+			reception buffer, must remain valid while the stream is used
+	\param	reception_buffer_size
+			size of reception_buffer, a power of two; one byte is kept free to distinguish a full buffer from an empty one
+	\param	transmission_buffer
+			transmission buffer, must remain valid while the stream is used
+	\param	transmission_buffer_size
+			size of transmission_buffer, a power of two; one byte is kept free to distinguish a full buffer from an empty one
 */
-void serial_io_init(Serial_IO_State* state, int uart_id, unsigned long baud_rate, bool hardware_flow_control, int priority)
+void serial_io_init_buffers(Serial_IO_State* state, int uart_id, unsigned long baud_rate, bool hardware_flow_control, int priority, char* reception_buffer, unsigned reception_buffer_size, char* transmission_buffer, unsigned transmission_buffer_size)
 {
+	if (reception_buffer_size < 2 || (reception_buffer_size & (reception_buffer_size - 1)))
+		ERROR(SERIAL_IO_ERROR_INVALID_BUFFER_SIZE, &reception_buffer_size);
+	if (transmission_buffer_size < 2 || (transmission_buffer_size & (transmission_buffer_size - 1)))
+		ERROR(SERIAL_IO_ERROR_INVALID_BUFFER_SIZE, &transmission_buffer_size);
+	
 	// init descriptor struct
 	state->uart_id = uart_id;
+	state->reception_buffer = reception_buffer;
+	state->reception_buffer_mask = reception_buffer_size - 1;
 	state->reception_buffer_reception_pos = 0;
 	state->reception_buffer_read_pos = 0;
+	state->transmission_buffer = transmission_buffer;
+	state->transmission_buffer_mask = transmission_buffer_size - 1;
 	state->transmission_buffer_transmit_pos = 0;
 	state->transmission_buffer_write_pos = 0;
 	
@@ -173,7 +200,7 @@ char serial_io_get_char(Serial_IO_State* state)
 {
 	char c = serial_io_peek_char(state);
 	
-	state->reception_buffer_read_pos = (state->reception_buffer_read_pos + 1) % SERIAL_IO_BUFFERS_SIZE;
+	state->reception_buffer_read_pos = (state->reception_buffer_read_pos + 1) & state->reception_buffer_mask;
 	
 	// unblock if previously blocked
 	uart_read_pending_data(state->uart_id);
@@ -281,9 +308,53 @@ int serial_io_get_int(Serial_IO_State* state)
 */
 void serial_io_get_buffer(Serial_IO_State* state, char* buffer, unsigned length)
 {
-	unsigned pos = 0;
-	while (pos < length)
-		buffer[pos++] = serial_io_get_char(state);
+	unsigned read;
+	
+	while (length)
+	{
+		read = serial_io_try_get(state, buffer, length);
+		if (read == 0)
+			Idle();
+		buffer += read;
+		length -= read;
+	}
+}
+
+/**
+	Read up to a specific amount of byte from the reception buffer, without waiting.
+	
+	\param	state
+			serial input/output stream
+	\param	buffer
+			pointer to location to store data to
+	\param	length
+			maximum number of bytes to read
+	\return	the number of bytes read, 0 if the reception buffer is empty
+*/
+unsigned serial_io_try_get(Serial_IO_State* state, char* buffer, unsigned length)
+{
+	unsigned read_pos = state->reception_buffer_read_pos;
+	unsigned available = (state->reception_buffer_reception_pos - read_pos) & state->reception_buffer_mask;
+	unsigned run;
+	
+	if (length > available)
+		length = available;
+	if (length == 0)
+		return 0;
+	
+	// copy the data in at most two contiguous runs, the second one after wrapping around
+	run = state->reception_buffer_mask + 1 - read_pos;
+	if (run > length)
+		run = length;
+	memcpy(buffer, state->reception_buffer + read_pos, run);
+	memcpy(buffer + run, state->reception_buffer, length - run);
+	
+	state->reception_buffer_read_pos = (read_pos + length) & state->reception_buffer_mask;
+	
+	// unblock if previously blocked
+	uart_read_pending_data(state->uart_id);
+	
+	return length;
 }
 
 /**
@@ -305,7 +376,7 @@ void serial_io_send_char(Serial_IO_State* state, char c)
 		return;
 	
 	// wait while software buffer is full
-	while ((state->transmission_buffer_write_pos + 1) % SERIAL_IO_BUFFERS_SIZE == state->transmission_buffer_transmit_pos)
+	while (((state->transmission_buffer_write_pos + 1) & state->transmission_buffer_mask) == state->transmission_buffer_transmit_pos)
 		Idle();
 	
 	// write data to software buffer
@@ -316,7 +387,7 @@ void serial_io_send_char(Serial_IO_State* state, char c)
 	
 	flags = uart_disable_tx_interrupt(state->uart_id);
 	state->transmission_buffer[state->transmission_buffer_write_pos] = c;
-	state->transmission_buffer_write_pos = (state->transmission_buffer_write_pos + 1) % SERIAL_IO_BUFFERS_SIZE;
+	state->transmission_buffer_write_pos = (state->transmission_buffer_write_pos + 1) & state->transmission_buffer_mask;
 	uart_enable_tx_interrupt(state->uart_id, flags);
 }
 
@@ -333,8 +404,7 @@ void serial_io_send_char(Serial_IO_State* state, char c)
 */
 void serial_io_send_string(Serial_IO_State* state, const char* string)
 {
-	while (*string)
-		serial_io_send_char(state, *string++);
+	serial_io_send_buffer(state, string, strlen(string));
 }
 
 /**
@@ -352,9 +422,74 @@ void serial_io_send_string(Serial_IO_State* state, const char* string)
 */
 void serial_io_send_buffer(Serial_IO_State* state, const char* buffer, unsigned length)
 {
-	unsigned pos = 0;
-	while (pos < length)
-		serial_io_send_char(state, buffer[pos++]);
+	unsigned sent;
+	
+	while (length)
+	{
+		sent = serial_io_try_send(state, buffer, length);
+		if (sent == 0)
+			Idle();
+		buffer += sent;
+		length -= sent;
+	}
+}
+
+/**
+	Queue up to a specific amount of byte to the transmission buffer, without waiting.
+	
+	\param	state
+			serial input/output stream
+	\param	buffer
+			pointer to location to read data from
+	\param	length
+			maximum number of bytes to send
+	\return	the number of bytes queued, 0 if the transmission buffer is full
+*/
+unsigned serial_io_try_send(Serial_IO_State* state, const char* buffer, unsigned length)
+{
+	unsigned write_pos = state->transmission_buffer_write_pos;
+	unsigned sent = 0;
+	unsigned room;
+	unsigned run;
+	int flags;
+	
+	// if there was nothing in the transmission buffer, send directly as long as the hardware accepts
+	if (write_pos == state->transmission_buffer_transmit_pos)
+		while (sent < length && uart_transmit_byte(state->uart_id, buffer[sent]))
+			sent++;
+	
+	room = (state->transmission_buffer_transmit_pos - write_pos - 1) & state->transmission_buffer_mask;
+	length -= sent;
+	if (length > room)
+		length = room;
+	if (length == 0)
+		return sent;
+	
+	// copy the data in at most two contiguous runs, the second one after wrapping around
+	run = state->transmission_buffer_mask + 1 - write_pos;
+	if (run > length)
+		run = length;
+	memcpy(state->transmission_buffer + write_pos, buffer + sent, run);
+	memcpy(state->transmission_buffer, buffer + sent + run, length - run);
+	
+	// publish the data, see serial_io_send_char() for the race condition this prevents
+	flags = uart_disable_tx_interrupt(state->uart_id);
+	state->transmission_buffer_write_pos = (write_pos + length) & state->transmission_buffer_mask;
+	uart_enable_tx_interrupt(state->uart_id, flags);
+	
+	return sent + length;
+}
+
+/**
+	Return the room in the transmission buffer.
+	
+	\param	state
+			serial input/output stream
+	\return	the number of bytes that can be queued without waiting
+*/
+unsigned serial_io_get_free_space(Serial_IO_State* state)
+{
+	return (state->transmission_buffer_transmit_pos - state->transmission_buffer_write_pos - 1) & state->transmission_buffer_mask;
 }
 
 /**
@@ -25,6 +25,8 @@
 #ifndef _MOLOLE_SERIAL_IO_H
 #define _MOLOLE_SERIAL_IO_H
 
+#include <stdarg.h>
+
 #include "../types/types.h"
 #include "../uart/uart.h"
 
@@ -37,9 +39,16 @@
 
 // Defines
 
-/** Sizes of read and write buffers */
+/** Sizes of the read and write buffers used by serial_io_init(), one pair per UART */
 #define SERIAL_IO_BUFFERS_SIZE 64
 
+/** Errors serial-io can throw */
+enum serial_io_errors
+{
+	SERIAL_IO_ERROR_BASE = 0x1700,
+	SERIAL_IO_ERROR_INVALID_BUFFER_SIZE,			/**< A buffer size is not a power of two of at least 2. */
+};
+
 /** Possible alignment when sending numbers */
 enum serial_io_print_alignment
 {
@@ -58,17 +67,21 @@ typedef struct
 	
 	unsigned reception_buffer_read_pos;					/**< position of reading (from the user code) in the reception buffer */
 	unsigned reception_buffer_reception_pos;			/**< position of reception (from the interrupt code) in the reception buffer */
-	char reception_buffer[SERIAL_IO_BUFFERS_SIZE];		/**< reception buffer */
+	unsigned reception_buffer_mask;						/**< size of the reception buffer minus one */
+	char* reception_buffer;								/**< reception buffer */
 	
 	unsigned transmission_buffer_write_pos;				/**< position of writing (from the user code) in the transmission buffer */
 	unsigned transmission_buffer_transmit_pos;			/**< position of transmission (from the interrupt code) in the transmission buffer */
-	char transmission_buffer[SERIAL_IO_BUFFERS_SIZE];	/**< transmission buffer */
+	unsigned transmission_buffer_mask;					/**< size of the transmission buffer minus one */
+	char* transmission_buffer;							/**< transmission buffer */
 } Serial_IO_State;
 
 // Functions, doc in the .c
 
 void serial_io_init(Serial_IO_State* state, int uart_id, unsigned long baud_rate, bool hardware_flow_control, int priority);
 
+void serial_io_init_buffers(Serial_IO_State* state, int uart_id, unsigned long baud_rate, bool hardware_flow_control, int priority, char* reception_buffer, unsigned reception_buffer_size, char* transmission_buffer, unsigned transmission_buffer_size);
+
 
 bool serial_io_is_data(Serial_IO_State* state);
 
@@ -80,6 +93,8 @@ int serial_io_get_int(Serial_IO_State* state);
 
 void serial_io_get_buffer(Serial_IO_State* state, char* buffer, unsigned length);
 
+unsigned serial_io_try_get(Serial_IO_State* state, char* buffer, unsigned length);
+
 unsigned serial_io_get_hex(Serial_IO_State* state);
 
 
@@ -89,12 +104,20 @@ void serial_io_send_string(Serial_IO_State* state, const char* string);
 
 void serial_io_send_buffer(Serial_IO_State* state, const char* buffer, unsigned length);
 
+unsigned serial_io_try_send(Serial_IO_State* state, const char* buffer, unsigned length);
+
+unsigned serial_io_get_free_space(Serial_IO_State* state);
+
 void serial_io_send_unsigned(Serial_IO_State* state, unsigned value, int alignment);
 
 void serial_io_send_int(Serial_IO_State* state, int value, int alignment);
 
 void serial_io_send_hex(Serial_IO_State* state, unsigned int value, int alignment);
 
+void serial_io_printf(Serial_IO_State* state, const char* format, ...);
+
+void serial_io_vprintf(Serial_IO_State* state, const char* format, va_list arguments);
+
 
 void serial_io_clear_screen(Serial_IO_State* state);
 
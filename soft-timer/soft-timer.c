@@ -0,0 +1,343 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+
+\defgroup soft-timer Software timers
+
+Many software timers multiplexed on one hardware timer.
+
+\section Introduction
+
+This module drives any number of one-shot or periodic software timers from a single
+hardware timer (see \ref timer), which is useful for timeouts, LED blinkers,
+sensor polls or protocol retransmits that do not deserve a hardware timer each.
+
+The timers are stored in a hierarchical timer wheel of \ref SOFT_TIMER_LEVELS levels
+of \ref SOFT_TIMER_SLOTS slots each.
+Adding and cancelling a timer are O(1) operations.
+At each tick, only the timers of the current slot are run; every \ref SOFT_TIMER_SLOTS ticks
+the timers of one slot of the upper level are redistributed into the lower level.
+The per-tick cost is thus bounded by the number of timers sharing a slot, not by the total number of timers.
+
+The timer storage is provided by the caller, see \ref Soft_Timer.
+
+\section Usage
+
+\code
+Soft_Timer blinker;
+
+soft_timer_init(TIMER_1, 1, 3, 1);							// 1 ms tick, callbacks at IPL 1
+
+soft_timer_add(&blinker, 500, 500, blink_led, NULL);		// every 500 ms, blink_led is of type soft_timer_callback
+\endcode
+
+Callbacks are called from the interrupt of the hardware timer, at the priority given to soft_timer_init().
+They may add or cancel any timer, including the one being run.
+
+soft_timer_tick() does not access any hardware register, so the wheel can also be driven
+by a simulated tick; tests/soft-timer-test.c does so on the host (make -C tests check).
+
+*/
+/*@{*/
+
+/** \file
+	Implementation of the software timers.
+*/
+
+//---------
+// Includes
+//---------
+
+#include "soft-timer.h"
+#include "../timer/timer.h"
+#include "../error/error.h"
+
+//------------
+// Definitions
+//------------
+
+/** Number of bits of the slot index of one wheel level */
+#define SOFT_TIMER_BITS						5
+/** Number of slots in one wheel level */
+#define SOFT_TIMER_SLOTS					(1 << SOFT_TIMER_BITS)
+/** Mask of the slot index of one wheel level */
+#define SOFT_TIMER_MASK						(SOFT_TIMER_SLOTS - 1)
+/** Number of wheel levels */
+#define SOFT_TIMER_LEVELS					3
+/** Largest delay in ticks that can be stored directly in the wheel; longer timers are cascaded again */
+#define SOFT_TIMER_MAX_DELAY				((1UL << (SOFT_TIMER_BITS * SOFT_TIMER_LEVELS)) - 1)
+
+/** Return the slot index of tick t at wheel level l */
+#define SOFT_TIMER_INDEX(t, l)				(((t) >> ((l) * SOFT_TIMER_BITS)) & SOFT_TIMER_MASK)
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Software timers data */
+static struct
+{
+	unsigned long ticks;									/**< next tick to process */
+	unsigned int ipl;										/**< IPL of the hardware timer interrupt */
+	bool is_initialized;									/**< true if soft_timer_init() was called */
+	Soft_Timer* wheel[SOFT_TIMER_LEVELS][SOFT_TIMER_SLOTS];	/**< lists of pending timers */
+} Soft_Timer_Data;
+
+
+//-------------------
+// Internal functions
+//-------------------
+
+/** Insert a timer in the wheel, must be called at Soft_Timer_Data.ipl */
+static void soft_timer_insert(Soft_Timer* timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long delay = expires - Soft_Timer_Data.ticks;
+	Soft_Timer** slot;
+	
+	if ((long)delay < 0)
+	{
+		// Already expired, run at next tick
+		slot = &Soft_Timer_Data.wheel[0][SOFT_TIMER_INDEX(Soft_Timer_Data.ticks, 0)];
+	}
+	else
+	{
+		if (delay > SOFT_TIMER_MAX_DELAY)
+		{
+			// Too far in the future, park it on the last level; it will be cascaded again
+			expires = Soft_Timer_Data.ticks + SOFT_TIMER_MAX_DELAY;
+			delay = SOFT_TIMER_MAX_DELAY;
+		}
+		
+		if (delay < (1UL << SOFT_TIMER_BITS))
+			slot = &Soft_Timer_Data.wheel[0][SOFT_TIMER_INDEX(expires, 0)];
+		else if (delay < (1UL << (2 * SOFT_TIMER_BITS)))
+			slot = &Soft_Timer_Data.wheel[1][SOFT_TIMER_INDEX(expires, 1)];
+		else
+			slot = &Soft_Timer_Data.wheel[2][SOFT_TIMER_INDEX(expires, 2)];
+	}
+	
+	timer->next = *slot;
+	if (timer->next)
+		timer->next->pprev = &timer->next;
+	timer->pprev = slot;
+	*slot = timer;
+}
+
+/** Remove a pending timer from the wheel, must be called at Soft_Timer_Data.ipl */
+static void soft_timer_unlink(Soft_Timer* timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->pprev = 0;
+}
+
+/** Move all timers of a slot of an upper level to the lower levels; return the slot index */
+static unsigned int soft_timer_cascade(unsigned int level)
+{
+	unsigned int index = SOFT_TIMER_INDEX(Soft_Timer_Data.ticks, level);
+	Soft_Timer* timer = Soft_Timer_Data.wheel[level][index];
+	Soft_Timer* next;
+	
+	Soft_Timer_Data.wheel[level][index] = 0;
+	while (timer)
+	{
+		next = timer->next;
+		soft_timer_insert(timer);
+		timer = next;
+	}
+	
+	return index;
+}
+
+/** Hardware timer callback */
+static void soft_timer_timer_cb(int __attribute__((unused)) timer_id)
+{
+	soft_timer_tick();
+}
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize the software timers and start the hardware timer driving them.
+	
+	\param	timer_id
+			The hardware timer, one of \ref timer_identifiers; it is reserved by this module.
+	\param	tick_time
+			The period of one tick, expressed in the unit defined by the \e unit parameter
+	\param	unit
+			Time base of the \e tick_time parameter, see timer_init()
+	\param 	priority
+			Interrupt priority at which the callbacks run, from 1 (lowest priority) to 6 (highest normal priority)
+*/
+void soft_timer_init(int timer_id, unsigned long tick_time, int unit, int priority)
+{
+	if (Soft_Timer_Data.is_initialized)
+		ERROR(SOFT_TIMER_ERROR_ALREADY_INITIALIZED, &timer_id);
+	
+	Soft_Timer_Data.ipl = priority;
+	Soft_Timer_Data.is_initialized = true;
+	
+	timer_init(timer_id, tick_time, unit);
+	timer_enable_interrupt(timer_id, soft_timer_timer_cb, priority);
+	timer_enable(timer_id);
+}
+
+/**
+	Start a software timer.
+	
+	If the timer is already pending, it is restarted with the new parameters.
+	
+	\param	timer
+			Software timer storage, owned by the caller.
+	\param	delay
+			Number of ticks before the first call of the callback; 0 and 1 both mean at next tick.
+	\param	period
+			Number of ticks between subsequent calls of the callback; 0 for a one-shot timer.
+	\param	callback
+			Function to call when the timer fires.
+	\param	user_data
+			Pointer passed to the callback.
+*/
+void soft_timer_add(Soft_Timer* timer, unsigned long delay, unsigned long period, soft_timer_callback callback, void* user_data)
+{
+	int flags;
+	
+	if (!timer)
+		ERROR(SOFT_TIMER_ERROR_INVALID_TIMER, &timer);
+	
+	RAISE_IPL(flags, Soft_Timer_Data.ipl);
+	
+	if (timer->pprev)
+		soft_timer_unlink(timer);
+	
+	timer->callback = callback;
+	timer->user_data = user_data;
+	timer->period = period;
+	// ticks is the next tick to process, so a delay of 1 expires at ticks
+	timer->expires = Soft_Timer_Data.ticks + (delay ? delay - 1 : 0);
+	soft_timer_insert(timer);
+	
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Stop a software timer.
+	
+	Does nothing if the timer is not pending.
+	
+	\param	timer
+			Software timer storage, owned by the caller.
+*/
+void soft_timer_cancel(Soft_Timer* timer)
+{
+	int flags;
+	
+	RAISE_IPL(flags, Soft_Timer_Data.ipl);
+	
+	if (timer->pprev)
+		soft_timer_unlink(timer);
+	
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Return wether a software timer is pending.
+	
+	\param	timer
+			Software timer storage, owned by the caller.
+	\return	true if the timer will fire, false otherwise
+*/
+bool soft_timer_is_pending(Soft_Timer* timer)
+{
+	return timer->pprev != 0;
+}
+
+/**
+	Return the number of ticks processed since soft_timer_init().
+	
+	The counter wraps around after 2^32 ticks.
+*/
+unsigned long soft_timer_get_ticks(void)
+{
+	unsigned long ticks;
+	int flags;
+	
+	RAISE_IPL(flags, Soft_Timer_Data.ipl);
+	ticks = Soft_Timer_Data.ticks;
+	IRQ_ENABLE(flags);
+	
+	return ticks;
+}
+
+/**
+	Advance the wheel by one tick and run the expired timers.
+	
+	This function is called from the hardware timer interrupt.
+	It does not access any hardware register, so it can also be called
+	by hand to drive the wheel with a simulated tick.
+*/
+void soft_timer_tick(void)
+{
+	unsigned int index = SOFT_TIMER_INDEX(Soft_Timer_Data.ticks, 0);
+	Soft_Timer* expired;
+	Soft_Timer* timer;
+	
+	// At the beginning of a turn of the lowest level, refill it from the upper levels
+	if (!index && !soft_timer_cascade(1))
+		soft_timer_cascade(2);
+	
+	Soft_Timer_Data.ticks++;
+	
+	// Detach the current slot, so that periodic timers re-inserted in it do not run twice
+	expired = Soft_Timer_Data.wheel[0][index];
+	Soft_Timer_Data.wheel[0][index] = 0;
+	if (expired)
+		expired->pprev = &expired;
+	
+	// The head is re-read at each step because callbacks may cancel timers
+	while ((timer = expired) != 0)
+	{
+		soft_timer_unlink(timer);
+		
+		if (timer->period)
+		{
+			timer->expires += timer->period;
+			soft_timer_insert(timer);
+		}
+		
+		timer->callback(timer, timer->user_data);
+	}
+}
+
+/*@}*/
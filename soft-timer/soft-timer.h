@@ -0,0 +1,82 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_SOFT_TIMER_H
+#define _MOLOLE_SOFT_TIMER_H
+
+#include "../types/types.h"
+
+/** \addtogroup soft-timer */
+/*@{*/
+
+/** \file
+	\brief Software timers multiplexed on one hardware timer.
+*/
+
+// Defines
+
+/** Errors soft-timer can throw */
+enum soft_timer_errors
+{
+	SOFT_TIMER_ERROR_BASE = 0x1300,
+	SOFT_TIMER_ERROR_ALREADY_INITIALIZED,	/**< soft_timer_init() was called twice */
+	SOFT_TIMER_ERROR_INVALID_TIMER,			/**< The passed software timer is NULL */
+};
+
+typedef struct _Soft_Timer Soft_Timer;
+
+/** Software timer callback, called at the IPL given to soft_timer_init() */
+typedef void (*soft_timer_callback)(Soft_Timer* timer, void* user_data);
+
+// Structures definitions
+
+/** Data associated with a software timer; the storage is provided by the caller and must outlive the timer. */
+struct _Soft_Timer
+{
+	Soft_Timer* next;					/**< next timer in the same wheel slot, internal use only */
+	Soft_Timer** pprev;					/**< pointer to the pointer pointing to this timer, 0 if not pending, internal use only */
+	unsigned long expires;				/**< tick at which the timer fires, internal use only */
+	unsigned long period;				/**< reload period in ticks, 0 for one-shot timers */
+	soft_timer_callback callback;		/**< function to call when the timer fires */
+	void* user_data;					/**< pointer passed to the callback */
+};
+
+// Functions, doc in the .c
+
+void soft_timer_init(int timer_id, unsigned long tick_time, int unit, int priority);
+
+void soft_timer_add(Soft_Timer* timer, unsigned long delay, unsigned long period, soft_timer_callback callback, void* user_data);
+
+void soft_timer_cancel(Soft_Timer* timer);
+
+bool soft_timer_is_pending(Soft_Timer* timer);
+
+unsigned long soft_timer_get_ticks(void);
+
+void soft_timer_tick(void);
+
+/*@}*/
+
+#endif
@@ -0,0 +1,395 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup spi */
+/*@{*/
+
+/** \file
+	Queue of SPI master transactions to several devices.
+	
+	spi_start_transfert() handles one transfert per bus at a time and reconfigures both DMA channels for each one.
+	With the queue, several devices sharing a bus are registered once with their chip select, speed and mode,
+	and any number of transactions can be requested. The transactions of a bus are executed in order:
+	when one completes, the DMA interrupt releases its chip select and immediately starts the next one,
+	so the bus stays busy as long as transactions are queued.
+	
+	\code
+	static SPI_Device imu, adc;
+	static SPI_Transaction read_imu, read_adc;
+	
+	spi_queue_init(SPI_1, DMA_CHANNEL_0, DMA_CHANNEL_1, 5);
+	spi_device_init(&imu, SPI_1, GPIO_MAKE_ID(GPIO_PORTB, 2), 8000, SPI_TRSF_BYTE, SPI_CLOCK_IDLE_HIGH, SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE, SPI_SAMPLE_PHASE_MIDDLE);
+	spi_device_init(&adc, SPI_1, GPIO_MAKE_ID(GPIO_PORTB, 3), 10000, SPI_TRSF_WORD, SPI_CLOCK_IDLE_LOW, SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE, SPI_SAMPLE_PHASE_MIDDLE);
+	
+	spi_queue_transaction(&read_imu, &imu, imu_command, imu_data, 7, imu_read, 0);
+	spi_queue_transaction(&read_adc, &adc, 0, adc_data, 4, adc_read, 0);
+	\endcode
+	
+	The DMA channels are configured once by spi_queue_init(); starting a transaction only writes their
+	address and count, and the data size and null write bits when they change.
+	Likewise, SPIxCON1 is only rewritten when the device changes.
+	
+	A transaction must not be modified while spi_is_transaction_pending() returns true,
+	but can be queued again from its own callback.
+	On a bus used with the queue, do not call spi_start_transfert() or spi_transfert_sync().
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "spi.h"
+#include "spi_priv.h"
+#include "../error/error.h"
+#include "../dma/dma.h"
+#include "../gpio/gpio.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Transaction queue of an SPI master */
+typedef struct
+{
+	int dma_rx;						/**< DMA channel for RX, its interrupt ends the transactions */
+	int dma_tx;						/**< DMA channel for TX */
+	SPI_Transaction* head;			/**< transaction in progress, 0 if the queue is empty */
+	SPI_Transaction* tail;			/**< last transaction of the queue */
+	SPI_Device* device;				/**< device whose configuration is in SPIxCON1, 0 if none */
+	int ipl;						/**< priority of the DMA interrupts */
+} SPI_Queue;
+
+/** data for the transaction queues of SPI 1 and 2 */
+static SPI_Queue SPI_Queues[2];
+
+/** Sink of the received data of transactions without rx buffer, and source for the initial configuration */
+static unsigned int SPI_Queue_Dummy __attribute__((space(dma)));
+
+
+//-------------------
+// Private functions
+//-------------------
+
+/** Start the transaction at the head of the queue */
+static void spi_queue_start(int spi_id)
+{
+	SPI_Queue* queue = &SPI_Queues[spi_id];
+	SPI_Transaction* transaction = queue->head;
+	SPI_Device* device = transaction->device;
+	DMA_Channel_Registers* rx = DMA_CHANNEL_REGISTERS(queue->dma_rx);
+	DMA_Channel_Registers* tx = DMA_CHANNEL_REGISTERS(queue->dma_tx);
+	unsigned int size = (device->con1 & SPI_CON1_MODE16) ? 0 : DMA_CON_SIZE;
+	unsigned int con;
+	
+	// Reconfigure the SPI only when the device changes, SPIxCON1 must not be written while enabled
+	if (device != queue->device)
+	{
+		if (spi_id == SPI_1)
+		{
+			SPI1STATbits.SPIEN = 0;
+			SPI1CON1 = device->con1;
+			SPI1STATbits.SPIEN = 1;
+		}
+		else
+		{
+			SPI2STATbits.SPIEN = 0;
+			SPI2CON1 = device->con1;
+			SPI2STATbits.SPIEN = 1;
+		}
+		queue->device = device;
+	}
+	
+	// RX, null writes to the SPI if there is no data to send, no increment if the data is discarded
+	con = (rx->con & ~(DMA_CON_SIZE | DMA_CON_NULLW | DMA_CON_AMODE)) | size;
+	if (!transaction->tx_buffer)
+		con |= DMA_CON_NULLW;
+	if (transaction->rx_buffer)
+		rx->sta = (unsigned int)transaction->rx_buffer - (unsigned int)&_DMA_BASE;
+	else
+	{
+		con |= DMA_ADDRESSING_REGISTER << 4;
+		rx->sta = (unsigned int)&SPI_Queue_Dummy - (unsigned int)&_DMA_BASE;
+	}
+	rx->con = con;
+	rx->cnt = transaction->count - 1;
+	
+	// Do a dummy read of the register and clean any overflow
+	if (spi_id == SPI_1)
+	{
+		(void) SPI1BUF;
+		SPI1STATbits.SPIROV = 0;
+	}
+	else
+	{
+		(void) SPI2BUF;
+		SPI2STATbits.SPIROV = 0;
+	}
+	
+	gpio_write(device->ss, false);
+	dma_enable_channel(queue->dma_rx);
+	
+	if (transaction->tx_buffer)
+	{
+		tx->con = (tx->con & ~DMA_CON_SIZE) | size;
+		tx->sta = (unsigned int)transaction->tx_buffer - (unsigned int)&_DMA_BASE;
+		tx->cnt = transaction->count - 1;
+		dma_enable_channel(queue->dma_tx);
+		dma_start_transfer(queue->dma_tx);
+	}
+	else
+	{
+		// The first write starts the null writes of the RX channel
+		if (spi_id == SPI_1)
+			SPI1BUF = 0;
+		else
+			SPI2BUF = 0;
+	}
+}
+
+/** The transaction at the head of the queue has completed */
+static void spi_queue_done(int spi_id)
+{
+	SPI_Queue* queue = &SPI_Queues[spi_id];
+	SPI_Transaction* transaction = queue->head;
+	
+	if (!transaction)
+		return;
+	
+	gpio_write(transaction->device->ss, true);
+	
+	// The one-shot channels are already off, this releases the idle mode locks (Errata 38) taken by spi_queue_start()
+	dma_disable_channel(queue->dma_rx);
+	if (transaction->tx_buffer)
+		dma_disable_channel(queue->dma_tx);
+	
+	// Start the next one right away, before calling the user
+	queue->head = transaction->next;
+	if (queue->head)
+		spi_queue_start(spi_id);
+	
+	transaction->pending = false;
+	if (transaction->callback)
+		transaction->callback(transaction, transaction->user_data);
+}
+
+/** Callback of the RX DMA interrupt of the SPI 1 queue */
+static void spi1_queue_dma_cb(int __attribute__((unused)) channel, bool __attribute__((unused)) first_buffer)
+{
+	spi_queue_done(SPI_1);
+}
+
+/** Callback of the RX DMA interrupt of the SPI 2 queue */
+static void spi2_queue_dma_cb(int __attribute__((unused)) channel, bool __attribute__((unused)) first_buffer)
+{
+	spi_queue_done(SPI_2);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialise the transaction queue of an SPI master.
+	
+	The SPI is configured for each transaction by its device, see spi_device_init().
+	
+	\param	spi_id
+			SPI id. One of \ref spi_id.
+	\param	dma_rx
+			The DMA channel used for RX
+	\param	dma_tx
+			The DMA channel used for TX
+	\param 	priority
+			Interrupt priority of the DMA channels, from 1 (lowest priority) to 6 (highest normal priority)
+*/
+void spi_queue_init(int spi_id, int dma_rx, int dma_tx, int priority)
+{
+	SPI_Queue* queue;
+	int source;
+	volatile unsigned int* buf;
+	
+	ERROR_CHECK_RANGE(spi_id, SPI_1, SPI_2, SPI_INVALID_ID);
+	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
+	queue = &SPI_Queues[spi_id];
+	
+	if (spi_id == SPI_1)
+	{
+		SPI1STAT = 0;
+		SPI1CON2 = 0x0;						/* Framing support completly disabled */
+		_SPI1IP = priority;
+		source = DMA_INTERRUPT_SOURCE_SPI_1;
+		buf = &SPI1BUF;
+	}
+	else
+	{
+		SPI2STAT = 0;
+		SPI2CON2 = 0x0;						/* Framing support completly disabled */
+		_SPI2IP = priority;
+		source = DMA_INTERRUPT_SOURCE_SPI_2;
+		buf = &SPI2BUF;
+	}
+	
+	queue->dma_rx = dma_rx;
+	queue->dma_tx = dma_tx;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->device = 0;
+	queue->ipl = priority;
+	
+	// The configuration that does not depend on the transaction is set once here
+	// We MUST use the RX channel for the interrupt, otherwise we would deassert CS while the last word is still being sent
+	dma_init_channel(dma_rx, source, DMA_SIZE_BYTE,
+		DMA_DIR_FROM_PERIPHERAL_TO_RAM, DMA_INTERRUPT_AT_FULL, DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+		DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT, DMA_OPERATING_ONE_SHOT,
+		&SPI_Queue_Dummy, 0, (void*)buf, 1, spi_id == SPI_1 ? spi1_queue_dma_cb : spi2_queue_dma_cb);
+	dma_set_priority(dma_rx, priority);
+	dma_init_channel(dma_tx, source, DMA_SIZE_BYTE,
+		DMA_DIR_FROM_RAM_TO_PERIPHERAL, DMA_INTERRUPT_AT_FULL, DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+		DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT, DMA_OPERATING_ONE_SHOT,
+		&SPI_Queue_Dummy, 0, (void*)buf, 1, 0);
+	dma_set_priority(dma_tx, priority);
+}
+
+/**
+	Describe a device on a queued SPI bus.
+	
+	The chip select is configured as an output and deasserted.
+	
+	\param	device
+			Device storage, owned by the caller, must remain valid while transactions to it are pending.
+	\param	spi_id
+			SPI id. One of \ref spi_id.
+	\param	ss
+			The chips select GPIO signal of the device.
+	\param	speed_khz
+			The speed of the SPI clock. The effective speed will not be higher than the specified speed, but can be slower.
+	\param	transfert_mode
+			The mode used for transfert. Must be one of \ref spi_tranfert_size.
+	\param 	polarity
+			The polarity used by the clock. Must be one of \ref spi_clock_polarity.
+	\param 	data_out_mode
+			Used to specify when the data out must happend on the clock transition. Must be one of \ref spi_data_out_mode.
+	\param 	sample_phase
+			Used to specify when the data must be sampled for RX. Must be one of \ref spi_sample_phase.
+*/
+void spi_device_init(SPI_Device* device, int spi_id, gpio ss, unsigned int speed_khz, int transfert_mode, int polarity, int data_out_mode, int sample_phase)
+{
+	ERROR_CHECK_RANGE(spi_id, SPI_1, SPI_2, SPI_INVALID_ID);
+	ERROR_CHECK_RANGE(transfert_mode, SPI_TRSF_BYTE, SPI_TRSF_WORD, SPI_INVALID_TRANFERT_MODE);
+	ERROR_CHECK_RANGE(polarity, SPI_CLOCK_IDLE_LOW, SPI_CLOCK_ACTIVE_LOW, SPI_INVALID_POLARITY);
+	ERROR_CHECK_RANGE(data_out_mode, SPI_DATA_OUT_CLK_IDLE_TO_ACTIVE, SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE, SPI_INVALID_DATA_OUT_MODE);
+	ERROR_CHECK_RANGE(sample_phase, SPI_SAMPLE_PHASE_MIDDLE, SPI_SAMPLE_PHASE_END, SPI_INVALID_SAMPLE_PHASE);
+	
+	device->spi_id = spi_id;
+	device->ss = ss;
+	device->con1 = SPI_CON1_MSTEN | spi_compute_prescalers(speed_khz);
+	if (transfert_mode == SPI_TRSF_WORD)
+		device->con1 |= SPI_CON1_MODE16;
+	if (sample_phase == SPI_SAMPLE_PHASE_END)
+		device->con1 |= SPI_CON1_SMP;
+	if (data_out_mode == SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE)
+		device->con1 |= SPI_CON1_CKE;
+	if (polarity == SPI_CLOCK_IDLE_HIGH)
+		device->con1 |= SPI_CON1_CKP;
+	
+	gpio_write(ss, true);
+	gpio_set_dir(ss, GPIO_OUTPUT);
+}
+
+/**
+	Queue an SPI transaction.
+	
+	The transaction starts immediately if the bus is idle, otherwise after the transactions already queued.
+	This function can be called from interrupts, including from the callback of a transaction.
+	
+	\param	transaction
+			Transaction storage, owned by the caller, must not be pending.
+	\param	device
+			Device to talk to, initialised by spi_device_init().
+	\param	tx_buffer
+			The data to send. Must be in DMA ram. Can be NULL to send zeros.
+	\param	rx_buffer
+			Where to store the received data. Must be in DMA ram. Can be NULL to discard it.
+	\param	count
+			The number of bytes or words to exchange, depending on the word size of the device.
+	\param 	callback
+			The callback called from the DMA interrupt when the transaction is done, may be 0.
+	\param	user_data
+			Passed to the callback.
+*/
+void spi_queue_transaction(SPI_Transaction* transaction, SPI_Device* device, void* tx_buffer, void* rx_buffer, unsigned int count, spi_transaction_callback callback, void* user_data)
+{
+	SPI_Queue* queue = &SPI_Queues[device->spi_id];
+	int flags;
+	
+	if (!count || (!tx_buffer && !rx_buffer))
+		ERROR(SPI_INVALID_TRANSFERT, &count);
+	if (transaction->pending)
+		ERROR(SPI_ERROR_TRANSACTION_PENDING, &transaction);
+	
+	transaction->device = device;
+	transaction->tx_buffer = tx_buffer;
+	transaction->rx_buffer = rx_buffer;
+	transaction->count = count;
+	transaction->callback = callback;
+	transaction->user_data = user_data;
+	transaction->next = 0;
+	transaction->pending = true;
+	
+	RAISE_IPL(flags, queue->ipl);
+	if (queue->head)
+	{
+		queue->tail->next = transaction;
+		queue->tail = transaction;
+	}
+	else
+	{
+		queue->head = transaction;
+		queue->tail = transaction;
+		spi_queue_start(device->spi_id);
+	}
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Return whether a queued SPI transaction is still pending.
+	
+	\param	transaction
+			Transaction to query.
+	\return	true until the transaction has completed and its callback has been called, false otherwise
+*/
+bool spi_is_transaction_pending(SPI_Transaction* transaction)
+{
+	return transaction->pending;
+}
+
+/*@}*/
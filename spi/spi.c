@@ -27,16 +27,17 @@
 #include "../clock/clock.h"
 #include "../dma/dma.h"
 #include "../gpio/gpio.h"
+#include "spi_priv.h"
 
 /**
-	\defgroup spi SPI
-	
-	Wrapper around SPI interface
+	\defgroup spi SPI
+	
+	Wrapper around SPI interface
 */
 /*@{*/
 
 /** \file
-	\brief Implementation of the SPI interface.
+	\brief Implementation of the SPI interface.
 */
 
 //-----------------------
@@ -90,6 +91,48 @@ static void spi2_dma_cb(int __attribute__((unused)) channel, bool __attribute__(
 		spi_status[1].callback(SPI_2);
 }
 
+/**
+	Compute the prescalers giving the fastest SPI clock not faster than speed_khz.
+	
+	\return	the SPRE and PPRE bits of SPIxCON1, that is SPRE << 2 | PPRE
+*/
+unsigned int spi_compute_prescalers(unsigned int speed_khz) {
+	unsigned int ratio;
+	unsigned long fcy;
+	int i,j;
+	unsigned int ppre;
+	
+	/* Get the "Optimal" speed: NOT > as asked speed*/
+	if(speed_khz > 15000 || speed_khz == 0) {
+		ERROR(SPI_INVALID_SPEED, &speed_khz);
+	}
+	
+	fcy = clock_get_cycle_frequency();
+	ratio = fcy / (((unsigned long)speed_khz) * 1000);
+	
+	if(ratio > 512) {
+		ERROR(SPI_INVALID_SPEED, &speed_khz);
+	}
+
+	for(i = 1, j = 3; i <= 64; i <<= 2, j--) 
+		if(ratio / i < 8) 
+			break;
+
+	ppre = j;
+
+	/* +1 is here to make sure we don't round at a higher frequency */
+	ratio = ratio / i + 1; 
+
+	for(i = 1, j = 7; i <= 8; i++, j--) 
+		if(ratio <= i) 
+			break;
+	
+	if(i == 9) 
+		j = 0;
+
+	return (j << 2) | ppre;
+}
+
 /** Used to implement a dummy semaphore-like mechanism */
 static void spi_dummy_wait(int spi) {
 	spi_status[spi].waiting = 0;
@@ -284,9 +327,7 @@ void spi_start_transfert(int spi_id, void * tx_buffer, void * rx_buffer, unsigne
 			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
 */
 void spi_init_master(int spi_id, unsigned int speed_khz, int dma_rx, int dma_tx, int transfert_mode, int polarity, int data_out_mode, int sample_phase, int priority) {
-	unsigned int ratio;
-	unsigned long fcy;
-	int i,j;
+	unsigned int prescalers;
 
 	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
 	ERROR_CHECK_RANGE(transfert_mode, SPI_TRSF_BYTE, SPI_TRSF_WORD, SPI_INVALID_TRANFERT_MODE);
@@ -310,36 +351,9 @@ void spi_init_master(int spi_id, unsigned int speed_khz, int dma_rx, int dma_tx,
 		_SPI1IP = priority;					/* Used to set the DMA priority */
 		
 		
-		/* Get the "Optimal" speed: NOT > as asked speed*/
-		if(speed_khz > 15000 || speed_khz == 0) {
-			ERROR(SPI_INVALID_SPEED, &speed_khz);
-		}
-		
-		fcy = clock_get_cycle_frequency();
-		ratio = fcy / (((unsigned long)speed_khz) * 1000);
-		
-
-		if(ratio > 512) {
-			ERROR(SPI_INVALID_SPEED, &speed_khz);
-		}
-
-		for(i = 1, j = 3; i <= 64; i <<= 2, j--) 
-			if(ratio / i < 8) 
-				break;
-
-		SPI1CON1bits.PPRE = j;
-
-		/* +1 is here to make sure we don't round at a higher frequency */
-		ratio = ratio / i + 1; 
-
-		for(i = 1, j = 7; i <= 8; i++, j--) 
-			if(ratio <= i) 
-				break;
-		
-		if(i == 9) 
-			j = 0;
-
-		SPI1CON1bits.SPRE = j;
+		prescalers = spi_compute_prescalers(speed_khz);
+		SPI1CON1bits.PPRE = prescalers & 0x3;
+		SPI1CON1bits.SPRE = prescalers >> 2;
 
 		spi_status[0].dma_rx = dma_rx;
 		spi_status[0].dma_tx = dma_tx;
@@ -360,34 +374,9 @@ void spi_init_master(int spi_id, unsigned int speed_khz, int dma_rx, int dma_tx,
 		SPI2CON2 = 0x0;						/* Framing support completly disabled */
 		_SPI2IP = priority;
 
-		/* Get the "Optimal" speed: NOT > as asked speed*/
-		if(speed_khz > 15000 || speed_khz == 0) {
-			ERROR(SPI_INVALID_SPEED, &speed_khz);
-		}
-		
-		fcy = clock_get_cycle_frequency();
-		ratio = (fcy)/ (((unsigned long)speed_khz) * 1000);
-		
-		if(ratio > 512) {
-			ERROR(SPI_INVALID_SPEED, &speed_khz);
-		}
-
-		for(i = 1, j = 3; i <= 64; i <<= 2, j--) 
-			if(ratio / i < 8) 
-				break;
-
-		SPI2CON1bits.PPRE = j;
-
-		/* +1 is here to make sure we don't round at a higher frequency */
-		ratio = ratio / i + 1; 
-
-		for(i = 1, j = 7; i <= 8; i++, j--) 
-			if(ratio <= i) 
-				break;
-
-		if(i == 9) 
-			j = 0;
-		SPI2CON1bits.SPRE = j;
+		prescalers = spi_compute_prescalers(speed_khz);
+		SPI2CON1bits.PPRE = prescalers & 0x3;
+		SPI2CON1bits.SPRE = prescalers >> 2;
 
 
 		spi_status[1].dma_rx = dma_rx;
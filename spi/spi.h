@@ -28,6 +28,7 @@
 
 #include "../types/types.h"
 #include "../gpio/gpio.h"
+#include "../dma/dma.h"
 
 //--------------------
 // Usage documentation
@@ -37,8 +38,8 @@
 /*@{*/
 
 /** \file
-	Wrapper around SPI interface
-*/
+	Wrapper around SPI interface
+*/
 
 /** Error spi can throw */
 enum spi_errors
@@ -51,6 +52,7 @@ enum spi_errors
 	SPI_INVALID_DATA_OUT_MODE,	/**< The specified data out mode is invalide */
 	SPI_INVALID_SAMPLE_PHASE,	/**< The specified sample phase mode is invalid */
 	SPI_INVALID_TRANSFERT,		/**< An invalide transfert has been requested */
+	SPI_ERROR_TRANSACTION_PENDING,	/**< A transaction was queued while it was already in a queue */
 };
 
 
@@ -100,6 +102,72 @@ void spi_init_slave(int spi_id, int transfert_mode, int polarity, int data_out_m
 
 void spi_slave_write(int spi_id, unsigned int data);
 
+// queued transactions for SPI master
+
+/** Device on a queued SPI bus, filled by spi_device_init(); the caller owns the storage, the fields are private */
+typedef struct
+{
+	int spi_id;			/**< SPI the device is connected to */
+	gpio ss;			/**< chip select of the device */
+	unsigned int con1;	/**< SPIxCON1 for this device: speed, word size and mode */
+} SPI_Device;
+
+/** Queued SPI transaction; the caller owns the storage */
+typedef struct _SPI_Transaction SPI_Transaction;
+
+/** SPI callback when a queued transaction has completed, called from the DMA interrupt */
+typedef void (*spi_transaction_callback)(SPI_Transaction* transaction, void* user_data);
+
+/** Queued SPI transaction, filled by spi_queue_transaction() */
+struct _SPI_Transaction
+{
+	SPI_Device* device;					/**< device to talk to */
+	void* tx_buffer;					/**< data to send, in DMA memory, 0 to send zeros */
+	void* rx_buffer;					/**< where to store the received data, in DMA memory, 0 to discard it */
+	unsigned int count;					/**< number of bytes or words to exchange, depending on the word size of the device */
+	spi_transaction_callback callback;	/**< function to call when the transaction has completed, may be 0 */
+	void* user_data;					/**< passed to the callback */
+	SPI_Transaction* next;				/**< private, next transaction in the queue */
+	bool pending;						/**< private, true while the transaction is queued or in progress */
+};
+
+void spi_queue_init(int spi_id, int dma_rx, int dma_tx, int priority);
+
+void spi_device_init(SPI_Device* device, int spi_id, gpio ss, unsigned int speed_khz, int transfert_mode, int polarity, int data_out_mode, int sample_phase);
+
+void spi_queue_transaction(SPI_Transaction* transaction, SPI_Device* device, void* tx_buffer, void* rx_buffer, unsigned int count, spi_transaction_callback callback, void* user_data);
+
+bool spi_is_transaction_pending(SPI_Transaction* transaction);
+
+// continuous streaming
+
+/** Continuous reception of an SPI into ping-pong buffers; the caller owns the storage */
+typedef struct _SPI_Stream SPI_Stream;
+
+/** SPI callback when a buffer of a stream is complete, called at the process IPL of the stream */
+typedef void (*spi_stream_callback)(SPI_Stream* stream, void* buffer, void* user_data);
+
+/** Continuous reception of an SPI into ping-pong buffers; the fields are private */
+struct _SPI_Stream
+{
+	DMA_Stream dma;					/**< tracking of the ping-pong buffers */
+	int spi_id;						/**< SPI */
+	int dma_rx;						/**< DMA channel receiving the words */
+	int dma_trigger;				/**< DMA channel sending a word at each trigger, -1 in slave mode */
+	gpio ss;						/**< chip select held low during the stream, GPIO_NONE if framed or slave */
+	spi_stream_callback callback;	/**< buffer complete callback */
+	void* user_data;				/**< passed to the callback */
+	unsigned long word_overruns;	/**< words lost because the DMA did not read the SPI in time */
+};
+
+void spi_stream_init_master(SPI_Stream* stream, SPI_Device* device, bool framed, unsigned int command, int trigger, int dma_trigger, int dma_rx, void* a, void* b, unsigned int count, spi_stream_callback callback, void* user_data, int priority, int process_ipl);
+
+void spi_stream_init_slave(SPI_Stream* stream, int spi_id, int transfert_mode, int polarity, int data_out_mode, int dma_rx, void* a, void* b, unsigned int count, spi_stream_callback callback, void* user_data, int priority, int process_ipl);
+
+void spi_stream_stop(SPI_Stream* stream);
+
+void spi_stream_get_counters(SPI_Stream* stream, unsigned long* blocks, unsigned long* buffer_overruns, unsigned long* word_overruns);
+
 	
 /*@}*/
 
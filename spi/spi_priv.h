@@ -0,0 +1,17 @@
+#ifndef _SPI_PRIV_H
+#define _SPI_PRIV_H
+
+// Bits of SPIxCON1
+#define SPI_CON1_MODE16		(1 << 10)	/**< word size */
+#define SPI_CON1_SMP		(1 << 9)	/**< data input sample phase */
+#define SPI_CON1_CKE		(1 << 8)	/**< clock edge select */
+#define SPI_CON1_CKP		(1 << 6)	/**< clock polarity */
+#define SPI_CON1_MSTEN		(1 << 5)	/**< master mode */
+
+// Bits of SPIxCON2
+#define SPI_CON2_FRMEN		(1 << 15)	/**< framed mode */
+
+// Helper function, shared between the one-shot, the queued and the streaming transferts
+unsigned int spi_compute_prescalers(unsigned int speed_khz);
+
+#endif // _SPI_PRIV_H
@@ -0,0 +1,383 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup spi */
+/*@{*/
+
+/** \file
+	Continuous SPI streaming into ping-pong DMA buffers.
+	
+	Restarting one-shot transferts from their callback leaves gaps between blocks, and jitter
+	between samples. A stream instead receives words continuously into two buffers A and B,
+	with a DMA channel in \ref DMA_OPERATING_CONTINUOUS_PING_PONG mode: while the DMA fills one buffer,
+	the callback processes the other one.
+	
+	In master mode, the exchange of each word is triggered by a peripheral, without CPU involvement:
+	a second DMA channel, requested by a timer or an external interrupt, writes a command word to the SPI
+	at each trigger. For instance, to read a 16-bit ADC at 50 kS/s:
+	
+	\code
+	static int adc_a[64] __attribute__((space(dma)));
+	static int adc_b[64] __attribute__((space(dma)));
+	static SPI_Device adc;
+	static SPI_Stream adc_stream;
+	
+	spi_device_init(&adc, SPI_1, GPIO_MAKE_ID(GPIO_PORTB, 2), 10000, SPI_TRSF_WORD, SPI_CLOCK_IDLE_LOW, SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE, SPI_SAMPLE_PHASE_MIDDLE);
+	spi_stream_init_master(&adc_stream, &adc, true, 0, DMA_INTERRUPT_SOURCE_TIMER_3, DMA_CHANNEL_1, DMA_CHANNEL_0, adc_a, adc_b, 64, adc_block, 0, 6, 3);
+	timer_init(TIMER_3, 20, 6);	// 20 us, the timer interrupt itself does not need to be enabled
+	timer_enable(TIMER_3);
+	\endcode
+	
+	Devices that need a chip select pulse for each word use the framed mode of the SPI, which generates
+	a frame synchronisation pulse on the SSx pin at the start of each word. Otherwise the chip select of the device
+	is held low during the whole stream.
+	
+	In slave mode, the external master clocks the words and no trigger is needed.
+	
+	Two kinds of overruns are counted: buffers lost because the callback was late, as for any DMA stream,
+	and words lost because the SPI received a new word before the DMA read the previous one.
+	The latter are detected by the SPI error interrupt, which is enabled at the priority of the stream.
+*/
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "spi.h"
+#include "spi_priv.h"
+#include "../error/error.h"
+#include "../dma/dma.h"
+#include "../gpio/gpio.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Streams running on SPI 1 and 2, 0 if none */
+static SPI_Stream* SPI_Streams[2];
+
+/** Command words sent at each trigger by the master streams of SPI 1 and 2 */
+static unsigned int SPI_Stream_Commands[2] __attribute__((space(dma)));
+
+
+//-------------------
+// Private functions
+//-------------------
+
+/** Deferred processing of the DMA stream, forwarded to the user */
+static void spi_stream_process(DMA_Stream* dma, void* buffer, void* user_data)
+{
+	SPI_Stream* stream = (SPI_Stream*)user_data;
+	
+	stream->callback(stream, buffer, stream->user_data);
+}
+
+/** Attach a stream to an SPI and start receiving, the SPI being configured but disabled */
+static void spi_stream_start(SPI_Stream* stream, int spi_id, int data_size, int dma_rx, void* a, void* b, unsigned int count, spi_stream_callback callback, void* user_data, int priority, int process_ipl)
+{
+	volatile unsigned int* buf = spi_id == SPI_1 ? &SPI1BUF : &SPI2BUF;
+	
+	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
+	if (!callback)
+		ERROR(SPI_INVALID_TRANSFERT, &callback);
+	
+	stream->spi_id = spi_id;
+	stream->dma_rx = dma_rx;
+	stream->callback = callback;
+	stream->user_data = user_data;
+	stream->word_overruns = 0;
+	SPI_Streams[spi_id] = stream;
+	
+	dma_stream_init(&stream->dma, dma_rx, a, b, spi_stream_process, stream, process_ipl);
+	dma_init_channel(dma_rx, spi_id == SPI_1 ? DMA_INTERRUPT_SOURCE_SPI_1 : DMA_INTERRUPT_SOURCE_SPI_2, data_size,
+		DMA_DIR_FROM_PERIPHERAL_TO_RAM, DMA_INTERRUPT_AT_FULL, DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+		DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT, DMA_OPERATING_CONTINUOUS_PING_PONG,
+		a, b, (void*)buf, count, dma_stream_interrupt);
+	dma_set_priority(dma_rx, priority);
+	dma_enable_channel(dma_rx);
+	
+	if (spi_id == SPI_1)
+	{
+		_SPI1IP = priority;
+		_SPI1EIP = priority;
+		_SPI1EIF = 0;
+		_SPI1EIE = 1;
+		SPI1STATbits.SPIEN = 1;
+	}
+	else
+	{
+		_SPI2IP = priority;
+		_SPI2EIP = priority;
+		_SPI2EIF = 0;
+		_SPI2EIE = 1;
+		SPI2STATbits.SPIEN = 1;
+	}
+}
+
+/** Count a word lost by an SPI receive overflow */
+static void spi_stream_overflow(int spi_id)
+{
+	if (SPI_Streams[spi_id])
+		SPI_Streams[spi_id]->word_overruns++;
+}
+
+
+//--------------------------
+// Interrupt service routine
+//--------------------------
+
+/**
+	SPI 1 error Interrupt Service Routine.
+	
+	The SPI stops receiving on overflow; drop the word and clear the overflow so that the stream continues.
+*/
+void _ISR _SPI1ErrInterrupt(void)
+{
+	_SPI1EIF = 0;
+	
+	(void) SPI1BUF;
+	SPI1STATbits.SPIROV = 0;
+	spi_stream_overflow(SPI_1);
+}
+
+/**
+	SPI 2 error Interrupt Service Routine.
+	
+	The SPI stops receiving on overflow; drop the word and clear the overflow so that the stream continues.
+*/
+void _ISR _SPI2ErrInterrupt(void)
+{
+	_SPI2EIF = 0;
+	
+	(void) SPI2BUF;
+	SPI2STATbits.SPIROV = 0;
+	spi_stream_overflow(SPI_2);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Start a continuous master stream, one word being exchanged at each trigger.
+	
+	\param	stream
+			Stream storage, owned by the caller, must remain valid until spi_stream_stop().
+	\param	device
+			Device to stream from, initialised by spi_device_init(); gives the SPI, its speed and mode, and the chip select.
+	\param	framed
+			If true, use the framed mode: the SSx pin of the SPI pulses at the start of each word and the chip select of the device is not used.
+			If false, the chip select of the device is held low until spi_stream_stop().
+	\param	command
+			Word sent at each trigger.
+	\param	trigger
+			DMA request source starting the exchange of each word, for instance \ref DMA_INTERRUPT_SOURCE_TIMER_3 or \ref DMA_INTERRUPT_SOURCE_INT_0.
+			The trigger peripheral is configured by the caller; its interrupt does not need to be enabled.
+	\param	dma_trigger
+			The DMA channel sending the command word at each trigger
+	\param	dma_rx
+			The DMA channel used for RX
+	\param	a
+			Buffer A, in DMA ram.
+	\param	b
+			Buffer B, in DMA ram.
+	\param	count
+			The number of words per buffer.
+	\param	callback
+			Function called for each completed buffer, which can be used until the other buffer is complete.
+	\param	user_data
+			Passed to the callback.
+	\param 	priority
+			Interrupt priority of the DMA channels and of the SPI error, from 1 (lowest priority) to 6 (highest normal priority)
+	\param	process_ipl
+			IPL at which the callback runs, must be lower than priority.
+*/
+void spi_stream_init_master(SPI_Stream* stream, SPI_Device* device, bool framed, unsigned int command, int trigger, int dma_trigger, int dma_rx, void* a, void* b, unsigned int count, spi_stream_callback callback, void* user_data, int priority, int process_ipl)
+{
+	int spi_id = device->spi_id;
+	int data_size = (device->con1 & SPI_CON1_MODE16) ? DMA_SIZE_WORD : DMA_SIZE_BYTE;
+	volatile unsigned int* buf = spi_id == SPI_1 ? &SPI1BUF : &SPI2BUF;
+	
+	// Configure the SPI, disabled until the stream is ready
+	if (spi_id == SPI_1)
+	{
+		SPI1STAT = 0;
+		SPI1CON1 = device->con1;
+		SPI1CON2 = framed ? SPI_CON2_FRMEN : 0;		/* Master, frame pulse active low at the start of the word */
+	}
+	else
+	{
+		SPI2STAT = 0;
+		SPI2CON1 = device->con1;
+		SPI2CON2 = framed ? SPI_CON2_FRMEN : 0;
+	}
+	
+	stream->dma_trigger = dma_trigger;
+	stream->ss = framed ? GPIO_NONE : device->ss;
+	spi_stream_start(stream, spi_id, data_size, dma_rx, a, b, count, callback, user_data, priority, process_ipl);
+	
+	if (!framed)
+		gpio_write(device->ss, false);
+	
+	// Send the command word at each trigger, from the same location
+	SPI_Stream_Commands[spi_id] = command;
+	dma_init_channel(dma_trigger, trigger, data_size,
+		DMA_DIR_FROM_RAM_TO_PERIPHERAL, DMA_INTERRUPT_AT_FULL, DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+		DMA_ADDRESSING_REGISTER, DMA_OPERATING_CONTINUOUS,
+		&SPI_Stream_Commands[spi_id], 0, (void*)buf, 1, 0);
+	dma_enable_channel(dma_trigger);
+}
+
+/**
+	Start a continuous slave stream, the words being clocked by the external master.
+	
+	\param	stream
+			Stream storage, owned by the caller, must remain valid until spi_stream_stop().
+	\param	spi_id
+			SPI id. One of \ref spi_id.
+	\param	transfert_mode
+			The mode used for transfert. Must be one of \ref spi_tranfert_size.
+	\param 	polarity
+			The polarity used by the clock. Must be one of \ref spi_clock_polarity.
+	\param 	data_out_mode
+			Used to specify when the data out must happend on the clock transition. Must be one of \ref spi_data_out_mode.
+	\param	dma_rx
+			The DMA channel used for RX
+	\param	a
+			Buffer A, in DMA ram.
+	\param	b
+			Buffer B, in DMA ram.
+	\param	count
+			The number of words per buffer.
+	\param	callback
+			Function called for each completed buffer, which can be used until the other buffer is complete.
+	\param	user_data
+			Passed to the callback.
+	\param 	priority
+			Interrupt priority of the DMA channel and of the SPI error, from 1 (lowest priority) to 6 (highest normal priority)
+	\param	process_ipl
+			IPL at which the callback runs, must be lower than priority.
+*/
+void spi_stream_init_slave(SPI_Stream* stream, int spi_id, int transfert_mode, int polarity, int data_out_mode, int dma_rx, void* a, void* b, unsigned int count, spi_stream_callback callback, void* user_data, int priority, int process_ipl)
+{
+	unsigned int con1 = 0;
+	
+	ERROR_CHECK_RANGE(spi_id, SPI_1, SPI_2, SPI_INVALID_ID);
+	ERROR_CHECK_RANGE(transfert_mode, SPI_TRSF_BYTE, SPI_TRSF_WORD, SPI_INVALID_TRANFERT_MODE);
+	ERROR_CHECK_RANGE(polarity, SPI_CLOCK_IDLE_LOW, SPI_CLOCK_ACTIVE_LOW, SPI_INVALID_POLARITY);
+	ERROR_CHECK_RANGE(data_out_mode, SPI_DATA_OUT_CLK_IDLE_TO_ACTIVE, SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE, SPI_INVALID_DATA_OUT_MODE);
+	
+	// SMP must be clear and, errata 8, the slave select pin is not working
+	if (transfert_mode == SPI_TRSF_WORD)
+		con1 |= SPI_CON1_MODE16;
+	if (data_out_mode == SPI_DATA_OUT_CLK_ACTIVE_TO_IDLE)
+		con1 |= SPI_CON1_CKE;
+	if (polarity == SPI_CLOCK_IDLE_HIGH)
+		con1 |= SPI_CON1_CKP;
+	
+	if (spi_id == SPI_1)
+	{
+		SPI1STAT = 0;
+		SPI1CON1 = con1;
+		SPI1CON2 = 0x0;						/* Framing support completly disabled */
+	}
+	else
+	{
+		SPI2STAT = 0;
+		SPI2CON1 = con1;
+		SPI2CON2 = 0x0;						/* Framing support completly disabled */
+	}
+	
+	stream->dma_trigger = -1;
+	stream->ss = GPIO_NONE;
+	spi_stream_start(stream, spi_id, transfert_mode == SPI_TRSF_WORD ? DMA_SIZE_WORD : DMA_SIZE_BYTE, dma_rx, a, b, count, callback, user_data, priority, process_ipl);
+}
+
+/**
+	Stop a stream; the buffer being filled is dropped.
+	
+	Its DMA channels are released, so they can be initialised again for another request source.
+	
+	\param	stream
+			Stream to stop.
+*/
+void spi_stream_stop(SPI_Stream* stream)
+{
+	if (stream->dma_trigger >= 0)
+		dma_release_channel(stream->dma_trigger);
+	dma_release_channel(stream->dma_rx);
+	dma_stream_close(&stream->dma);
+	
+	if (stream->spi_id == SPI_1)
+	{
+		_SPI1EIE = 0;
+		SPI1STATbits.SPIEN = 0;
+		SPI1CON2 = 0x0;
+	}
+	else
+	{
+		_SPI2EIE = 0;
+		SPI2STATbits.SPIEN = 0;
+		SPI2CON2 = 0x0;
+	}
+	
+	if (stream->ss != GPIO_NONE)
+		gpio_write(stream->ss, true);
+	SPI_Streams[stream->spi_id] = 0;
+}
+
+/**
+	Read the counters of a stream.
+	
+	\param	stream
+			Stream to read.
+	\param	blocks
+			Filled with the number of buffers completed; ignored if 0.
+	\param	buffer_overruns
+			Filled with the number of buffers lost or overwritten because the callback was late; ignored if 0.
+	\param	word_overruns
+			Filled with the number of words lost because the DMA did not read the SPI in time; ignored if 0.
+*/
+void spi_stream_get_counters(SPI_Stream* stream, unsigned long* blocks, unsigned long* buffer_overruns, unsigned long* word_overruns)
+{
+	int flags;
+	
+	dma_stream_get_counters(&stream->dma, blocks, buffer_overruns);
+	if (word_overruns)
+	{
+		RAISE_IPL(flags, 7);
+		*word_overruns = stream->word_overruns;
+		IRQ_ENABLE(flags);
+	}
+}
+
+/*@}*/
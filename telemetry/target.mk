@@ -0,0 +1,25 @@
+.SUFFIXES:
+
+ifndef builddir
+builddir := local
+export builddir
+endif
+
+OBJDIR := build-$(builddir)
+
+MAKETARGET = $(MAKE) --no-print-directory -C $@ -f $(CURDIR)/Makefile \
+				SRCDIR=$(CURDIR) $(MAKECMDGOALS)
+
+.PHONY: $(OBJDIR)
+$(OBJDIR):
+	+@[ -d $@ ] || mkdir -p $@
+	+@$(MAKETARGET)
+
+Makefile : ;
+%.mk :: ;
+
+% :: $(OBJDIR) ; :
+
+.PHONY: clean
+clean:
+	rm -rf $(OBJDIR) *~
\ No newline at end of file
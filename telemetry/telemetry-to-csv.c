@@ -0,0 +1,306 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** \addtogroup telemetry */
+/*@{*/
+
+/** \file
+	Host program converting a telemetry stream into CSV.
+	
+	This file is not part of the library; build it with the host compiler, for instance:
+	\code
+	cc -std=c99 -o telemetry-to-csv telemetry-to-csv.c
+	./telemetry-to-csv < /dev/ttyUSB0 > log.csv
+	\endcode
+	
+	The stream is read from the file given as argument, or from the standard input.
+	A header line is written each time a complete schema is received, then one line per record,
+	starting with its sequence number. Delta records following a lost record are skipped until the next key record.
+	A summary is written to the standard error at the end of the stream.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Maximum number of fields, as TELEMETRY_MAX_FIELDS on the device */
+#define MAX_FIELDS 16
+
+/** Maximum size of a decoded message */
+#define MAX_MESSAGE_SIZE 256
+
+/** Types of fields, as telemetry_field_types on the device */
+enum { INT8 = 0, UINT8, INT16, UINT16, INT32, UINT32 };
+
+/** A field of the schema */
+typedef struct
+{
+	int type;
+	int delta;
+	char name[33];
+} Field;
+
+/** Decoder state */
+static struct
+{
+	Field fields[MAX_FIELDS];
+	unsigned field_count;
+	unsigned received_fields;	/**< bit n is set if field n has been received */
+	int schema_complete;
+	int64_t previous[MAX_FIELDS];
+	int have_previous;
+	unsigned expected_sequence;
+	unsigned long records;
+	unsigned long skipped;
+	unsigned long errors;
+} Decoder;
+
+/** CRC-16/CCITT, as packet_crc16() on the device */
+static unsigned crc16(const unsigned char* data, size_t length)
+{
+	unsigned crc = 0xFFFF;
+	int i;
+	
+	while (length--)
+	{
+		crc ^= (unsigned)*data++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc & 0xFFFF;
+}
+
+/** Read a variable-length integer, return 0 if the message is truncated */
+static int read_varint(const unsigned char** position, const unsigned char* end, uint64_t* value)
+{
+	int shift = 0;
+	
+	*value = 0;
+	while (*position < end && shift < 64)
+	{
+		unsigned char byte = *(*position)++;
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return 1;
+		shift += 7;
+	}
+	return 0;
+}
+
+/** Reduce a value to the range of a field type */
+static int64_t to_type(int64_t value, int type)
+{
+	switch (type)
+	{
+		case INT8: return (int8_t)value;
+		case UINT8: return (uint8_t)value;
+		case INT16: return (int16_t)value;
+		case UINT16: return (uint16_t)value;
+		case INT32: return (int32_t)value;
+		default: return (uint32_t)value;
+	}
+}
+
+/** Process a field message */
+static void field_message(const unsigned char* data, size_t length)
+{
+	unsigned index, count, name_length;
+	Field* field;
+	
+	if (length < 4 || data[0] >= MAX_FIELDS || data[1] == 0 || data[1] > MAX_FIELDS || data[0] >= data[1])
+	{
+		Decoder.errors++;
+		return;
+	}
+	index = data[0];
+	count = data[1];
+	
+	// a different field count, or the first field after a complete schema, starts a new schema
+	if (count != Decoder.field_count || (index == 0 && Decoder.schema_complete))
+	{
+		Decoder.field_count = count;
+		Decoder.received_fields = 0;
+		Decoder.schema_complete = 0;
+		Decoder.have_previous = 0;
+	}
+	
+	field = &Decoder.fields[index];
+	field->type = data[2];
+	field->delta = data[3];
+	name_length = length - 4 < 32 ? length - 4 : 32;
+	memcpy(field->name, data + 4, name_length);
+	field->name[name_length] = 0;
+	Decoder.received_fields |= 1u << index;
+	
+	if (Decoder.received_fields == (1u << count) - 1 && !Decoder.schema_complete)
+	{
+		Decoder.schema_complete = 1;
+		printf("sequence");
+		for (index = 0; index < count; index++)
+			printf(",%s", Decoder.fields[index].name);
+		printf("\n");
+	}
+}
+
+/** Process a record message */
+static void record_message(int key, const unsigned char* data, size_t length)
+{
+	const unsigned char* position = data + 1;
+	const unsigned char* end = data + length;
+	int64_t values[MAX_FIELDS];
+	uint64_t raw;
+	int64_t value;
+	unsigned i;
+	
+	if (length < 1 || !Decoder.schema_complete)
+	{
+		Decoder.skipped++;
+		return;
+	}
+	if (!key && (!Decoder.have_previous || data[0] != Decoder.expected_sequence))
+	{
+		// a record was lost, wait for the next key record
+		Decoder.have_previous = 0;
+		Decoder.skipped++;
+		return;
+	}
+	
+	for (i = 0; i < Decoder.field_count; i++)
+	{
+		const Field* field = &Decoder.fields[i];
+		int is_signed = field->type == INT8 || field->type == INT16 || field->type == INT32;
+		
+		if (!read_varint(&position, end, &raw))
+		{
+			Decoder.errors++;
+			return;
+		}
+		if ((!key && field->delta) || is_signed)
+			value = (raw & 1) ? -(int64_t)(raw >> 1) - 1 : (int64_t)(raw >> 1);
+		else
+			value = (int64_t)raw;
+		if (!key && field->delta)
+			value = Decoder.previous[i] + value;
+		values[i] = to_type(value, field->type);
+	}
+	
+	memcpy(Decoder.previous, values, sizeof(values));
+	Decoder.have_previous = 1;
+	Decoder.expected_sequence = (data[0] + 1) & 0xFF;
+	Decoder.records++;
+	
+	printf("%u", data[0]);
+	for (i = 0; i < Decoder.field_count; i++)
+		printf(",%lld", (long long)values[i]);
+	printf("\n");
+}
+
+/** Decode a COBS frame and process its message */
+static void frame(const unsigned char* encoded, size_t length)
+{
+	unsigned char message[MAX_MESSAGE_SIZE];
+	size_t size = 0;
+	size_t i = 0;
+	
+	if (length == 0)
+		return;
+	
+	while (i < length)
+	{
+		unsigned code = encoded[i++];
+		unsigned j;
+		
+		for (j = 1; j < code; j++)
+		{
+			if (i >= length || size >= sizeof(message))
+			{
+				Decoder.errors++;
+				return;
+			}
+			message[size++] = encoded[i++];
+		}
+		if (code != 0xFF && i < length)
+		{
+			if (size >= sizeof(message))
+			{
+				Decoder.errors++;
+				return;
+			}
+			message[size++] = 0;
+		}
+	}
+	
+	if (size < 3 || crc16(message, size) != 0)
+	{
+		Decoder.errors++;
+		return;
+	}
+	size -= 2;
+	
+	switch (message[0])
+	{
+		case 'F': field_message(message + 1, size - 1); break;
+		case 'K': record_message(1, message + 1, size - 1); break;
+		case 'D': record_message(0, message + 1, size - 1); break;
+		default: Decoder.errors++; break;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned char encoded[MAX_MESSAGE_SIZE + 8];
+	size_t length = 0;
+	int overflow = 0;
+	FILE* input = stdin;
+	int c;
+	
+	if (argc > 1 && !(input = fopen(argv[1], "rb")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	
+	while ((c = fgetc(input)) != EOF)
+	{
+		if (c == 0)
+		{
+			if (overflow)
+				Decoder.errors++;
+			else
+				frame(encoded, length);
+			length = 0;
+			overflow = 0;
+		}
+		else if (length < sizeof(encoded))
+			encoded[length++] = (unsigned char)c;
+		else
+			overflow = 1;
+	}
+	
+	fprintf(stderr, "%lu records, %lu skipped, %lu errors\n", Decoder.records, Decoder.skipped, Decoder.errors);
+	return 0;
+}
+
+/*@}*/
@@ -0,0 +1,344 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+	\defgroup telemetry Telemetry
+	
+	Binary telemetry records streamed over a \ref serial-io stream.
+	
+	The application describes its record structure with a schema, a table of \ref Telemetry_Field,
+	and sends records with telemetry_send_record(). Compared to printing values in ASCII,
+	a record takes a fraction of the bytes and no division is needed to encode it.
+	
+	\code
+	typedef struct
+	{
+		unsigned long time;
+		int speed;
+		int position;
+		unsigned char state;
+	} Log_Record;
+	
+	static const Telemetry_Field log_schema[] =
+	{
+		TELEMETRY_FIELD(Log_Record, time, TELEMETRY_UINT32, TELEMETRY_DELTA),
+		TELEMETRY_FIELD(Log_Record, speed, TELEMETRY_INT16, TELEMETRY_ABSOLUTE),
+		TELEMETRY_FIELD(Log_Record, position, TELEMETRY_INT16, TELEMETRY_DELTA),
+		TELEMETRY_FIELD(Log_Record, state, TELEMETRY_UINT8, TELEMETRY_ABSOLUTE),
+	};
+	
+	telemetry_init(&telemetry, &serial, log_schema, 4, 50);
+	...
+	telemetry_send_record(&telemetry, &record);
+	\endcode
+	
+	\section Stream format
+	
+	The stream is made of messages, each followed by its CRC-16 (see packet_crc16(), most significant byte first),
+	encoded with Consistent Overhead Byte Stuffing and terminated by a 0 byte, so that a receiver can start anywhere
+	in the stream. The first byte of a message is its type:
+	- 'F': a field of the schema: index, field count, type, encoding, then the characters of the name.
+	  The schema is sent by telemetry_init() and again by telemetry_send_schema(), for instance when a host connects.
+	- 'K': a key record: sequence number, then the value of each field.
+	- 'D': a delta record: sequence number, then the value of each field, or for fields with the \ref TELEMETRY_DELTA
+	  encoding the difference with the previous record, modulo 2^32.
+	
+	Values are sent as variable-length integers, 7 bits per byte starting with the least significant ones,
+	the most significant bit of a byte telling that more bytes follow.
+	Signed values and differences are first zigzag-encoded (0, -1, 1, -2... become 0, 1, 2, 3...),
+	so that small magnitudes take one byte.
+	A key record is sent every key_interval records, so a receiver that lost a record,
+	which it detects with the sequence number, resynchronizes on the next key record.
+	
+	Records are never waited for: if the transmission buffer of the serial stream lacks room,
+	telemetry_send_record() drops the record and returns false, and the next record is sent as if it had not existed.
+	
+	telemetry-to-csv.c, in this directory, is a host program converting a stream into CSV.
+*/
+/*@{*/
+
+/** \file
+	Implementation of the binary telemetry records.
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include "telemetry.h"
+#include "../packet/packet.h"
+#include "../error/error.h"
+
+/** Types of messages */
+enum telemetry_message_types
+{
+	TELEMETRY_MESSAGE_FIELD = 'F',		/**< description of a field */
+	TELEMETRY_MESSAGE_KEY = 'K',		/**< record with values */
+	TELEMETRY_MESSAGE_DELTA = 'D',		/**< record with differences */
+};
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Read a field of a record as a long */
+static long read_field(const Telemetry_Field* field, const unsigned char* record)
+{
+	const void* data = record + field->offset;
+	
+	switch (field->type)
+	{
+		case TELEMETRY_INT8: return *(const signed char*)data;
+		case TELEMETRY_UINT8: return *(const unsigned char*)data;
+		case TELEMETRY_INT16: return *(const int*)data;
+		case TELEMETRY_UINT16: return *(const unsigned int*)data;
+		default: return *(const long*)data;
+	}
+}
+
+/** Write an unsigned variable-length integer at position, return the position after it */
+static unsigned char* write_varint(unsigned char* position, unsigned long value)
+{
+	while (value >= 0x80)
+	{
+		*position++ = (unsigned char)value | 0x80;
+		value >>= 7;
+	}
+	*position++ = (unsigned char)value;
+	return position;
+}
+
+/** Write a signed variable-length integer, zigzag-encoded, at position, return the position after it */
+static unsigned char* write_signed_varint(unsigned char* position, long value)
+{
+	if (value < 0)
+		return write_varint(position, ~((unsigned long)value << 1));
+	else
+		return write_varint(position, (unsigned long)value << 1);
+}
+
+/** Return the size of the largest record of a schema, once framed: COBS code, type, sequence, values, CRC and terminator */
+static unsigned int max_framed_record_size(const Telemetry_Field* fields, unsigned int field_count)
+{
+	unsigned int size = 1 + 2 + 2 + 1;
+	unsigned int i;
+	
+	for (i = 0; i < field_count; i++)
+	{
+		// A difference is modulo 2^32, so it takes up to 5 bytes whatever the type; a zigzag-encoded value takes one more bit
+		if (fields[i].encoding == TELEMETRY_DELTA || fields[i].type == TELEMETRY_INT32 || fields[i].type == TELEMETRY_UINT32)
+			size += 5;
+		else if (fields[i].type == TELEMETRY_INT16 || fields[i].type == TELEMETRY_UINT16)
+			size += 3;
+		else
+			size += 2;
+	}
+	
+	return size;
+}
+
+/**
+	Finish the message of length bytes stored from telemetry->message[1], and send it.
+	
+	The CRC is appended, and the message is COBS-encoded in place: as it is shorter than 254 bytes,
+	each 0 byte is replaced by the distance to the next one, the first distance being stored in message[0].
+	Return false if there is not enough room in the transmission buffer and wait is false.
+*/
+static bool send_message(Telemetry* telemetry, unsigned int length, bool wait)
+{
+	unsigned char* message = telemetry->message;
+	unsigned int crc = packet_crc16(0xFFFF, message + 1, length);
+	unsigned int code_position = 0;
+	unsigned int i;
+	
+	message[++length] = crc >> 8;
+	message[++length] = crc;
+	
+	if (!wait && serial_io_get_free_space(telemetry->serial) < length + 2)
+		return false;
+	
+	message[0] = 0;
+	for (i = 1; i <= length; i++)
+	{
+		if (message[i] == 0)
+		{
+			message[code_position] = i - code_position;
+			code_position = i;
+		}
+	}
+	message[code_position] = i - code_position;
+	message[i] = 0;
+	
+	serial_io_send_buffer(telemetry->serial, (const char*)message, length + 2);
+	return true;
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize a telemetry stream, and send its schema.
+	
+	\param	telemetry
+			Telemetry stream to initialize, must remain valid while the stream is used.
+	\param	serial
+			Initialized serial stream to send the records to. Its transmission buffer must hold the largest record
+			of the schema once framed, up to \ref TELEMETRY_MAX_MESSAGE_SIZE + 2 bytes, otherwise it would always be dropped.
+	\param	fields
+			Schema of the records, must remain valid while the stream is used.
+	\param	field_count
+			Number of fields, from 1 to \ref TELEMETRY_MAX_FIELDS.
+	\param	key_interval
+			A record without delta encoding is sent every key_interval records; 1 disables the delta encoding.
+*/
+void telemetry_init(Telemetry* telemetry, Serial_IO_State* serial, const Telemetry_Field* fields, unsigned int field_count, unsigned int key_interval)
+{
+	unsigned int i;
+	
+	if (field_count == 0 || field_count > TELEMETRY_MAX_FIELDS)
+		ERROR(TELEMETRY_ERROR_INVALID_FIELD_COUNT, &field_count);
+	for (i = 0; i < field_count; i++)
+		if (fields[i].type > TELEMETRY_UINT32)
+			ERROR(TELEMETRY_ERROR_INVALID_FIELD_TYPE, &i);
+	
+	// One byte of the ring is kept free, so its capacity is its mask
+	i = max_framed_record_size(fields, field_count);
+	if (i > serial->transmission_buffer_mask)
+		ERROR(TELEMETRY_ERROR_BUFFER_TOO_SMALL, &i);
+	
+	telemetry->serial = serial;
+	telemetry->fields = fields;
+	telemetry->field_count = field_count;
+	telemetry->key_interval = key_interval ? key_interval : 1;
+	telemetry->sequence = 0;
+	telemetry->records_dropped = 0;
+	
+	telemetry_send_schema(telemetry);
+}
+
+/**
+	Send the schema of a telemetry stream.
+	
+	This function waits while the transmission buffer is full.
+	The next record is sent without delta encoding.
+	
+	\param	telemetry
+			Telemetry stream.
+*/
+void telemetry_send_schema(Telemetry* telemetry)
+{
+	const Telemetry_Field* field;
+	unsigned char* position;
+	const char* name;
+	unsigned int i;
+	
+	for (i = 0; i < telemetry->field_count; i++)
+	{
+		field = &telemetry->fields[i];
+		position = telemetry->message + 1;
+		*position++ = TELEMETRY_MESSAGE_FIELD;
+		*position++ = i;
+		*position++ = telemetry->field_count;
+		*position++ = field->type;
+		*position++ = field->encoding;
+		for (name = field->name; *name && name - field->name < TELEMETRY_MAX_NAME_LENGTH; name++)
+			*position++ = *name;
+		
+		send_message(telemetry, position - (telemetry->message + 1), true);
+	}
+	
+	telemetry->until_key = 0;
+}
+
+/**
+	Send a record, if there is room for it in the transmission buffer.
+	
+	\param	telemetry
+			Telemetry stream.
+	\param	record
+			Record described by the schema.
+	\return	true if the record was queued, false if it was dropped because the transmission buffer was full.
+*/
+bool telemetry_send_record(Telemetry* telemetry, const void* record)
+{
+	const Telemetry_Field* field;
+	unsigned char* position = telemetry->message + 1;
+	bool key = (telemetry->until_key == 0);
+	long values[TELEMETRY_MAX_FIELDS];
+	unsigned int i;
+	
+	*position++ = key ? TELEMETRY_MESSAGE_KEY : TELEMETRY_MESSAGE_DELTA;
+	*position++ = telemetry->sequence;
+	
+	for (i = 0; i < telemetry->field_count; i++)
+	{
+		field = &telemetry->fields[i];
+		values[i] = read_field(field, (const unsigned char*)record);
+		
+		if (!key && field->encoding == TELEMETRY_DELTA)
+			position = write_signed_varint(position, (long)((unsigned long)values[i] - (unsigned long)telemetry->previous[i]));
+		else if (field->type == TELEMETRY_INT8 || field->type == TELEMETRY_INT16 || field->type == TELEMETRY_INT32)
+			position = write_signed_varint(position, values[i]);
+		else
+			position = write_varint(position, (unsigned long)values[i]);
+	}
+	
+	if (!send_message(telemetry, position - (telemetry->message + 1), false))
+	{
+		// The record never existed for the receiver, the next one is encoded against the same previous values
+		telemetry->records_dropped++;
+		return false;
+	}
+	
+	for (i = 0; i < telemetry->field_count; i++)
+		telemetry->previous[i] = values[i];
+	telemetry->sequence++;
+	telemetry->until_key = (key ? telemetry->key_interval : telemetry->until_key) - 1;
+	
+	return true;
+}
+
+/**
+	Return the number of records dropped because the transmission buffer was full.
+	
+	\param	telemetry
+			Telemetry stream.
+	\return	the number of records dropped since telemetry_init().
+*/
+unsigned long telemetry_get_dropped_records(Telemetry* telemetry)
+{
+	return telemetry->records_dropped;
+}
+
+/*@}*/
@@ -0,0 +1,121 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_TELEMETRY_H
+#define _MOLOLE_TELEMETRY_H
+
+#include <stddef.h>
+
+#include "../types/types.h"
+#include "../serial-io/serial-io.h"
+
+/** \addtogroup telemetry */
+/*@{*/
+
+/** \file
+	\brief Binary telemetry records streamed over serial-io.
+*/
+
+// Defines
+
+/** Errors telemetry can throw */
+enum telemetry_errors
+{
+	TELEMETRY_ERROR_BASE = 0x1800,
+	TELEMETRY_ERROR_INVALID_FIELD_COUNT,	/**< The schema has no field or more than TELEMETRY_MAX_FIELDS fields. */
+	TELEMETRY_ERROR_INVALID_FIELD_TYPE,		/**< A field type is not one of \ref telemetry_field_types. */
+	TELEMETRY_ERROR_BUFFER_TOO_SMALL,		/**< The largest record of the schema, once framed, does not fit in the transmission buffer. */
+};
+
+/** Types of the fields of a record */
+enum telemetry_field_types
+{
+	TELEMETRY_INT8 = 0,		/**< signed char */
+	TELEMETRY_UINT8,		/**< unsigned char */
+	TELEMETRY_INT16,		/**< int */
+	TELEMETRY_UINT16,		/**< unsigned int */
+	TELEMETRY_INT32,		/**< long */
+	TELEMETRY_UINT32,		/**< unsigned long */
+};
+
+/** Encodings of the fields of a record */
+enum telemetry_field_encodings
+{
+	TELEMETRY_ABSOLUTE = 0,	/**< the value is sent */
+	TELEMETRY_DELTA,		/**< the difference with the value of the previous record is sent, for slowly changing fields */
+};
+
+/** Maximum number of fields in a record */
+#define TELEMETRY_MAX_FIELDS 16
+
+/** Maximum number of characters of a field name sent in the schema */
+#define TELEMETRY_MAX_NAME_LENGTH 32
+
+/** Size of the largest message: type, sequence, 5 bytes per field, and CRC */
+#define TELEMETRY_MAX_MESSAGE_SIZE (2 + 5 * TELEMETRY_MAX_FIELDS + 2)
+
+/** Describe a field of a record of type record_type, to be used in a \ref Telemetry_Field array */
+#define TELEMETRY_FIELD(record_type, member, type, encoding) { #member, type, encoding, offsetof(record_type, member) }
+
+// Structures definitions
+
+/** Description of a field of a record */
+typedef struct
+{
+	const char* name;			/**< name of the field, as shown by the decoder */
+	unsigned char type;			/**< type, one of \ref telemetry_field_types */
+	unsigned char encoding;		/**< encoding, one of \ref telemetry_field_encodings */
+	unsigned int offset;		/**< offset of the field in the record */
+} Telemetry_Field;
+
+/** Telemetry stream; the caller owns the storage, the fields are private */
+typedef struct _Telemetry Telemetry;
+
+struct _Telemetry
+{
+	Serial_IO_State* serial;						/**< serial stream the records are sent to */
+	const Telemetry_Field* fields;					/**< schema */
+	unsigned int field_count;						/**< number of fields in the schema */
+	unsigned int key_interval;						/**< number of records between two records without delta encoding */
+	unsigned int until_key;							/**< number of records to send before the next key record */
+	unsigned char sequence;							/**< sequence number of the next record */
+	unsigned long records_dropped;					/**< records not sent because the transmission buffer was full */
+	long previous[TELEMETRY_MAX_FIELDS];			/**< values of the last record sent */
+	unsigned char message[TELEMETRY_MAX_MESSAGE_SIZE + 2];	/**< message being encoded */
+};
+
+// Functions, doc in the .c
+
+void telemetry_init(Telemetry* telemetry, Serial_IO_State* serial, const Telemetry_Field* fields, unsigned int field_count, unsigned int key_interval);
+
+void telemetry_send_schema(Telemetry* telemetry);
+
+bool telemetry_send_record(Telemetry* telemetry, const void* record);
+
+unsigned long telemetry_get_dropped_records(Telemetry* telemetry);
+
+/*@}*/
+
+#endif
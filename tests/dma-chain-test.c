@@ -0,0 +1,155 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host test of the DMA chains, on the host model of the DMA channel registers:
+// segments are programmed in order, circular chains loop, and the idle mode lock
+// of Errata 38 taken through dma_enable_channel() is always released.
+
+#include "host/host.h"
+#include "../dma/dma.h"
+
+unsigned int Host_DMA_Registers[8][6];
+
+/** Idle mode locks taken by dma_enable_channel() on one-shot channels */
+static int idle_locks;
+
+// Channel control, modelling the accounting of dma.c for one-shot channels
+
+void dma_enable_channel(int channel)
+{
+	DMA_CHANNEL_REGISTERS(channel)->con |= DMA_CON_CHEN;
+	idle_locks++;
+}
+
+void dma_disable_channel(int channel)
+{
+	DMA_CHANNEL_REGISTERS(channel)->con &= ~DMA_CON_CHEN;
+	idle_locks--;
+	CHECK(idle_locks >= 0);
+}
+
+void dma_start_transfer(int channel)
+{
+	DMA_CHANNEL_REGISTERS(channel)->req |= DMA_REQ_FORCE;
+}
+
+/** Segments seen by the model */
+static struct { unsigned int sta; unsigned int cnt; } transferred[32];
+static unsigned int transferred_count;
+static unsigned int laps;
+
+/** Transfer the programmed segment, as the hardware does in one-shot mode, and raise the interrupt */
+static void run_segment(int channel)
+{
+	DMA_Channel_Registers* registers = DMA_CHANNEL_REGISTERS(channel);
+	
+	CHECK(registers->con & DMA_CON_CHEN);
+	CHECK(transferred_count < 32);
+	transferred[transferred_count].sta = registers->sta;
+	transferred[transferred_count].cnt = registers->cnt;
+	transferred_count++;
+	registers->req &= ~DMA_REQ_FORCE;
+	registers->con &= ~DMA_CON_CHEN;
+	dma_chain_interrupt(channel, true);
+}
+
+static void chain_done(DMA_Chain* chain, void* user_data)
+{
+	CHECK(user_data == &laps);
+	laps++;
+}
+
+int main(void)
+{
+	DMA_Descriptor descriptors[3] = {
+		{ Host_DMA_Memory + 16, 4 },
+		{ Host_DMA_Memory + 100, 1 },
+		{ Host_DMA_Memory + 512, 300 },
+	};
+	DMA_Descriptor bad[1] = { { Host_DMA_Memory + 16, 0 } };
+	DMA_Chain chain, other;
+	unsigned int i;
+	
+	// One-shot chain on a freshly configured channel
+	dma_chain_start(&chain, DMA_CHANNEL_2, descriptors, 3, false, true, chain_done, &laps);
+	CHECK(idle_locks == 1);
+	CHECK(dma_chain_is_busy(&chain));
+	for (i = 0; i < 3; i++)
+	{
+		// Only the first segment is forced, the peripheral requests the others
+		CHECK(!(DMA_CHANNEL_REGISTERS(DMA_CHANNEL_2)->req & DMA_REQ_FORCE) == (i != 0));
+		run_segment(DMA_CHANNEL_2);
+	}
+	CHECK(!dma_chain_is_busy(&chain));
+	CHECK(laps == 1);
+	CHECK(idle_locks == 0);
+	CHECK(transferred_count == 3);
+	for (i = 0; i < 3; i++)
+	{
+		CHECK(transferred[i].sta == (unsigned int)((unsigned char*)descriptors[i].buffer - Host_DMA_Memory));
+		CHECK(transferred[i].cnt == descriptors[i].count - 1);
+	}
+	
+	// Stopping a done chain, or twice, does not touch the lock
+	dma_chain_stop(&chain);
+	CHECK(idle_locks == 0);
+	
+	// Circular chain, done at each lap, until stopped
+	laps = 0;
+	transferred_count = 0;
+	dma_chain_start(&chain, DMA_CHANNEL_2, descriptors, 2, true, false, chain_done, &laps);
+	for (i = 0; i < 5; i++)
+	{
+		CHECK(!(DMA_CHANNEL_REGISTERS(DMA_CHANNEL_2)->req & DMA_REQ_FORCE));
+		run_segment(DMA_CHANNEL_2);
+	}
+	CHECK(laps == 2);
+	CHECK(transferred[4].sta == transferred[0].sta);
+	CHECK(dma_chain_is_busy(&chain));
+	CHECK(idle_locks == 1);
+	dma_chain_stop(&chain);
+	dma_chain_stop(&chain);
+	CHECK(!dma_chain_is_busy(&chain));
+	CHECK(idle_locks == 0);
+	
+	// Starting a chain over a busy one stops it
+	dma_chain_start(&chain, DMA_CHANNEL_2, descriptors, 3, false, true, 0, 0);
+	run_segment(DMA_CHANNEL_2);
+	dma_chain_start(&other, DMA_CHANNEL_2, descriptors, 1, false, true, 0, 0);
+	CHECK(!dma_chain_is_busy(&chain));
+	CHECK(idle_locks == 1);
+	run_segment(DMA_CHANNEL_2);
+	CHECK(!dma_chain_is_busy(&other));
+	CHECK(idle_locks == 0);
+	
+	// Invalid descriptors
+	CHECK_ERROR(dma_chain_start(&chain, DMA_CHANNEL_2, bad, 1, false, true, 0, 0), DMA_ERROR_INVALID_DESCRIPTOR);
+	bad[0].count = 1;
+	bad[0].buffer = &laps;
+	CHECK_ERROR(dma_chain_start(&chain, DMA_CHANNEL_2, bad, 1, false, true, 0, 0), DMA_ERROR_INVALID_ADDRESS);
+	CHECK(idle_locks == 0);
+	
+	return 0;
+}
@@ -0,0 +1,37 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host model of the DMA channel registers, included before the DMA sources so that
+// DMA_CHANNEL_REGISTERS accesses plain memory instead of the SFRs.
+
+#ifndef _MOLOLE_TESTS_HOST_DMA_REGISTERS_H
+#define _MOLOLE_TESTS_HOST_DMA_REGISTERS_H
+
+/** DMAxCON, DMAxREQ, DMAxSTA, DMAxSTB, DMAxPAD and DMAxCNT of the 8 channels */
+extern unsigned int Host_DMA_Registers[8][6];
+
+#define DMA_CHANNEL_REGISTERS(channel) ((DMA_Channel_Registers*)Host_DMA_Registers[channel])
+
+#endif
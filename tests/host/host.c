@@ -0,0 +1,48 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Support of the host tests: register model storage and error reporting
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+
+struct Host_SR_Bits SRbits;
+volatile unsigned int SPLIM;
+unsigned char Host_DMA_Memory[2048];
+
+jmp_buf* Host_Error_Handler;
+int Host_Last_Error;
+
+/** Molole error handler: jump to the test expecting an error, or abort */
+void error_report(const char * file, int line, int id, void* arg)
+{
+	Host_Last_Error = id;
+	if (Host_Error_Handler)
+		longjmp(*Host_Error_Handler, 1);
+	fprintf(stderr, "%s:%d: unexpected molole error 0x%04x\n", file, line, id);
+	abort();
+}
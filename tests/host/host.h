@@ -0,0 +1,66 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Support of the host tests
+
+#ifndef _MOLOLE_TESTS_HOST_H
+#define _MOLOLE_TESTS_HOST_H
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../types/types.h"
+#include "../../error/error.h"
+
+/** Where error_report() jumps to, 0 to abort on errors */
+extern jmp_buf* Host_Error_Handler;
+
+/** Identifier of the last error reported */
+extern int Host_Last_Error;
+
+/** Check a condition, abort the test with a message if false */
+#define CHECK(condition) do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit(1); \
+		} \
+	} while (0)
+
+/** Run statement, and check that it reports the error id */
+#define CHECK_ERROR(statement, id) do { \
+		jmp_buf _handler; \
+		Host_Last_Error = -1; \
+		if (setjmp(_handler) == 0) { \
+			Host_Error_Handler = &_handler; \
+			statement; \
+			Host_Error_Handler = 0; \
+			CHECK(!"no error reported by " #statement); \
+		} \
+		Host_Error_Handler = 0; \
+		CHECK(Host_Last_Error == (id)); \
+	} while (0)
+
+#endif
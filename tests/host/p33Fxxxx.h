@@ -0,0 +1,48 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host register model, just enough to build the hardware-independent parts of molole with the host compiler.
+// The tests include this file instead of the Microchip device header, see tests/Makefile.
+
+#ifndef _MOLOLE_TESTS_HOST_P33FXXXX_H
+#define _MOLOLE_TESTS_HOST_P33FXXXX_H
+
+/** Status register, only the IPL is modelled */
+extern struct Host_SR_Bits { unsigned int IPL; } SRbits;
+
+/** Stack limit, used by get_stack_space() */
+extern volatile unsigned int SPLIM;
+
+/** DMA memory; its first byte stands for _DMA_BASE */
+extern unsigned char Host_DMA_Memory[2048];
+#define _DMA_BASE Host_DMA_Memory[0]
+
+/** Atomic operations of types.h, the tests are single-threaded */
+#define atomic_and(x,y) do { *(x) &= (y); } while (0)
+#define atomic_or(x,y) do { *(x) |= (y); } while (0)
+#define atomic_add(x,y) do { *(x) += (y); } while (0)
+#define atomic_add_and_test(x,y) ({ *(x) += (y); *(x) != 0; })
+
+#endif
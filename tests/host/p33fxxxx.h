@@ -0,0 +1,2 @@
+// Some sources include the device header in lower case
+#include "p33Fxxxx.h"
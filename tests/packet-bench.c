@@ -0,0 +1,94 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host throughput benchmark of the packet link: encoding and decoding speed
+// of frames of random data, in bytes of payload per second.
+
+#include <string.h>
+#include <time.h>
+
+#include "host/host.h"
+#include "../packet/packet.h"
+#include "../uart/uart.h"
+
+#define LENGTH		256
+#define FRAMES		200000UL
+
+static unsigned char wire[LENGTH + 8];
+static unsigned int wire_length;
+static unsigned long received_count;
+
+bool uart_transmit_byte(int uart_id, unsigned char data)
+{
+	wire[wire_length++] = data;
+	return true;
+}
+
+static bool packet_received_callback(Packet_Link* link, unsigned char* data, unsigned int length, void* user_data)
+{
+	received_count++;
+	return true;
+}
+
+int main(void)
+{
+	static unsigned char buffers[LENGTH + 2];
+	unsigned char data[LENGTH];
+	Packet_Segment segment = { data, LENGTH };
+	Packet_Link tx, rx;
+	unsigned char byte;
+	unsigned long frame;
+	unsigned int i;
+	clock_t start;
+	double encode, decode;
+	
+	for (i = 0; i < LENGTH; i++)
+		data[i] = rand();
+	
+	packet_init(&tx, UART_1, 0, 3, 1, 0, 0);
+	packet_init(&rx, UART_1, buffers, sizeof(buffers), 1, packet_received_callback, 0);
+	
+	// The data do not change, so the frame encoded last is decoded in the second loop
+	start = clock();
+	for (frame = 0; frame < FRAMES; frame++)
+	{
+		wire_length = 0;
+		packet_send(&tx, &segment, 1);
+		while (packet_uart_tx_ready(UART_1, &byte, &tx))
+			wire[wire_length++] = byte;
+	}
+	encode = clock() - start;
+	
+	start = clock();
+	for (frame = 0; frame < FRAMES; frame++)
+		packet_receive_bytes(&rx, wire, wire_length);
+	decode = clock() - start;
+	CHECK(received_count == FRAMES);
+	
+	printf("packet encode: %.1f MB/s\n", (double)LENGTH * FRAMES / (encode / CLOCKS_PER_SEC) / 1e6);
+	printf("packet decode: %.1f MB/s\n", (double)LENGTH * FRAMES / (decode / CLOCKS_PER_SEC) / 1e6);
+	
+	return 0;
+}
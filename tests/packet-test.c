@@ -0,0 +1,205 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host loopback test of the packet link: frames of all lengths from 0 to the
+// reception buffer size, with several data patterns and split in segments,
+// are encoded by the transmitter and decoded by the receiver unchanged.
+
+#include <string.h>
+
+#include "host/host.h"
+#include "../packet/packet.h"
+#include "../uart/uart.h"
+
+#define MAX_LENGTH	559
+#define BUFFER_SIZE	(MAX_LENGTH + 2)
+#define PATTERNS	4
+#define WIRE_SIZE	(MAX_LENGTH + 16)
+
+/** Bytes sent on the wire by the transmitter */
+static unsigned char wire[WIRE_SIZE];
+static unsigned int wire_length;
+
+/** If true, the UART refuses the first byte of the next frame */
+static bool uart_full;
+
+/** Last frame received */
+static unsigned char received[BUFFER_SIZE];
+static unsigned int received_length;
+static unsigned int received_count;
+static bool keep_buffers;
+
+// UART driver, the transmitter gives its first byte here
+
+bool uart_transmit_byte(int uart_id, unsigned char data)
+{
+	if (uart_full)
+	{
+		uart_full = false;
+		return false;
+	}
+	CHECK(wire_length < WIRE_SIZE);
+	wire[wire_length++] = data;
+	return true;
+}
+
+static bool packet_received_callback(Packet_Link* link, unsigned char* data, unsigned int length, void* user_data)
+{
+	CHECK(length <= MAX_LENGTH);
+	memcpy(received, data, length);
+	received_length = length;
+	received_count++;
+	return !keep_buffers;
+}
+
+/** Send a packet made of three segments, and collect the frame as the UART interrupt would */
+static void send(Packet_Link* link, const unsigned char* data, unsigned int length)
+{
+	Packet_Segment segments[3] = {
+		{ data, length / 3 },
+		{ data + length / 3, length / 2 - length / 3 },
+		{ data + length / 2, length - length / 2 },
+	};
+	unsigned char byte;
+	
+	wire_length = 0;
+	CHECK(packet_send(link, segments, 3));
+	CHECK(packet_is_sending(link));
+	while (packet_uart_tx_ready(UART_1, &byte, link))
+	{
+		CHECK(wire_length < WIRE_SIZE);
+		wire[wire_length++] = byte;
+	}
+	CHECK(!packet_is_sending(link));
+}
+
+/** Fill data with one of the test patterns */
+static void fill(unsigned char* data, unsigned int length, unsigned int pattern)
+{
+	unsigned int i;
+	
+	for (i = 0; i < length; i++)
+	{
+		switch (pattern)
+		{
+			case 0: data[i] = 0; break;
+			case 1: data[i] = 0xFF; break;
+			case 2: data[i] = i + 1; break;
+			default: data[i] = rand(); break;
+		}
+	}
+}
+
+int main(void)
+{
+	static unsigned char buffers[2 * BUFFER_SIZE];
+	unsigned char data[MAX_LENGTH + 1];
+	Packet_Link tx, rx;
+	Packet_Statistics statistics;
+	unsigned int length, pattern, i, chunk;
+	unsigned long frames = 0;
+	
+	packet_init(&tx, UART_1, 0, 3, 1, 0, 0);
+	packet_init(&rx, UART_1, buffers, BUFFER_SIZE, 2, packet_received_callback, 0);
+	
+	for (length = 0; length <= MAX_LENGTH; length++)
+	{
+		for (pattern = 0; pattern < PATTERNS; pattern++)
+		{
+			fill(data, length, pattern);
+			uart_full = length % 7 == 0;
+			send(&tx, data, length);
+			
+			// COBS: a single delimiter at the end, and at most 3 bytes plus 1 every 254 bytes of overhead
+			CHECK(wire[wire_length - 1] == 0);
+			CHECK(memchr(wire, 0, wire_length - 1) == 0);
+			CHECK(wire_length <= length + 4 + (length + 2) / 254);
+			
+			// Alternate byte by byte reception and blocks of various sizes
+			if (pattern & 1)
+			{
+				for (i = 0; i < wire_length; i++)
+					packet_uart_byte_received(UART_1, wire[i], &rx);
+			}
+			else
+			{
+				for (i = 0; i < wire_length; i += chunk)
+				{
+					chunk = 1 + (length + i) % 64;
+					if (chunk > wire_length - i)
+						chunk = wire_length - i;
+					packet_receive_bytes(&rx, wire + i, chunk);
+				}
+			}
+			frames++;
+			CHECK(received_count == frames);
+			CHECK(received_length == length);
+			CHECK(memcmp(received, data, length) == 0);
+		}
+	}
+	
+	packet_get_statistics(&tx, &statistics);
+	CHECK(statistics.frames_sent == frames);
+	packet_get_statistics(&rx, &statistics);
+	CHECK(statistics.frames_received == frames);
+	CHECK(statistics.crc_errors == 0);
+	CHECK(statistics.overruns == 0);
+	
+	// A corrupted byte is detected by the CRC, and the next frame is received
+	fill(data, 100, 3);
+	send(&tx, data, 100);
+	wire[50] = wire[50] == 0x55 ? 0xAA : 0x55;
+	packet_receive_bytes(&rx, wire, wire_length);
+	send(&tx, data, 100);
+	packet_receive_bytes(&rx, wire, wire_length);
+	packet_get_statistics(&rx, &statistics);
+	CHECK(statistics.crc_errors == 1);
+	CHECK(received_count == frames + 1);
+	
+	// A frame longer than the buffers is dropped
+	fill(data, MAX_LENGTH + 1, 2);
+	send(&tx, data, MAX_LENGTH + 1);
+	packet_receive_bytes(&rx, wire, wire_length);
+	packet_get_statistics(&rx, &statistics);
+	CHECK(statistics.overruns == 1);
+	CHECK(received_count == frames + 1);
+	
+	// Buffers kept by the user are not reused until released
+	keep_buffers = true;
+	fill(data, 10, 3);
+	send(&tx, data, 10);
+	for (i = 0; i < 3; i++)
+		packet_receive_bytes(&rx, wire, wire_length);
+	packet_get_statistics(&rx, &statistics);
+	CHECK(received_count == frames + 3);
+	CHECK(statistics.overruns == 2);
+	keep_buffers = false;
+	packet_release(&rx, buffers);
+	CHECK_ERROR(packet_release(&rx, buffers), PACKET_ERROR_NOT_HELD);
+	packet_receive_bytes(&rx, wire, wire_length);
+	CHECK(received_count == frames + 4);
+	
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host benchmark of the serial-io number output: serial_io_printf() against
+// serial_io_send_unsigned(), serial_io_send_int() and serial_io_send_hex(),
+// for the same values and the same output, in nanoseconds per call.
+
+#include <time.h>
+
+#include "host/host.h"
+#include "../serial-io/serial-io.h"
+#include "../clock/clock.h"
+
+#define VALUES		1024
+#define ROUNDS		2000
+
+static Serial_IO_State state;
+static char reception_buffer[64];
+static char transmission_buffer[64];
+static unsigned long sent;
+
+/** Transmission callback of serial-io, not in its header */
+bool serial_io_byte_transmitted(int uart_id, unsigned char* data, void* user_data);
+
+// UART driver: the hardware FIFO is always full, so every character goes through the transmission buffer
+
+void uart_init(int uart_id, unsigned long baud_rate, bool hardware_flow_control, uart_byte_received byte_received_callback, uart_tx_ready tx_ready_callback, int priority, void* user_data)
+{
+}
+
+void uart_read_pending_data(int uart_id)
+{
+}
+
+bool uart_transmit_byte(int uart_id, unsigned char data)
+{
+	return false;
+}
+
+int uart_disable_tx_interrupt(int uart_id)
+{
+	return 0;
+}
+
+void uart_enable_tx_interrupt(int uart_id, int flags)
+{
+}
+
+/** Empty the transmission buffer, as the transmission interrupt would */
+static void drain(void)
+{
+	unsigned char data;
+	
+	while (serial_io_byte_transmitted(state.uart_id, &data, &state))
+		sent += data;
+}
+
+void clock_idle(void)
+{
+	drain();
+}
+
+/** Time ROUNDS passes over the values, return nanoseconds per call */
+#define MEASURE(call) ({ \
+		clock_t _start = clock(); \
+		unsigned _round, _i; \
+		for (_round = 0; _round < ROUNDS; _round++) \
+			for (_i = 0; _i < VALUES; _i++) { \
+				call; \
+				drain(); \
+			} \
+		(double)(clock() - _start) / CLOCKS_PER_SEC * 1e9 / ((double)ROUNDS * VALUES); \
+	})
+
+int main(void)
+{
+	static unsigned values[VALUES];
+	unsigned i;
+	
+	for (i = 0; i < VALUES; i++)
+		values[i] = rand() & 0xFFFF;
+	
+	serial_io_init_buffers(&state, UART_1, 115200, false, 5, reception_buffer, sizeof(reception_buffer), transmission_buffer, sizeof(transmission_buffer));
+	
+	printf("%-40s %6.1f ns\n", "serial_io_send_unsigned(FILL)", MEASURE(serial_io_send_unsigned(&state, values[_i], SERIAL_IO_ALIGN_FILL)));
+	printf("%-40s %6.1f ns\n", "serial_io_printf(\"%05u\")", MEASURE(serial_io_printf(&state, "%05u", values[_i])));
+	printf("%-40s %6.1f ns\n", "serial_io_send_int(COMPACT)", MEASURE(serial_io_send_int(&state, (int)values[_i] - 32768, SERIAL_IO_ALIGN_COMPACT)));
+	printf("%-40s %6.1f ns\n", "serial_io_printf(\"%d\")", MEASURE(serial_io_printf(&state, "%d", (int)values[_i] - 32768)));
+	printf("%-40s %6.1f ns\n", "serial_io_send_hex(FILL)", MEASURE(serial_io_send_hex(&state, values[_i], SERIAL_IO_ALIGN_FILL)));
+	printf("%-40s %6.1f ns\n", "serial_io_printf(\"%04X\")", MEASURE(serial_io_printf(&state, "%04X", values[_i])));
+	
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host test of the software timer wheel: timers with random delays and periods,
+// driven by soft_timer_tick(), must fire exactly at their expected ticks.
+
+#include "host/host.h"
+#include "../soft-timer/soft-timer.h"
+#include "../timer/timer.h"
+
+#define TIMERS		200
+#define TICKS		300000UL
+
+/** Expected state of a timer */
+typedef struct
+{
+	Soft_Timer timer;
+	unsigned long next;		/**< tick at which the timer must fire, 0 if not pending */
+	unsigned long fired;
+} Test_Timer;
+
+static Test_Timer timers[TIMERS];
+static unsigned long now;	/**< number of ticks processed, including the one being processed */
+
+// The hardware timer is not used on the host
+
+void timer_init(int id, unsigned long int sample_time, int unit) {}
+void timer_enable_interrupt(int id, timer_callback callback, int priority) {}
+void timer_enable(int id) {}
+
+static unsigned long random_delay(void)
+{
+	switch (rand() % 4)
+	{
+		case 0: return rand() % 32;
+		case 1: return rand() % 1024;
+		case 2: return rand() % 32768;
+		default: return rand() % 100000;
+	}
+}
+
+static void fired(Soft_Timer* timer, void* user_data);
+
+/** Start a timer with random parameters, now ticks having been processed */
+static void start(Test_Timer* t)
+{
+	unsigned long delay = random_delay();
+	unsigned long period = rand() % 3 ? 0 : 1 + random_delay();
+	
+	soft_timer_add(&t->timer, delay, period, fired, t);
+	t->next = now + (delay ? delay : 1);
+}
+
+static void fired(Soft_Timer* timer, void* user_data)
+{
+	Test_Timer* t = (Test_Timer*)user_data;
+	Test_Timer* other;
+	
+	CHECK(t->next == now);
+	t->fired++;
+	t->next = timer->period ? now + timer->period : 0;
+	CHECK(soft_timer_is_pending(timer) == (timer->period != 0));
+	
+	// Exercise changes of the wheel from the callbacks
+	other = &timers[rand() % TIMERS];
+	switch (rand() % 8)
+	{
+		case 0:
+			soft_timer_cancel(&other->timer);
+			other->next = 0;
+			break;
+		case 1:
+			start(other);
+			break;
+		default:
+			break;
+	}
+}
+
+int main(void)
+{
+	unsigned long total = 0;
+	int i;
+	
+	srand(1);
+	soft_timer_init(TIMER_1, 1, 3, 1);
+	
+	now = 0;
+	for (i = 0; i < TIMERS; i++)
+		start(&timers[i]);
+	
+	for (now = 1; now <= TICKS; now++)
+	{
+		soft_timer_tick();
+		CHECK(soft_timer_get_ticks() == now);
+		
+		// No timer may have been missed
+		for (i = 0; i < TIMERS; i++)
+		{
+			CHECK(!timers[i].next || timers[i].next > now);
+			CHECK(soft_timer_is_pending(&timers[i].timer) == (timers[i].next != 0));
+		}
+		
+		// Restart some of the expired one-shot timers
+		if (rand() % 16 == 0)
+		{
+			i = rand() % TIMERS;
+			if (!timers[i].next)
+				start(&timers[i]);
+		}
+	}
+	
+	for (i = 0; i < TIMERS; i++)
+		total += timers[i].fired;
+	CHECK(total > 1000);
+	
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Host test of the UART baud rate generator table: for common cycle frequencies and
+// baud rates, uart_compute_brg() must return the setting with the smallest error
+// among all the dividers of both speed modes, preferring the low speed mode on ties;
+// uart_relative_error() must match a 64-bit reference computation.
+
+#include <limits.h>
+
+#include "host/host.h"
+#include "../uart/uart_priv.h"
+
+/** Cycle frequencies, in Hz */
+static const unsigned long clocks[] = { 1843200, 3686400, 7370000, 16000000, 29491200, 40000000, 70000000 };
+
+/** Baud rates, only those up to the cycle frequency divided by 4 are tested */
+static const unsigned long baud_rates[] = {
+	50, 300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200,
+	230400, 250000, 460800, 500000, 921600, 1000000, 2000000, 3000000, 10000000
+};
+
+/** Expected settings at Fcy = 40 MHz */
+static const struct { unsigned long baud_rate; unsigned int brg; bool high_speed; } table[] = {
+	{ 9600, 1041, true },
+	{ 115200, 86, true },
+	{ 1000000, 9, true },
+	{ 2500000, 0, false },
+	{ 300, 33332, true },
+};
+
+/** Distance between the baud rate obtained with a divider and the requested one, scaled by the divider */
+static unsigned long error(unsigned long fcy, unsigned long baud_rate, unsigned long clocks_per_bit, unsigned long divider)
+{
+	unsigned long product = clocks_per_bit * divider * baud_rate;
+	return product > fcy ? product - fcy : fcy - product;
+}
+
+int main(void)
+{
+	unsigned int i, j;
+	unsigned long fcy, baud_rate, divider, best, found;
+	unsigned int brg;
+	bool high_speed;
+	unsigned int tested = 0;
+	long long expected;
+	
+	for (i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++)
+	{
+		for (j = 0; j < sizeof(baud_rates) / sizeof(baud_rates[0]); j++)
+		{
+			fcy = clocks[i];
+			baud_rate = baud_rates[j];
+			if (baud_rate > fcy / 4)
+				continue;
+			
+			brg = uart_compute_brg(fcy, baud_rate, &high_speed);
+			CHECK(brg <= 65535);
+			found = error(fcy, baud_rate, high_speed ? 4 : 16, brg + 1UL);
+			
+			// The chosen divider is the best of its mode, and strictly better than low speed if high speed is used
+			best = ~0UL;
+			for (divider = 1; divider <= 65536; divider++)
+				if (error(fcy, baud_rate, 16, divider) < best)
+					best = error(fcy, baud_rate, 16, divider);
+			CHECK(high_speed ? found < best : found == best);
+			for (divider = 1; divider <= 65536; divider++)
+				CHECK(error(fcy, baud_rate, 4, divider) >= found);
+			
+			tested++;
+		}
+	}
+	CHECK(tested > 100);
+	
+	for (i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+	{
+		brg = uart_compute_brg(40000000, table[i].baud_rate, &high_speed);
+		CHECK(brg == table[i].brg);
+		CHECK(high_speed == table[i].high_speed);
+	}
+	
+	// Relative errors, in hundredths of percent, saturated to the int range
+	CHECK(uart_relative_error(115200, 115200) == 0);
+	CHECK(uart_relative_error(114942, 115200) == -22);
+	CHECK(uart_relative_error(9615, 9600) == 15);
+	CHECK(uart_relative_error(19200, 9600) == 10000);
+	CHECK(uart_relative_error(0, 9600) == -10000);
+	CHECK(uart_relative_error(17500000, 17500001) == 0);
+	CHECK(uart_relative_error(17500000, 9000000) == 9444);
+	CHECK(uart_relative_error(115200, 9600) == (INT_MAX < 110000 ? INT_MAX : 110000));
+	CHECK(uart_relative_error(17500000, 50) > 0);
+	for (baud_rate = 1; baud_rate < 20000000; baud_rate = baud_rate * 3 + 7)
+	{
+		for (divider = 1; divider < 20000000; divider = divider * 5 + 3)
+		{
+			expected = ((long long)baud_rate - (long long)divider) * 10000 / (long long)divider;
+			expected = expected > INT_MAX ? INT_MAX : expected < INT_MIN ? INT_MIN : expected;
+			CHECK(uart_relative_error(baud_rate, divider) == expected);
+		}
+	}
+	
+	return 0;
+}
@@ -109,8 +109,6 @@ The following problems occurs when using the MPLAB SIM simulator (the library is
 // Structures definitions
 //-----------------------
 
-// TODO: we could probably optimize this by looking directly into the registers and removing redundant fields.
-
 /** The structs for timer implementation data */
 static struct
 {
@@ -146,6 +144,85 @@ bool timer_id_to_32bits(int id)
 	return id > TIMER_9;
 }
 
+/** Registers and bit masks of one 16-bits timer */
+typedef struct
+{
+	volatile unsigned int* con;		/**< TxCON configuration register, 0 if the timer does not exist */
+	volatile unsigned int* tmr;		/**< TMRx counter register */
+	volatile unsigned int* pr;		/**< PRx period register */
+	volatile unsigned int* tmr_hld;	/**< TMRxHLD holding register of the most significant word in 32-bits mode, 0 for the least significant timer of a pair */
+	volatile unsigned int* ifs;		/**< IFSx register holding the interrupt flag */
+	volatile unsigned int* iec;		/**< IECx register holding the interrupt enable bit */
+	volatile unsigned int* ipc;		/**< IPCx register holding the interrupt priority */
+	unsigned int if_mask;			/**< mask of the interrupt flag in ifs, also of the interrupt enable bit in iec */
+	unsigned int ip_shift;			/**< position of the interrupt priority field in ipc */
+} Timer_Registers;
+
+/** Registers of the timers, indexed like Timer_Data; the bit positions are from the dsPIC33F family reference manual */
+static const Timer_Registers Timer_Registers_Table[9] =
+{
+	{ &T1CON, &TMR1, &PR1, 0,        &IFS0, &IEC0, &IPC0,  1 << 3,  12 },
+	{ &T2CON, &TMR2, &PR2, 0,        &IFS0, &IEC0, &IPC1,  1 << 7,  12 },
+	{ &T3CON, &TMR3, &PR3, &TMR3HLD, &IFS0, &IEC0, &IPC2,  1 << 8,  0 },
+	{ &T4CON, &TMR4, &PR4, 0,        &IFS1, &IEC1, &IPC6,  1 << 11, 12 },
+	{ &T5CON, &TMR5, &PR5, &TMR5HLD, &IFS1, &IEC1, &IPC7,  1 << 12, 0 },
+#ifdef _T6IF
+	{ &T6CON, &TMR6, &PR6, 0,        &IFS2, &IEC2, &IPC11, 1 << 15, 12 },
+#else
+	{ 0 },
+#endif
+#ifdef _T7IF
+	{ &T7CON, &TMR7, &PR7, &TMR7HLD, &IFS3, &IEC3, &IPC12, 1 << 0,  0 },
+#else
+	{ 0 },
+#endif
+#ifdef _T8IF
+	{ &T8CON, &TMR8, &PR8, 0,        &IFS3, &IEC3, &IPC12, 1 << 3,  12 },
+#else
+	{ 0 },
+#endif
+#ifdef _T9IF
+	{ &T9CON, &TMR9, &PR9, &TMR9HLD, &IFS3, &IEC3, &IPC13, 1 << 4,  0 },
+#else
+	{ 0 },
+#endif
+};
+
+/** TxCON: timer on */
+#define TIMER_CON_TON						(1 << 15)
+/** TxCON: stop in idle mode */
+#define TIMER_CON_TSIDL						(1 << 13)
+/** TxCON: gated time accumulation */
+#define TIMER_CON_TGATE						(1 << 6)
+/** TxCON: position of the prescaler field */
+#define TIMER_CON_TCKPS_SHIFT				4
+/** TxCON: prescaler field */
+#define TIMER_CON_TCKPS						(3 << TIMER_CON_TCKPS_SHIFT)
+/** TxCON: 32-bits mode, only on the least significant timer of a pair */
+#define TIMER_CON_T32						(1 << 3)
+/** TxCON: external clock source */
+#define TIMER_CON_TCS						(1 << 1)
+
+/** Return the registers of the timer holding the configuration of a specific id, or throw an error if the timer does not exist */
+static const Timer_Registers* timer_id_to_registers(int id)
+{
+	const Timer_Registers* regs;
+	
+	ERROR_CHECK_RANGE(id, TIMER_1, TIMER_89, TIMER_ERROR_INVALID_TIMER_ID);
+	
+	regs = &Timer_Registers_Table[timer_id_to_index(id)];
+	if (!regs->con)
+		ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
+	
+	return regs;
+}
+
+/** Return the registers of the timer holding the interrupt of a specific id; for 32-bits timers, it is the most significant one */
+static const Timer_Registers* timer_id_to_irq_registers(int id)
+{
+	return timer_id_to_registers(id) + timer_id_to_32bits(id);
+}
+
 
 //-------------------------------
 // Internal functions, prototypes
@@ -410,48 +487,16 @@ void timer_disable(int id)
 */
 void timer_set_enabled(int id, bool enabled)
 {
-	// test the validity of the timer identifier
-	ERROR_CHECK_RANGE(id, TIMER_1, TIMER_89, TIMER_ERROR_INVALID_TIMER_ID);
+	const Timer_Registers* regs = timer_id_to_registers(id);
 	
 	// is the timer initialized ?
 	if (!Timer_Data[timer_id_to_index(id)].is_initialized)
 		ERROR(TIMER_ERROR_NOT_INITIALIZED, &id)
 	
-	switch (id)
-	{
-		case TIMER_1:	T1CONbits.TON = enabled;
-			break;
-		case TIMER_2:
-		case TIMER_23:	T2CONbits.TON = enabled;
-			break;
-		case TIMER_3:	T3CONbits.TON = enabled;
-			break;
-		case TIMER_4:
-		case TIMER_45:	T4CONbits.TON = enabled;
-			break;
-		case TIMER_5:	T5CONbits.TON = enabled;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-		case TIMER_67:	T6CONbits.TON = enabled;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_7:	T7CONbits.TON = enabled;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-		case TIMER_89:	T8CONbits.TON = enabled;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_9:	T9CONbits.TON = enabled;
-			break;
-#endif
-		default:
-			ERROR( TIMER_ERROR_INVALID_TIMER_ID, &id)
-	}
+	if (enabled)
+		atomic_or(regs->con, TIMER_CON_TON);
+	else
+		atomic_and(regs->con, ~TIMER_CON_TON);
 }
 
 
@@ -465,34 +510,16 @@ void timer_set_enabled(int id, bool enabled)
 */
 void timer_set_value(int id, unsigned long value)
 {
-	switch (id)
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	
+	if (timer_id_to_32bits(id))
 	{
-		case TIMER_1: TMR1 = value; break;
-		case TIMER_2: TMR2 = value; break;
-		case TIMER_23: TMR3HLD = value >> 16; TMR2 = value & 0xffff; break;
-		case TIMER_3: TMR3 = value; break;
-		case TIMER_4: TMR4 = value; break;
-		case TIMER_45: TMR5HLD = value >> 16; TMR4 = value & 0xffff; break;
-		case TIMER_5: TMR5 = value; break;
-#ifdef _T6IF
-		case TIMER_6: TMR6 = value; break;
-		case TIMER_67: TMR7HLD = value >> 16; TMR6 = value & 0xffff; break;
-#endif
-#ifdef _T7IF
-		case TIMER_7: TMR7 = value; break;
-#endif
-#ifdef _T8IF
-		case TIMER_8: TMR8 = value; break;
-		case TIMER_89: TMR9HLD = value >> 16; TMR8 = value & 0xffff; break;
-#endif
-#ifdef _T9IF
-		case TIMER_9: TMR9 = value; break;
-#endif
-		
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
+		// the most significant word is transfered when writing the least significant one
+		*regs[1].tmr_hld = value >> 16;
+		*regs->tmr = value & 0xffff;
 	}
+	else
+		*regs->tmr = value;
 }
 
 /**
@@ -505,35 +532,15 @@ void timer_set_value(int id, unsigned long value)
 */
 unsigned long timer_get_value(int id)
 {
-	switch (id)
-	{
-		case TIMER_1: return TMR1;
-		case TIMER_2: return TMR2;
-		case TIMER_23: return (unsigned long)TMR2 | ((unsigned long)TMR3HLD << 16);
-		case TIMER_3: return TMR3;
-		case TIMER_4: return TMR4;
-		case TIMER_45: return (unsigned long)TMR4 | ((unsigned long)TMR5HLD << 16);
-		case TIMER_5: return TMR5;
-#ifdef _T6IF
-		case TIMER_6: return TMR6;
-		case TIMER_67: return (unsigned long)TMR6 | ((unsigned long)TMR7HLD << 16);
-#endif
-#ifdef _T7IF
-		case TIMER_7: return TMR7;
-#endif
-#ifdef _T8IF
-		case TIMER_8: return TMR8;
-		case TIMER_89: return (unsigned long)TMR8 | ((unsigned long)TMR9HLD << 16);
-#endif
-#ifdef _T9IF
-		case TIMER_9: return TMR9;
-#endif
-		
-		default:
-			ERROR_RET_0(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
-	return 0;
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	unsigned long value;
+	
+	// reading the least significant word latches the most significant one
+	value = *regs->tmr;
+	if (timer_id_to_32bits(id))
+		value |= (unsigned long)*regs[1].tmr_hld << 16;
+	
+	return value;
 }
 
 /**
@@ -550,65 +557,21 @@ unsigned long timer_get_value(int id)
 */
 void timer_set_clock_source(int id, int clock_source)
 {
+	const Timer_Registers* regs;
+	
 	ERROR_CHECK_RANGE(clock_source, 0, 1, TIMER_ERROR_INVALID_CLOCK_SOURCE);
 	
-	switch (id)
-	{
-		case TIMER_1:	T1CONbits.TCS = clock_source;
-						T1CONbits.TSIDL = 0;
-			break;
-		case TIMER_23:
-						T3CONbits.TSIDL = 0;
-		case TIMER_2:
-						T2CONbits.TCS = clock_source;
-						T2CONbits.TSIDL = 0;
-			break;
-		case TIMER_3:	
-						T3CONbits.TCS = clock_source;
-						T3CONbits.TSIDL = 0;
-			break;
-		case TIMER_45:
-						T5CONbits.TSIDL = 0;
-		case TIMER_4:
-						T4CONbits.TCS = clock_source;
-						T4CONbits.TSIDL = 0;
-			break;
-		case TIMER_5:	
-						T5CONbits.TCS = clock_source;
-						T5CONbits.TSIDL = 0;
-			break;
-#ifdef _T6IF
-		case TIMER_67:
-						T7CONbits.TSIDL = 0;
-		case TIMER_6:
-						T6CONbits.TCS = clock_source;
-						T6CONbits.TSIDL = 0;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_7:	
-						T7CONbits.TCS = clock_source;
-						T7CONbits.TSIDL = 0;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_89:
-						T9CONbits.TSIDL = 0;
-		case TIMER_8:
-						T8CONbits.TCS = clock_source;
-						T8CONbits.TSIDL = 0;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_9:	
-						T9CONbits.TCS = clock_source;
-						T9CONbits.TSIDL = 0;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	regs = timer_id_to_registers(id);
+	
+	if (clock_source == TIMER_CLOCK_EXTERNAL)
+		atomic_or(regs->con, TIMER_CON_TCS);
+	else
+		atomic_and(regs->con, ~TIMER_CON_TCS);
+	
+	// Continue operation in idle mode
+	atomic_and(regs->con, ~TIMER_CON_TSIDL);
+	if (timer_id_to_32bits(id))
+		atomic_and(regs[1].con, ~TIMER_CON_TSIDL);
 }
 
 
@@ -624,42 +587,12 @@ void timer_set_clock_source(int id, int clock_source)
 */
 void timer_use_gated_time_accumulation(int id, bool enable)
 {
-	switch (id)
-	{
-		case TIMER_1:	T1CONbits.TGATE = enable;
-			break;
-		case TIMER_2:
-		case TIMER_23:	T2CONbits.TGATE = enable;
-			break;
-		case TIMER_3:	T3CONbits.TGATE = enable;
-			break;
-		case TIMER_4:
-		case TIMER_45:	T4CONbits.TGATE = enable;
-			break;
-		case TIMER_5:	T5CONbits.TGATE = enable;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-		case TIMER_67:	T6CONbits.TGATE = enable;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_7:	T7CONbits.TGATE = enable;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-		case TIMER_89:	T8CONbits.TGATE = enable;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_9:	T9CONbits.TGATE = enable;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	
+	if (enable)
+		atomic_or(regs->con, TIMER_CON_TGATE);
+	else
+		atomic_and(regs->con, ~TIMER_CON_TGATE);
 }
 
 
@@ -676,79 +609,22 @@ void timer_use_gated_time_accumulation(int id, bool enable)
 */
 void timer_enable_interrupt(int id, timer_callback callback, int priority)
 {
+	const Timer_Registers* regs;
+	
 	// test the validity of the timer identifier
 	ERROR_CHECK_RANGE(id, TIMER_1, TIMER_89, TIMER_ERROR_INVALID_TIMER_ID);
 	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
 	
+	regs = timer_id_to_irq_registers(id);
+	
 	Timer_Data[timer_id_to_index(id)].callback = callback;
 	
-	// TxCONbits.TSIDL = 0;		Continue operation in IDLE mode
 	// _TxIP					Interrupt priority
 	// _TxIF					Clear interrupt flag
 	// _TxIE					Enable interrupt
-	switch(id)
-	{
-		case TIMER_1:
-			_T1IP = priority;
-			_T1IF = 0;
-			_T1IE = 1;
-			break;
-		case TIMER_2:
-			_T2IP = priority;
-			_T2IF = 0;
-			_T2IE = 1;
-			break;
-		case TIMER_23:
-		case TIMER_3:
-			_T3IP = priority;
-			_T3IF = 0;
-			_T3IE = 1;
-			break;
-		case TIMER_4:
-			_T4IP = priority;
-			_T4IF = 0;
-			_T4IE = 1;
-			break;
-		case TIMER_45:
-		case TIMER_5:
-			_T5IP = priority;
-			_T5IF = 0;
-			_T5IE = 1;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-			_T6IP = priority;
-			_T6IF = 0;
-			_T6IE = 1;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_67:
-		case TIMER_7:
-			_T7IP = priority;
-			_T7IF = 0;
-			_T7IE = 1;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-			_T8IP = priority;
-			_T8IF = 0;
-			_T8IE = 1;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_89:
-		case TIMER_9:
-			_T9IP = priority;
-			_T9IF = 0;
-			_T9IE = 1;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	*regs->ipc = (*regs->ipc & ~(7 << regs->ip_shift)) | (priority << regs->ip_shift);
+	atomic_and(regs->ifs, ~regs->if_mask);
+	atomic_or(regs->iec, regs->if_mask);
 }
 
 /**
@@ -765,72 +641,15 @@ void timer_enable_interrupt(int id, timer_callback callback, int priority)
 
 bool timer_force_interrupt(int id)
 {
-	// _TxIE					Disable interrupt
-	// _TxIF					Clear interrupt flag
+	const Timer_Registers* regs = timer_id_to_irq_registers(id);
 	bool ret;
-	switch(id)
-	{
-		case TIMER_1:
-			ret = _T1IE;
-			_T1IE = 1;
-			_T1IF = 1;
-			break;
-		case TIMER_2:
-			ret = _T2IE;
-			_T2IE = 1;
-			_T2IF = 1;
-			break;
-		case TIMER_23:
-		case TIMER_3:
-			ret = _T3IE;
-			_T3IE = 1;
-			_T3IF = 1;
-			break;
-		case TIMER_4:
-			ret = _T4IE;
-			_T4IE = 1;
-			_T4IF = 1;
-			break;  
-		case TIMER_45:
-		case TIMER_5:
-			ret = _T5IE;
-			_T5IE = 1;
-			_T5IF = 1;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-			ret = _T6IE;
-			_T6IE = 1;
-			_T6IF = 1;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_67:
-		case TIMER_7:
-			ret = _T7IE;
-			_T7IE = 1;
-			_T7IF = 1;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-			ret = _T8IE;
-			_T8IE = 1;
-			_T8IF = 1;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_89:
-		case TIMER_9:
-			ret = _T9IE;
-			_T9IE = 1;
-			_T9IF = 1;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	
+	// _TxIE					Enable interrupt
+	// _TxIF					Set interrupt flag
+	ret = (*regs->iec & regs->if_mask) != 0;
+	atomic_or(regs->iec, regs->if_mask);
+	atomic_or(regs->ifs, regs->if_mask);
+	
 	return ret;
 }
 
@@ -845,42 +664,9 @@ bool timer_force_interrupt(int id)
 */
 bool timer_get_if(int id)
 {
-	switch(id)
-	{
-		case TIMER_1:
-			return _T1IF;
-		case TIMER_2:
-			return _T2IF;
-		case TIMER_23:
-		case TIMER_3:
-			return _T3IF;
-		case TIMER_4:
-			return _T4IF;
-		case TIMER_45:
-		case TIMER_5:
-			return _T5IF;
-#ifdef _T6IF
-		case TIMER_6:
-			return _T6IF;
-#endif
-#ifdef _T7IF
-		case TIMER_67:
-		case TIMER_7:
-			return _T7IF;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-			return _T8IF;
-#endif
-#ifdef _T9IF
-		case TIMER_89:
-		case TIMER_9:
-			return _T9IF;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	const Timer_Registers* regs = timer_id_to_irq_registers(id);
+	
+	return (*regs->ifs & regs->if_mask) != 0;
 }
 
 
@@ -895,61 +681,16 @@ bool timer_get_if(int id)
 			\ref true if the timer interrupt flag was active, \ref false otherwise
 */
 bool timer_set_if(int id, bool f) {
+	const Timer_Registers* regs = timer_id_to_irq_registers(id);
 	bool ret;
-	switch(id)
-	{
-		case TIMER_1:
-			ret = _T1IF;
-			_T1IF = f;
-			return ret;
-		case TIMER_2:
-			ret = _T2IF;
-			_T2IF = f;
-			return ret;
-		case TIMER_23:
-		case TIMER_3:
-			ret = _T3IF;
-			_T3IF = f;
-			return ret;
-		case TIMER_4:
-			ret = _T4IF;
-			_T4IF = f;
-			return ret;
-		case TIMER_45:
-		case TIMER_5:
-			ret = _T5IF;
-			_T5IF = f;
-			return ret;
-#ifdef _T6IF
-		case TIMER_6:
-			ret = _T6IF;
-			_T6IF = f;
-			return ret;
-#endif
-#ifdef _T7IF
-		case TIMER_67:
-		case TIMER_7:
-			ret = _T7IF;
-			_T7IF = f;
-			return ret;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-			ret = _T8IF;
-			_T8IF = f;
-			return ret;
-#endif
-#ifdef _T9IF
-		case TIMER_89:
-		case TIMER_9:
-			ret = _T9IF;
-			_T9IF = f;
-			return ret;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	
+	ret = (*regs->ifs & regs->if_mask) != 0;
+	if (f)
+		atomic_or(regs->ifs, regs->if_mask);
+	else
+		atomic_and(regs->ifs, ~regs->if_mask);
+	
+	return ret;
 }	
 
 /**
@@ -960,63 +701,12 @@ bool timer_set_if(int id, bool f) {
 */
 void timer_disable_interrupt(int id)
 {
+	const Timer_Registers* regs = timer_id_to_irq_registers(id);
+	
 	// _TxIE					Disable interrupt
 	// _TxIF					Clear interrupt flag
-	// TxCONbits.TSIDL = 1;		Discontinue operation in IDLE mode
-	switch(id)
-	{
-		case TIMER_1:
-			_T1IE = 0;
-			_T1IF = 0;
-			break;
-		case TIMER_2:
-			_T2IE = 0;
-			_T2IF = 0;
-			break;
-		case TIMER_23:
-		case TIMER_3:
-			_T3IE = 0;
-			_T3IF = 0;
-			break;
-		case TIMER_4:
-			_T4IE = 0;
-			_T4IF = 0;
-			break;  
-		case TIMER_45:
-		case TIMER_5:
-			_T5IE = 0;
-			_T5IF = 0;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-			_T6IE = 0;
-			_T6IF = 0;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_67:
-		case TIMER_7:
-			_T7IE = 0;
-			_T7IF = 0;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-			_T8IE = 0;
-			_T8IF = 0;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_89:
-		case TIMER_9:
-			_T9IE = 0;
-			_T9IF = 0;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	atomic_and(regs->iec, ~regs->if_mask);
+	atomic_and(regs->ifs, ~regs->if_mask);
 }
 
 /**
@@ -1028,60 +718,31 @@ void timer_disable_interrupt(int id)
 			The prescaler factor		
 */
 unsigned int timer_get_prescaler(int id) {
-	unsigned int ret = 0;
-	switch(id)
-	{
-		case TIMER_1:	ret = T1CONbits.TCKPS;
-			break;
-		case TIMER_2:
-		case TIMER_23:	ret = T2CONbits.TCKPS;
-			break;
-		case TIMER_3:	ret = T3CONbits.TCKPS;
-			break;
-		case TIMER_4:
-		case TIMER_45:	ret = T4CONbits.TCKPS;
-			break;
-		case TIMER_5:	ret = T5CONbits.TCKPS;
-			break;
-	#ifdef _T6IF
-		case TIMER_6:
-		case TIMER_67:	ret = T6CONbits.TCKPS;
-			break;
-	#endif
-	#ifdef _T7IF
-		case TIMER_7:	ret = T7CONbits.TCKPS;
-			break;
-	#endif
-	#ifdef _T8IF
-		case TIMER_8:
-		case TIMER_89:	ret = T8CONbits.TCKPS;
-			break;
-	#endif
-	#ifdef _T9IF
-		case TIMER_9:	ret = T9CONbits.TCKPS;
-			break;
-	#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
-	switch(ret) {
-		case 0:
-			ret = 1;
-			break;
-		case 1:
-			ret = 8;
-			break;
-		case 2:
-			ret = 64;
-			break;
-		case 3:
-			ret = 256;
-			break;
-	}
-	return ret;	
+	static const unsigned int prescaler_value[4] = {1, 8, 64, 256};
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	
+	return prescaler_value[(*regs->con & TIMER_CON_TCKPS) >> TIMER_CON_TCKPS_SHIFT];
 }	
 
+/**
+	Get the timer period register
+	
+	\param	id
+			The timer can be one of the 16-bits timer (\ref TIMER_1 -> \ref TIMER_9) or one of the 32-bits timer (\ref TIMER_23 -> \ref TIMER_89).
+	\return 
+			The value of the period register, the counter counts from 0 to this value
+*/
+unsigned long timer_get_period(int id) {
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	unsigned long period;
+	
+	period = *regs->pr;
+	if (timer_id_to_32bits(id))
+		period |= (unsigned long)*regs[1].pr << 16;
+	
+	return period;
+}
+
 //-----------------------------------
 // Internal functions, implementation
 //-----------------------------------
@@ -1102,33 +763,19 @@ unsigned int timer_get_prescaler(int id) {
 */
 void m_set_32bits_mode(int id, char mode)
 {
-	switch(id)
-	{
-		case TIMER_1:
-			break;
-		case TIMER_2:
-		case TIMER_3:
-		case TIMER_23:	T2CONbits.T32 = mode;
-			break;
-		case TIMER_4:
-		case TIMER_5:
-		case TIMER_45:	T4CONbits.T32 = mode;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-		case TIMER_7:
-		case TIMER_67:	T6CONbits.T32 = mode;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-		case TIMER_9:
-		case TIMER_89:	T8CONbits.T32 = mode;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-	}
+	int index;
+	
+	// Timer 1 cannot be paired
+	if (id == TIMER_1)
+		return;
+	
+	// the mode is in the configuration register of the least significant timer of the pair
+	index = ((timer_id_to_index(id) - 1) & ~1) + 1;
+	
+	if (mode == TIMER_32B_MODE)
+		atomic_or(Timer_Registers_Table[index].con, TIMER_CON_T32);
+	else
+		atomic_and(Timer_Registers_Table[index].con, ~TIMER_CON_T32);
 }
 
 
@@ -1150,42 +797,9 @@ void m_set_32bits_mode(int id, char mode)
 */
 void m_set_prescaler(int id, unsigned int prescaler)
 {
-	switch(id)
-	{
-		case TIMER_1:	T1CONbits.TCKPS = prescaler;
-			break;
-		case TIMER_2:
-		case TIMER_23:	T2CONbits.TCKPS = prescaler;
-			break;
-		case TIMER_3:	T3CONbits.TCKPS = prescaler;
-			break;
-		case TIMER_4:
-		case TIMER_45:	T4CONbits.TCKPS = prescaler;
-			break;
-		case TIMER_5:	T5CONbits.TCKPS = prescaler;
-			break;
-#ifdef _T6IF
-		case TIMER_6:
-		case TIMER_67:	T6CONbits.TCKPS = prescaler;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_7:	T7CONbits.TCKPS = prescaler;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:
-		case TIMER_89:	T8CONbits.TCKPS = prescaler;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_9:	T9CONbits.TCKPS = prescaler;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	
+	*regs->con = (*regs->con & ~TIMER_CON_TCKPS) | ((prescaler << TIMER_CON_TCKPS_SHIFT) & TIMER_CON_TCKPS);
 }
 
 
@@ -1200,38 +814,7 @@ void m_set_prescaler(int id, unsigned int prescaler)
 */
 void m_set_period_16b(int id, unsigned short period)
 {
-	switch(id)
-	{
-		case TIMER_1:	PR1 = period;
-			break;
-		case TIMER_2:	PR2 = period;
-			break;
-		case TIMER_3:	PR3 = period;
-			break;
-		case TIMER_4:	PR4 = period;
-			break;
-		case TIMER_5:	PR5 = period;
-			break;
-#ifdef _T6IF
-		case TIMER_6:	PR6 = period;
-			break;
-#endif
-#ifdef _T7IF
-		case TIMER_7:	PR7 = period;
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_8:	PR8 = period;
-			break;
-#endif
-#ifdef _T9IF
-		case TIMER_9:	PR9 = period;
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	*timer_id_to_registers(id)->pr = period;
 }
 
 
@@ -1248,35 +831,15 @@ void m_set_period_16b(int id, unsigned short period)
 */
 void m_set_period_32b(int id, unsigned long period)
 {
-	switch(id)
-	{
-		case TIMER_23:	
-			PR2 = period & 0xffff;	// LSB
-			PR3 = (period >> 16);	// MSB
-			break;
-		case TIMER_45:	
-			PR4 = period & 0xffff;	// LSB
-			PR5 = (period >> 16);	// MSB
-			break;
-#ifdef _T6IF
-		case TIMER_67:	
-			PR6 = period & 0xffff;	// LSB
-			PR7 = (period >> 16);	// MSB
-			break;
-#endif
-#ifdef _T8IF
-		case TIMER_89:	
-			PR8 = period & 0xffff;	// LSB
-			PR9 = (period >> 16);	// MSB
-			break;
-#endif
-		default:
-			ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
-			break;
-	}
+	const Timer_Registers* regs = timer_id_to_registers(id);
+	
+	if (!timer_id_to_32bits(id))
+		ERROR(TIMER_ERROR_INVALID_TIMER_ID, &id);
+	
+	*regs[0].pr = period & 0xffff;	// LSB
+	*regs[1].pr = (period >> 16);	// MSB
 }
 
-
 //--------------------------
 // Interrupt service routine
 //--------------------------
@@ -1290,10 +853,9 @@ void m_set_period_32b(int id, unsigned long period)
 */
 void _ISR _T1Interrupt(void)
 {
+	_T1IF = 0;
 	// function must exist because this interrupt is enabled
 	Timer_Data[0].callback(TIMER_1);
-	
-	_T1IF = 0;
 }
 
 #endif
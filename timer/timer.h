@@ -116,6 +116,8 @@ bool timer_set_if(int id, bool f);
 
 unsigned int timer_get_prescaler(int id);
 
+unsigned long timer_get_period(int id);
+
 /*@}*/
 
 #endif
@@ -0,0 +1,226 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/**
+
+\defgroup timestamp Timestamp
+
+A 64 bits monotonic time service.
+
+\section Introduction
+
+This module provides a cheap "now" for profiling, timestamps and timeouts.
+It uses a 32-bits timer pair (\ref TIMER_23 or \ref TIMER_45), free running at the cycle frequency,
+and extends it to 64 bits by counting its overflows in the timer interrupt.
+At 40 MHz, the 32-bits timer overflows every 107 s, so the interrupt load is negligible,
+and the 64 bits counter does not wrap around in the lifetime of the device.
+
+\section Usage
+
+\code
+unsigned long long start, duration;
+
+timestamp_init(TIMER_23, 6);
+
+start = timestamp_get();
+do_something();
+duration = timestamp_to_us(timestamp_get() - start);
+\endcode
+
+timestamp_get() is lock-free: it reads the overflow count, the timer, and the overflow count again,
+and retries if an overflow was accounted in between. It does not change the IPL.
+If it is called from an IPL higher than the one given to timestamp_init(), an overflow that is pending
+but not yet accounted is detected from the timer interrupt flag.
+The only unsupported case is preempting the overflow interrupt itself between the clearing of
+its flag and the call of its callback, so readers running at a higher IPL than the overflow
+interrupt must tolerate a rare error of 2^32 ticks.
+
+The fast path of timestamp_get() is about twenty instruction cycles, call and return included.
+
+*/
+/*@{*/
+
+/** \file
+	Implementation of the 64 bits monotonic time service.
+*/
+
+//---------
+// Includes
+//---------
+
+#include "timestamp.h"
+#include "../timer/timer.h"
+#include "../clock/clock.h"
+#include "../error/error.h"
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** Timestamp data */
+static struct
+{
+	volatile unsigned long high;		/**< number of overflows of the 32-bits timer */
+	volatile unsigned int* tmr_lsw;		/**< least significant word of the timer, reading it latches the most significant word */
+	volatile unsigned int* tmr_hld;		/**< holding register of the most significant word of the timer */
+	volatile unsigned int* ifs;			/**< interrupt flag register of the timer */
+	unsigned int if_mask;				/**< mask of the interrupt flag of the timer in ifs */
+	unsigned long fcy;					/**< frequency of the timer, in Hz */
+} Timestamp_Data;
+
+
+//-------------------
+// Internal functions
+//-------------------
+
+/** Timer callback, account one overflow of the 32-bits timer */
+static void timestamp_overflow_cb(int __attribute__((unused)) timer_id)
+{
+	Timestamp_Data.high++;
+}
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Initialize the time service and start the timer.
+	
+	\param	timer_id
+			The 32-bits timer to use, either \ref TIMER_23 or \ref TIMER_45 ; it is reserved by this module.
+	\param 	priority
+			Interrupt priority of the overflow accounting, from 1 (lowest priority) to 6 (highest normal priority)
+	
+	\note	The cycle frequency is read from clock_get_cycle_frequency() at this time,
+			so the clock must be configured before.
+*/
+void timestamp_init(int timer_id, int priority)
+{
+	switch (timer_id)
+	{
+		case TIMER_23:
+			Timestamp_Data.tmr_lsw = &TMR2;
+			Timestamp_Data.tmr_hld = &TMR3HLD;
+			Timestamp_Data.ifs = &IFS0;
+			Timestamp_Data.if_mask = 1 << 8;	// _T3IF is IFS0<8>
+			break;
+		case TIMER_45:
+			Timestamp_Data.tmr_lsw = &TMR4;
+			Timestamp_Data.tmr_hld = &TMR5HLD;
+			Timestamp_Data.ifs = &IFS1;
+			Timestamp_Data.if_mask = 1 << 12;	// _T5IF is IFS1<12>
+			break;
+		default:
+			ERROR(TIMESTAMP_ERROR_INVALID_TIMER_ID, &timer_id);
+	}
+	
+	Timestamp_Data.high = 0;
+	Timestamp_Data.fcy = clock_get_cycle_frequency();
+	
+	// free running at Fcy, 1:1 prescaler
+	timer_init(timer_id, 0xFFFFFFFFUL, -1);
+	timer_enable_interrupt(timer_id, timestamp_overflow_cb, priority);
+	timer_enable(timer_id);
+}
+
+/**
+	Return the number of timer ticks since timestamp_init().
+	
+	One tick is one cycle, use timestamp_to_us() or timestamp_to_ns() to convert it.
+*/
+unsigned long long timestamp_get(void)
+{
+	unsigned long high;
+	unsigned int low;
+	unsigned int mid;
+	unsigned int pending;
+	
+	do {
+		high = Timestamp_Data.high;
+		barrier();
+		low = *Timestamp_Data.tmr_lsw;
+		mid = *Timestamp_Data.tmr_hld;
+		// An overflow occured but was not accounted yet, either because its interrupt is
+		// about to run, or because we are at a higher IPL. If the counter is in its lower half,
+		// it has wrapped around after the flag was set.
+		pending = *Timestamp_Data.ifs & Timestamp_Data.if_mask;
+		barrier();
+	} while (high != Timestamp_Data.high);
+	
+	if (pending && !(mid & 0x8000))
+		high++;
+	
+	return ((unsigned long long)high << 32) | ((unsigned long)mid << 16) | low;
+}
+
+/**
+	Convert a number of timer ticks to microseconds.
+	
+	\param	ticks
+			Number of ticks, as returned by timestamp_get() or a difference of them.
+	\return	The duration in microseconds, rounded down.
+*/
+unsigned long long timestamp_to_us(unsigned long long ticks)
+{
+	unsigned long fcy = Timestamp_Data.fcy;
+	
+	if (fcy == 0)
+		ERROR(TIMESTAMP_ERROR_NOT_INITIALIZED, &fcy);
+	
+	// split to avoid overflowing 64 bits
+	return (ticks / fcy) * 1000000ULL + ((ticks % fcy) * 1000000ULL) / fcy;
+}
+
+/**
+	Convert a number of timer ticks to nanoseconds.
+	
+	\param	ticks
+			Number of ticks, as returned by timestamp_get() or a difference of them.
+	\return	The duration in nanoseconds, rounded down.
+*/
+unsigned long long timestamp_to_ns(unsigned long long ticks)
+{
+	unsigned long fcy = Timestamp_Data.fcy;
+	
+	if (fcy == 0)
+		ERROR(TIMESTAMP_ERROR_NOT_INITIALIZED, &fcy);
+	
+	// split to avoid overflowing 64 bits
+	return (ticks / fcy) * 1000000000ULL + ((ticks % fcy) * 1000000000ULL) / fcy;
+}
+
+/**
+	Return the number of microseconds since timestamp_init().
+*/
+unsigned long long timestamp_get_us(void)
+{
+	return timestamp_to_us(timestamp_get());
+}
+
+/*@}*/
@@ -0,0 +1,62 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MOLOLE_TIMESTAMP_H
+#define _MOLOLE_TIMESTAMP_H
+
+#include "../types/types.h"
+
+/** \addtogroup timestamp */
+/*@{*/
+
+/** \file
+	\brief A 64 bits monotonic time service.
+*/
+
+// Defines
+
+/** Errors timestamp can throw */
+enum timestamp_errors
+{
+	TIMESTAMP_ERROR_BASE = 0x1400,
+	TIMESTAMP_ERROR_INVALID_TIMER_ID,		/**< The specified timer is not \ref TIMER_23 or \ref TIMER_45 */
+	TIMESTAMP_ERROR_NOT_INITIALIZED,		/**< timestamp_init() was not called */
+};
+
+// Functions, doc in the .c
+
+void timestamp_init(int timer_id, int priority);
+
+unsigned long long timestamp_get(void);
+
+unsigned long long timestamp_to_us(unsigned long long ticks);
+
+unsigned long long timestamp_to_ns(unsigned long long ticks);
+
+unsigned long long timestamp_get_us(void);
+
+/*@}*/
+
+#endif
@@ -107,6 +107,9 @@ enum irq_prio
 #endif
 
 
+// A host register model can provide its own atomic operations
+#ifndef atomic_and
+
 /** Atomic and operation to prevent race conditions inside interrupts: *x = (*x) & y */
 #define atomic_and(x,y) do { __asm__ volatile ("and.w %[yy], [%[xx]], [%[xx]]": : [xx] "r" (x), [yy] "r"(y): "cc","memory"); } while(0)
 /** Atomic or operation to prevent race conditions inside interrupts: *x = (*x) | y */
@@ -116,6 +119,8 @@ enum irq_prio
 #define atomic_add(x,y) do { __asm__ volatile ("add.w %[yy], [%[xx]], [%[xx]]": : [xx] "r" (x), [yy] "r"(y): "cc","memory"); } while(0)
 #define atomic_add_and_test(x,y) ({unsigned int _r = 0;  __asm__ volatile ("add.w %[yy], [%[xx]], [%[xx]]\n bra Z,1f\n setm %[oo]\n1:": [oo] "+r" (_r) : [xx] "r" (x), [yy] "r"(y): "cc","memory"); _r;})
 
+#endif
+
 /*@}*/
 
 #endif
@@ -0,0 +1,139 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup uart */
+/*@{*/
+
+/** \file
+	Baud rate generator computation, shared between the UART drivers.
+	
+	tests/uart-brg-test.c checks it on the host against all the dividers, for common clocks and baud rates (make -C tests check).
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include <limits.h>
+
+#include "uart_priv.h"
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Return the baud rate generator value closest to a baud rate, and the speed mode to use.
+	
+	Low speed (16 clocks per bit) is preferred when both modes are as close, as it samples each bit 3 times;
+	if UART_HIGH_SPEED_ERRATA is defined, it is always used.
+	
+	\param	fcy
+			cycle frequency, in Hz
+	\param	baud_rate
+			requested baud rate, from 1 to fcy / 4, checked by the caller
+	\param	high_speed
+			set to true if the high speed mode (4 clocks per bit) must be used
+	\return	value of UxBRG
+*/
+unsigned int uart_compute_brg(unsigned long fcy, unsigned long baud_rate, bool* high_speed)
+{
+	unsigned long divider;
+	unsigned long product;
+	unsigned long low_divider;
+	unsigned long low_error;
+	unsigned long high_divider;
+	unsigned long high_error;
+	
+	// Round the divider to the nearest, in each mode
+	divider = (fcy + 8 * baud_rate) / (16 * baud_rate);
+	if (divider > 65536)
+		divider = 65536;
+	if (divider < 1)
+		divider = 1;
+	low_divider = divider;
+	product = 16 * low_divider * baud_rate;
+	low_error = product > fcy ? product - fcy : fcy - product;
+	
+	divider = (fcy + 2 * baud_rate) / (4 * baud_rate);
+	if (divider > 65536)
+		divider = 65536;
+	high_divider = divider;
+	product = 4 * high_divider * baud_rate;
+	high_error = product > fcy ? product - fcy : fcy - product;
+	
+#ifndef UART_HIGH_SPEED_ERRATA
+	if (high_error < low_error)
+	{
+		*high_speed = true;
+		return high_divider - 1;
+	}
+#endif
+	
+	*high_speed = false;
+	return low_divider - 1;
+}
+
+/**
+	Return the error of a baud rate relative to a reference, in hundredths of percent.
+	
+	The error is computed exactly with 32-bit divisions, and saturated to INT_MIN or INT_MAX
+	beyond what an int holds, for instance after uart_start_auto_baud() found a very different rate.
+	
+	\param	baud_rate
+			baud rate obtained
+	\param	reference
+			baud rate expected, not 0
+	\return	(baud_rate - reference) / reference, in hundredths of percent
+*/
+int uart_relative_error(unsigned long baud_rate, unsigned long reference)
+{
+	unsigned long difference = baud_rate > reference ? baud_rate - reference : reference - baud_rate;
+	unsigned long quotient = difference / reference;
+	unsigned long remainder = difference % reference;
+	unsigned long error;
+	
+	// remainder * 10000 could overflow, so multiply by 100 twice; remainder * 100 fits as reference is at most fcy / 4
+	if (quotient > (unsigned long)INT_MAX / 10000)
+		error = (unsigned long)INT_MAX + 1;
+	else
+	{
+		remainder *= 100;
+		error = quotient * 10000 + (remainder / reference) * 100 + (remainder % reference) * 100 / reference;
+	}
+	
+	if (baud_rate > reference)
+		return error > (unsigned long)INT_MAX ? INT_MAX : (int)error;
+	else
+		return error > (unsigned long)INT_MAX ? INT_MIN : -(int)error;
+}
+
+/*@}*/
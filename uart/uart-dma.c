@@ -0,0 +1,387 @@
+/*
+	Molole - Mobots Low Level library
+	An open source toolkit for robot programming using DsPICs
+
+	Copyright (C) 2007--2011 Stephane Magnenat <stephane at magnenat dot net>,
+	Philippe Retornaz <philippe dot retornaz at epfl dot ch>
+	Mobots group (http://mobots.epfl.ch), Robotics system laboratory (http://lsro.epfl.ch)
+	EPFL Ecole polytechnique federale de Lausanne (http://www.epfl.ch)
+
+	See authors.txt for more details about other contributors.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//--------------------
+// Usage documentation
+//--------------------
+
+/** \addtogroup uart */
+/*@{*/
+
+/** \file
+	DMA mode of the UART wrapper.
+	
+	In DMA mode, the UART does not interrupt the CPU for each byte. Instead:
+	- received bytes are written by DMA into a circular buffer, split in two halves used in ping-pong;
+	  each time a half is full, it is passed to the block received callback.
+	  To get the bytes of a half that is not full yet, for instance the end of a packet,
+	  call uart_flush_dma_rx() periodically, for instance from a timer: once the line is idle,
+	  the bytes received since the last call are passed to the block received callback.
+	- blocks are transmitted by DMA from user buffers, possibly from several buffers in sequence
+	  (see \ref DMA_Chain), and the block transmitted callback is called at the end.
+	
+	All buffers must be inside the DMA memory, see dma_memory_alloc() and \ref DMA_STATIC_BUFFER.
+	
+	\code
+	DMA_STATIC_BUFFER(rx_buffer, 128, 2);
+	DMA_STATIC_BUFFER(tx_buffer, 64, 2);
+	
+	void block_received(int uart_id, const unsigned char* data, unsigned int length, void* user_data)
+	{
+		// consume length bytes of data
+	}
+	
+	uart_init_dma(UART_1, 921600, true, DMA_CHANNEL_0, rx_buffer, sizeof(rx_buffer), block_received, DMA_CHANNEL_1, 0, 5, 0);
+	uart_transmit_block(UART_1, tx_buffer, 12);
+	\endcode
+	
+	The rx buffer must be large enough to hold the bytes received during the longest time
+	the DMA interrupt can be delayed, otherwise they are overwritten.
+	Bytes received with a framing error are passed along with the others.
+	
+	The idle flush uses DSADR, the address of the most recent DMA access: if another channel accessed
+	the DMA memory after the last received byte, the flush cannot know how many bytes were received
+	and the bytes are passed at the next call, or when the half is full.
+*/
+
+
+//------------
+// Definitions
+//------------
+
+#include <p33Fxxxx.h>
+
+#include "uart.h"
+#include "../error/error.h"
+
+
+//-----------------------
+// Structures definitions
+//-----------------------
+
+/** UART DMA mode data */
+typedef struct
+{
+	int uart_id;										/**< identifier of the UART */
+	int rx_channel;										/**< reception DMA channel, DMA_CHANNEL_FREE if not used */
+	int tx_channel;										/**< transmission DMA channel, DMA_CHANNEL_FREE if not used */
+	unsigned char* rx_buffer;							/**< reception buffer, two halves */
+	unsigned int rx_half_size;							/**< size of a half of the reception buffer */
+	unsigned int rx_current;							/**< half being filled by the DMA */
+	unsigned int rx_delivered;							/**< bytes of the current half already passed to the callback */
+	uart_block_received block_received_callback;		/**< function to call when a block is received */
+	uart_block_transmitted block_transmitted_callback;	/**< function to call when a block has been transmitted, may be 0 */
+	void* user_data;									/**< pointer to user-specified data to be passed to callbacks, may be 0 */
+	int priority;										/**< interrupt priority of the DMA channels */
+	DMA_Chain tx_chain;									/**< transmission in progress */
+	DMA_Descriptor tx_descriptor;						/**< segment of uart_transmit_block() */
+} UART_DMA_Data;
+
+/** DMA mode data for UART 1 */
+static UART_DMA_Data UART_1_DMA_Data = { UART_1, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE };
+
+/** DMA mode data for UART 2 */
+static UART_DMA_Data UART_2_DMA_Data = { UART_2, DMA_CHANNEL_FREE, DMA_CHANNEL_FREE };
+
+
+//-------------------
+// Privates functions 
+//-------------------
+
+/** Return the DMA mode data of an UART */
+static UART_DMA_Data* get_dma_data(int uart_id)
+{
+	if (uart_id == UART_1)
+		return &UART_1_DMA_Data;
+	else if (uart_id == UART_2)
+		return &UART_2_DMA_Data;
+	
+	ERROR_RET_0(UART_ERROR_INVALID_ID, &uart_id);
+}
+
+/** A half of the reception buffer is full, pass the bytes not yet flushed */
+static void rx_half_completed(UART_DMA_Data* data, bool first_buffer)
+{
+	unsigned int half = first_buffer ? 0 : 1;
+	
+	if (data->rx_delivered < data->rx_half_size)
+		data->block_received_callback(data->uart_id, data->rx_buffer + half * data->rx_half_size + data->rx_delivered, data->rx_half_size - data->rx_delivered, data->user_data);
+	
+	data->rx_current = 1 - half;
+	data->rx_delivered = 0;
+}
+
+/** DMA callback of UART 1 reception */
+static void rx_dma_callback_1(int channel, bool first_buffer)
+{
+	rx_half_completed(&UART_1_DMA_Data, first_buffer);
+}
+
+/** DMA callback of UART 2 reception */
+static void rx_dma_callback_2(int channel, bool first_buffer)
+{
+	rx_half_completed(&UART_2_DMA_Data, first_buffer);
+}
+
+/** DMA chain callback at the end of a transmission */
+static void tx_chain_done(DMA_Chain* chain, void* user_data)
+{
+	UART_DMA_Data* data = (UART_DMA_Data*)user_data;
+	
+	if (data->block_transmitted_callback)
+		data->block_transmitted_callback(data->uart_id, data->user_data);
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
+/**
+	Init an UART subsystem in DMA mode.
+	
+	The parameters are 8 bits, 1 stop bit, no parity.
+	The per-byte interrupts of the UART are disabled, and the byte callbacks of uart_init() are not used.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	baud_rate
+			baud rate in bps
+	\param	hardware_flow_control
+			wether hardware flow control (CTS/RTS) should be used or not
+	\param	rx_dma_channel
+			DMA channel for reception, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7, or \ref DMA_CHANNEL_FREE to not receive
+	\param	rx_buffer
+			reception buffer inside the DMA memory
+	\param	rx_buffer_size
+			size of rx_buffer, an even number of bytes; the block received callback is called at least every half of it
+	\param	block_received_callback
+			function to call when a block is received, from the DMA interrupt or from uart_flush_dma_rx()
+	\param	tx_dma_channel
+			DMA channel for transmission, from \ref DMA_CHANNEL_0 to \ref DMA_CHANNEL_7, or \ref DMA_CHANNEL_FREE to not transmit
+	\param	block_transmitted_callback
+			function to call when a block has been transferred to the UART, from the DMA interrupt; may be 0
+	\param 	priority
+			Interrupt priority of the DMA channels, from 1 (lowest priority) to 6 (highest normal priority)
+	\param 	user_data
+			Pointer to user-specified data to be passed to callbacks, may be 0
+*/
+void uart_init_dma(int uart_id, unsigned long baud_rate, bool hardware_flow_control, int rx_dma_channel, unsigned char* rx_buffer, unsigned int rx_buffer_size, uart_block_received block_received_callback, int tx_dma_channel, uart_block_transmitted block_transmitted_callback, int priority, void* user_data)
+{
+	UART_DMA_Data* data = get_dma_data(uart_id);
+	int flags;
+	
+	if (rx_dma_channel != DMA_CHANNEL_FREE && (rx_buffer_size < 2 || (rx_buffer_size & 1)))
+		ERROR(UART_ERROR_INVALID_BUFFER_SIZE, &rx_buffer_size);
+	
+	data->rx_channel = rx_dma_channel;
+	data->tx_channel = tx_dma_channel;
+	data->rx_buffer = rx_buffer;
+	data->rx_half_size = rx_buffer_size / 2;
+	data->rx_current = 0;
+	data->rx_delivered = 0;
+	data->block_received_callback = block_received_callback;
+	data->block_transmitted_callback = block_transmitted_callback;
+	data->user_data = user_data;
+	data->priority = priority;
+	
+	// uart_init() enables the per-byte interrupts, which have no callback in DMA mode
+	RAISE_IPL(flags, 7);
+	uart_init(uart_id, baud_rate, hardware_flow_control, 0, 0, priority, user_data);
+	if (uart_id == UART_1)
+	{
+		_U1RXIE = 0;
+		_U1TXIE = 0;
+		_U1RXIF = 0;
+		_U1TXIF = 0;
+	}
+	else
+	{
+		_U2RXIE = 0;
+		_U2TXIE = 0;
+		_U2RXIF = 0;
+		_U2TXIF = 0;
+	}
+	IRQ_ENABLE(flags);
+	
+	if (rx_dma_channel != DMA_CHANNEL_FREE)
+	{
+		dma_init_channel(
+			rx_dma_channel,
+			uart_id == UART_1 ? DMA_INTERRUPT_SOURCE_UART_1_RX : DMA_INTERRUPT_SOURCE_UART_2_RX,
+			DMA_SIZE_BYTE,
+			DMA_DIR_FROM_PERIPHERAL_TO_RAM,
+			DMA_INTERRUPT_AT_FULL,
+			DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+			DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT,
+			DMA_OPERATING_CONTINUOUS_PING_PONG,
+			rx_buffer,
+			rx_buffer + data->rx_half_size,
+			uart_id == UART_1 ? (void*)&U1RXREG : (void*)&U2RXREG,
+			data->rx_half_size,
+			uart_id == UART_1 ? rx_dma_callback_1 : rx_dma_callback_2
+		);
+		dma_set_priority(rx_dma_channel, priority);
+		dma_enable_channel(rx_dma_channel);
+	}
+	
+	if (tx_dma_channel != DMA_CHANNEL_FREE)
+	{
+		// Buffers are given by each transmission
+		dma_init_channel(
+			tx_dma_channel,
+			uart_id == UART_1 ? DMA_INTERRUPT_SOURCE_UART_1_TX : DMA_INTERRUPT_SOURCE_UART_2_TX,
+			DMA_SIZE_BYTE,
+			DMA_DIR_FROM_RAM_TO_PERIPHERAL,
+			DMA_INTERRUPT_AT_FULL,
+			DMA_DO_NOT_NULL_WRITE_TO_PERIPHERAL,
+			DMA_ADDRESSING_REGISTER_INDIRECT_POST_INCREMENT,
+			DMA_OPERATING_ONE_SHOT,
+			0,
+			0,
+			uart_id == UART_1 ? (void*)&U1TXREG : (void*)&U2TXREG,
+			1,
+			dma_chain_interrupt
+		);
+		dma_set_priority(tx_dma_channel, priority);
+	}
+}
+
+/**
+	Pass the bytes received in DMA mode since the last block, if the line is idle.
+	
+	Call this function periodically, its period being the maximum latency for the end of a message.
+	The block received callback is called from this function, at the DMA interrupt priority.
+	This function also clears a receive overrun, which would otherwise stop the reception.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+*/
+void uart_flush_dma_rx(int uart_id)
+{
+	UART_DMA_Data* data = get_dma_data(uart_id);
+	unsigned char* start;
+	unsigned char* last;
+	unsigned int received;
+	bool idle;
+	int flags;
+	
+	if (data->rx_channel == DMA_CHANNEL_FREE)
+		ERROR(UART_ERROR_DMA_NOT_INITIALIZED, &uart_id);
+	
+	RAISE_IPL(flags, data->priority);
+	
+	if (uart_id == UART_1)
+	{
+		idle = U1STAbits.RIDLE;
+		if (U1STAbits.OERR)
+			U1STAbits.OERR = 0;
+	}
+	else
+	{
+		idle = U2STAbits.RIDLE;
+		if (U2STAbits.OERR)
+			U2STAbits.OERR = 0;
+	}
+	
+	// The last DMA access is ours only if it is inside the current half
+	start = data->rx_buffer + data->rx_current * data->rx_half_size;
+	last = (unsigned char*)DSADR;
+	if (idle && last >= start && last < start + data->rx_half_size)
+	{
+		received = last - start + 1;
+		if (received > data->rx_delivered)
+		{
+			data->block_received_callback(uart_id, start + data->rx_delivered, received - data->rx_delivered, data->user_data);
+			data->rx_delivered = received;
+		}
+	}
+	
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Transmit a block in DMA mode.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	data
+			bytes to transmit, inside the DMA memory, must remain valid until the block transmitted callback
+	\param	length
+			number of bytes to transmit, at least 1
+	\return true if the transmission started, false if a previous one is still in progress
+*/
+bool uart_transmit_block(int uart_id, const unsigned char* data, unsigned int length)
+{
+	UART_DMA_Data* uart = get_dma_data(uart_id);
+	
+	if (uart_is_dma_tx_busy(uart_id))
+		return false;
+	
+	uart->tx_descriptor.buffer = (void*)data;
+	uart->tx_descriptor.count = length;
+	
+	return uart_transmit_blocks(uart_id, &uart->tx_descriptor, 1);
+}
+
+/**
+	Transmit several blocks in sequence in DMA mode, for instance a header, a payload and a CRC.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	descriptors
+			blocks to transmit, inside the DMA memory; they and the descriptors must remain valid until the block transmitted callback
+	\param	count
+			number of blocks
+	\return true if the transmission started, false if a previous one is still in progress
+*/
+bool uart_transmit_blocks(int uart_id, const DMA_Descriptor* descriptors, unsigned int count)
+{
+	UART_DMA_Data* data = get_dma_data(uart_id);
+	
+	if (data->tx_channel == DMA_CHANNEL_FREE)
+		ERROR_RET_0(UART_ERROR_DMA_NOT_INITIALIZED, &uart_id);
+	
+	if (dma_chain_is_busy(&data->tx_chain))
+		return false;
+	
+	// Force the first byte, as the UART does not request it while idle; it requests the following blocks itself
+	dma_chain_start(&data->tx_chain, data->tx_channel, descriptors, count, false, true, tx_chain_done, data);
+	return true;
+}
+
+/**
+	Return whether a DMA transmission is in progress.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\return true if the last block was not yet transferred to the UART
+*/
+bool uart_is_dma_tx_busy(int uart_id)
+{
+	return dma_chain_is_busy(&get_dma_data(uart_id)->tx_chain);
+}
+
+/*@}*/
@@ -34,6 +34,17 @@
 	\section Usage
 	
 	The usage is the same as the normal uart module. Only the init routine change.
+	Build this file with uart-brg.c, which computes the baud rate generator setting as for the normal uart module.
+	
+	Instead of one call per byte, callbacks can also handle spans of bytes, see uart_init_span():
+	received bytes are passed as contiguous spans of the internal fifo, and bytes to transmit
+	are asked for by blocks filling the hardware fifo. The byte callbacks of uart_init() are adapters over these,
+	but still transmit one byte per interrupt, checking CTS before each byte as before.
+	
+	The internal reception fifo is 32 bytes by default, RTS being raised above half of it.
+	At high baud rates, a larger fifo with distinct high and low watermarks avoids toggling RTS for each byte,
+	see uart_set_fifo(). uart_get_statistics() reports how often RTS was raised and how many bytes were lost,
+	to size the fifo from actual data.
 */
 /*@{*/
 
@@ -49,16 +60,18 @@
 #include <p33fxxxx.h>
 
 #include "uart-software-fc.h"
+#include "uart_priv.h"
 #include "../error/error.h"
 #include "../clock/clock.h"
 #include "../gpio/gpio.h"
 #include "../timer/timer.h"
 
 
-#define FIFO_POWER_SIZE 5
-#define STOP_RX_LEVEL (1 << (FIFO_POWER_SIZE - 1))
-#define FIFO_MASK ((1 << FIFO_POWER_SIZE) - 1)
-#define FIFO_SIZE (1 << FIFO_POWER_SIZE)
+/** Size of the default reception fifo, must be a power of two */
+#define UART_DEFAULT_FIFO_SIZE 32
+
+/** Depth of the hardware transmission fifo */
+#define UART_TX_FIFO_SIZE 4
 
 //-----------------------
 // Structures definitions
@@ -67,19 +80,28 @@
 /** UART wrapper data */
 typedef struct 
 {
-	uart_byte_received byte_received_callback; /**< function to call when a new byte is received */
-	uart_tx_ready tx_ready_callback; /**< function called when a byte has been transmitted */
+	uart_span_received span_received_callback; /**< function to call when new bytes are received */
+	uart_span_tx_ready span_tx_ready_callback; /**< function called when bytes can be transmitted */
+	uart_byte_received byte_received_callback; /**< byte callback adapted by byte_span_received, if initialized with uart_init() */
+	uart_tx_ready tx_ready_callback; /**< byte callback adapted by byte_span_tx_ready, if initialized with uart_init() */
 	bool user_program_busy; /**< true if user program is busy and cannot read any more data, false otherwise */
 	unsigned char bh_ipl; /**< the rx interrupt callback priority level */
 	unsigned char th_ipl; /**< The hardware RX priority level */
 	void* user_data; /**< pointer to user-specified data to be passed in interrupt, may be 0 */
-	unsigned char internal_buffer[FIFO_SIZE]; /**< internal buffer to handle flow control */
+	unsigned char internal_buffer[UART_DEFAULT_FIFO_SIZE]; /**< default fifo storage, if uart_set_fifo() was not called */
+	unsigned char* fifo; /**< fifo storage, to handle flow control */
+	unsigned int fifo_mask; /**< size of the fifo minus one, the size being a power of two */
+	unsigned int high_watermark; /**< fifo level at which RTS is raised */
+	unsigned int low_watermark; /**< fifo level at which RTS is lowered again */
 	// No need to protect the fifo: only 1 write and reader at any time and size of power of 2 used
 	unsigned int fifo_r; /**< Fifo read pointer */
 	unsigned int fifo_w; /**< Fifo write pointer */
+	bool rx_stopped; /**< true if RTS is raised */
+	UART_Statistics statistics; /**< reception counters */
 	gpio cts; /**< CTS line */
 	gpio rts; /**< RTS line */
 	int timer_id;	/**< Timer to poll the RTS line */
+	unsigned int tx_burst; /**< bytes written per transmission interrupt: the hardware fifo size with a span tx callback, 1 with a byte one */
 	int stop_tx; 
 	unsigned int fake_timer;
 } UART_Data;
@@ -92,11 +114,153 @@ static UART_Data UART_2_Data;
 
 
 //-------------------
-// Exported functions
+// Internal functions
 //-------------------
+
 void uart2_timer_cb(int __attribute((unused)) timer_id);
 void uart1_timer_cb(int __attribute((unused)) timer_id);
 
+/** Check baud_rate, and return the baud rate generator value closest to it, see uart_compute_brg() */
+static unsigned int compute_brg(unsigned long baud_rate, bool* high_speed)
+{
+	unsigned long fcy = clock_get_cycle_frequency();
+	
+	if (baud_rate == 0 || baud_rate > fcy / 4)
+		ERROR(UART_ERROR_INVALID_BAUD_RATE, &baud_rate);
+	
+	return uart_compute_brg(fcy, baud_rate, high_speed);
+}
+
+/** Adapter passing a span of received bytes to a byte callback */
+static bool byte_span_received(int uart_id, const unsigned char* data, unsigned int* length, void* user_data)
+{
+	UART_Data* uart = uart_id == UART_1 ? &UART_1_Data : &UART_2_Data;
+	unsigned int i;
+	
+	for (i = 0; i < *length; i++)
+	{
+		// The byte is consumed even if the callback refuses further ones
+		if (uart->byte_received_callback(uart_id, data[i], user_data) == false)
+		{
+			*length = i + 1;
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Adapter asking a byte callback for a span of bytes to transmit */
+static unsigned int byte_span_tx_ready(int uart_id, unsigned char* data, unsigned int length, void* user_data)
+{
+	UART_Data* uart = uart_id == UART_1 ? &UART_1_Data : &UART_2_Data;
+	unsigned int i;
+	
+	for (i = 0; i < length; i++)
+		if (uart->tx_ready_callback(uart_id, &data[i], user_data) == false)
+			break;
+	return i;
+}
+
+/** Return the wrapper data of an UART */
+static UART_Data* get_data(int uart_id)
+{
+	if (uart_id == UART_1)
+		return &UART_1_Data;
+	else if (uart_id == UART_2)
+		return &UART_2_Data;
+	
+	ERROR_RET_0(UART_ERROR_INVALID_ID, &uart_id);
+}
+
+/** Store a received byte in the fifo, and raise RTS at the high watermark; called from the top half */
+static inline void fifo_push(UART_Data* uart, unsigned char data)
+{
+	unsigned int level = uart->fifo_w - uart->fifo_r;
+	
+	if (level > uart->fifo_mask)
+	{
+		// The sender ignored RTS, drop the byte
+		uart->statistics.overruns++;
+		return;
+	}
+	
+	uart->fifo[(uart->fifo_w++) & uart->fifo_mask] = data;
+	level++;
+	if (level > uart->statistics.max_level)
+		uart->statistics.max_level = level;
+	
+	if (level >= uart->high_watermark && !uart->rx_stopped)
+	{
+		gpio_write(uart->rts, true);
+		uart->rx_stopped = true;
+		uart->statistics.rts_assertions++;
+	}
+}
+
+/** Lower RTS if the fifo is below the low watermark; called when reading the fifo */
+static void fifo_restart_rx(UART_Data* uart)
+{
+	int flags;
+	
+	// The top half may raise RTS concurrently
+	RAISE_IPL(flags, uart->th_ipl);
+	if (uart->rx_stopped && uart->fifo_w - uart->fifo_r <= uart->low_watermark)
+	{
+		gpio_write(uart->rts, false);
+		uart->rx_stopped = false;
+	}
+	IRQ_ENABLE(flags);
+}
+
+/** Pass the content of the internal fifo to the user, by contiguous spans.
+	Return false if the user program became busy. */
+static bool deliver_fifo(int uart_id, UART_Data* uart)
+{
+	unsigned int available;
+	unsigned int length;
+	unsigned int start;
+	bool accepted;
+	
+	while ((available = uart->fifo_w - uart->fifo_r) != 0)
+	{
+		// The span stops at the end of the internal buffer
+		start = uart->fifo_r & uart->fifo_mask;
+		length = uart->fifo_mask + 1 - start;
+		if (length > available)
+			length = available;
+		
+		accepted = uart->span_received_callback(uart_id, &uart->fifo[start], &length, uart->user_data);
+		uart->fifo_r += length;
+		
+		fifo_restart_rx(uart);
+		
+		if (!accepted)
+			return false;
+	}
+	return true;
+}
+
+/** Ask the user for up to length bytes and write them to the hardware fifo, which must have room for them */
+static void transmit_span(int uart_id, UART_Data* uart, unsigned int length)
+{
+	unsigned char data[UART_TX_FIFO_SIZE];
+	unsigned int i;
+	
+	length = uart->span_tx_ready_callback(uart_id, data, length, uart->user_data);
+	for (i = 0; i < length; i++)
+	{
+		if (uart_id == UART_1)
+			U1TXREG = data[i];
+		else
+			U2TXREG = data[i];
+	}
+}
+
+
+//-------------------
+// Exported functions
+//-------------------
+
 /**
 	Init an UART subsystem.
 	
@@ -125,6 +289,51 @@ void uart1_timer_cb(int __attribute((unused)) timer_id);
 */
 void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int timer_id, uart_byte_received byte_received_callback, uart_tx_ready tx_ready_callback, int th_priority, int bh_priority, void* user_data)
 {
+	if (uart_id == UART_1)
+	{
+		UART_1_Data.byte_received_callback = byte_received_callback;
+		UART_1_Data.tx_ready_callback = tx_ready_callback;
+	}
+	else if (uart_id == UART_2)
+	{
+		UART_2_Data.byte_received_callback = byte_received_callback;
+		UART_2_Data.tx_ready_callback = tx_ready_callback;
+	}
+	
+	uart_init_span(uart_id, baud_rate, cts, rts, timer_id, byte_span_received, byte_span_tx_ready, th_priority, bh_priority, user_data);
+}
+
+/**
+	Init an UART subsystem, with callbacks handling spans of bytes.
+	
+	The parameters are 8 bits, 1 stop bit, no parity.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	baud_rate
+			baud rate in bps
+	\param  cts
+			The CTS gpio line
+	\param rts
+			The RTS gpio line
+	\param timer_id
+			The timer used to poll the CTS line
+	\param	span_received_callback
+			function to call when new bytes are received
+	\param	span_tx_ready_callback
+			function called when bytes can be transmitted; it is asked for a whole hardware fifo at once,
+			so CTS is only sampled every 4 bytes, see uart_set_fifo()
+	\param  th_priority
+			Hardware fifo read interrupt priority, from bh_priority + 1 to 7 (NMI priority)
+	\param 	bh_priority
+			The callback interrupt priority, from 0 (lowest priority) to 6 (highest normal priority)
+	\param 	user_data
+			Pointer to user-specified data to be passed in interrupt, may be 0
+*/
+void uart_init_span(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int timer_id, uart_span_received span_received_callback, uart_span_tx_ready span_tx_ready_callback, int th_priority, int bh_priority, void* user_data)
+{
+	bool high_speed;
+	
 	ERROR_CHECK_RANGE(th_priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
 	ERROR_CHECK_RANGE(bh_priority, 0, 6, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
 	if(bh_priority >= th_priority) {
@@ -134,35 +343,28 @@ void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int tim
 	if (uart_id == UART_1)
 	{
 		// Store callback functions
-		UART_1_Data.byte_received_callback = byte_received_callback;
-		UART_1_Data.tx_ready_callback = tx_ready_callback;
+		UART_1_Data.span_received_callback = span_received_callback;
+		UART_1_Data.span_tx_ready_callback = span_tx_ready_callback;
+		UART_1_Data.tx_burst = span_tx_ready_callback == byte_span_tx_ready ? 1 : UART_TX_FIFO_SIZE;
 		UART_1_Data.user_data = user_data;
 		UART_1_Data.cts = cts;
 		UART_1_Data.rts = rts;
 		UART_1_Data.timer_id = timer_id;
 		UART_1_Data.th_ipl = th_priority;
 		UART_1_Data.bh_ipl = bh_priority;
+		if (!UART_1_Data.fifo)
+			uart_set_fifo(UART_1, UART_1_Data.internal_buffer, UART_DEFAULT_FIFO_SIZE, UART_DEFAULT_FIFO_SIZE / 2 + 1, UART_DEFAULT_FIFO_SIZE / 2 - 1);
+		UART_1_Data.fifo_r = 0;
+		UART_1_Data.fifo_w = 0;
+		UART_1_Data.rx_stopped = true;
 		
 		gpio_write(rts, true);
 		gpio_set_dir(rts, GPIO_OUTPUT);
 		gpio_set_dir(cts, GPIO_INPUT);
 		
 		// Setup baud rate
-		/*
-		UART high speed mode is buggy on current dsPIC 33, see erratas for details
-		if (baud_rate <= CLOCK_FCY / 16)
-		{
-			U1MODEbits.BRGH = 0;// Low Speed mode
-			U1BRG = (clock_get_cycle_frequency() / baud_rate) / 16 - 1;
-		}
-		else
-		{
-			U1MODEbits.BRGH = 1;// High Speed mode
-			U1BRG = clock_get_cycle_frequency() / (4*baud_rate) - 1;
-		}
-		*/
-		U1MODEbits.BRGH = 0;	// Low Speed mode
-		U1BRG = (clock_get_cycle_frequency()/baud_rate) / 16 - 1;
+		U1BRG = compute_brg(baud_rate, &high_speed);
+		U1MODEbits.BRGH = high_speed;
 		
 		if(baud_rate < 1000) 
 			baud_rate = 1000;
@@ -185,6 +387,10 @@ void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int tim
 		_U1RXIE = 1;			// enable the reception interrupt
 		
 		U1MODEbits.UARTEN = 1;	// Enable UART
+		// With a span callback, interrupt when the transmission fifo becomes empty, so that a whole span can be written;
+		// with a byte callback, when a byte leaves the fifo, so that CTS is checked before each byte
+		U1STAbits.UTXISEL1 = UART_1_Data.tx_burst > 1;
+		U1STAbits.UTXISEL0 = 0;
 		U1STAbits.UTXEN = 1; 	// Enable transmit
 
 		_U1TXIP = bh_priority;   	// set the transmission interrupt priority		
@@ -193,40 +399,34 @@ void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int tim
 	
 	
 		
+		UART_1_Data.rx_stopped = false;
 		gpio_write(rts, false);
 	}
 	else if (uart_id == UART_2)
 	{
 		// Store callback functions
-		UART_2_Data.byte_received_callback = byte_received_callback;
-		UART_2_Data.tx_ready_callback = tx_ready_callback;
+		UART_2_Data.span_received_callback = span_received_callback;
+		UART_2_Data.span_tx_ready_callback = span_tx_ready_callback;
+		UART_2_Data.tx_burst = span_tx_ready_callback == byte_span_tx_ready ? 1 : UART_TX_FIFO_SIZE;
 		UART_2_Data.user_data = user_data;
 		UART_2_Data.cts = cts;
 		UART_2_Data.rts = rts;
 		UART_2_Data.timer_id = timer_id;
 		UART_2_Data.th_ipl = th_priority;
 		UART_2_Data.bh_ipl = bh_priority;
+		if (!UART_2_Data.fifo)
+			uart_set_fifo(UART_2, UART_2_Data.internal_buffer, UART_DEFAULT_FIFO_SIZE, UART_DEFAULT_FIFO_SIZE / 2 + 1, UART_DEFAULT_FIFO_SIZE / 2 - 1);
+		UART_2_Data.fifo_r = 0;
+		UART_2_Data.fifo_w = 0;
+		UART_2_Data.rx_stopped = true;
 		
 		gpio_write(rts, true);
 		gpio_set_dir(rts, GPIO_OUTPUT);
 		gpio_set_dir(cts, GPIO_INPUT);
 		
 		// Setup baud rate
-		/*
-		UART high speed mode is buggy on current dsPIC 33, see erratas for details
-		if (baud_rate <= clock_get_cycle_frequency() / 16)
-		{
-			U2MODEbits.BRGH = 0;// Low Speed mode
-			U2BRG = (clock_get_cycle_frequency() / baud_rate) / 16 - 1;
-		}
-		else
-		{
-			U2MODEbits.BRGH = 1;// High Speed mode
-			U2BRG = clock_get_cycle_frequency() / (4*baud_rate) - 1;
-		}
-		*/
-		U2MODEbits.BRGH = 0;	// Low Speed mode
-		U2BRG = (clock_get_cycle_frequency()/baud_rate) / 16 - 1;
+		U2BRG = compute_brg(baud_rate, &high_speed);
+		U2MODEbits.BRGH = high_speed;
 		
 		if(baud_rate < 1000) 
 			baud_rate = 1000;
@@ -248,12 +448,17 @@ void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int tim
 		_U2RXIE = 1;			// enable the reception interrupt
 		
 		U2MODEbits.UARTEN = 1;	// Enable UART
+		// With a span callback, interrupt when the transmission fifo becomes empty, so that a whole span can be written;
+		// with a byte callback, when a byte leaves the fifo, so that CTS is checked before each byte
+		U2STAbits.UTXISEL1 = UART_2_Data.tx_burst > 1;
+		U2STAbits.UTXISEL0 = 0;
 		U2STAbits.UTXEN = 1; 	// Enable transmit
 		
 		_U2TXIP = bh_priority;  // set the transmission interrupt priority
 		_U2TXIF = 0;			// clear the transmission interrupt
 		_U2TXIE = 1;			// enable the transmission interrupt
 		
+		UART_2_Data.rx_stopped = false;
 		gpio_write(rts, false);
 	}
 	else
@@ -262,6 +467,79 @@ void uart_init(int uart_id, unsigned long baud_rate, gpio cts, gpio rts, int tim
 	}
 }
 
+/**
+	Set the reception fifo of an UART and its flow control watermarks.
+	
+	Call this function before uart_init() or uart_init_span(), otherwise a 32 bytes internal fifo is used,
+	RTS being raised above 16 bytes and lowered below 16 bytes.
+	RTS is raised when the fifo holds high_watermark bytes, and lowered once it is back to low_watermark bytes;
+	the room above high_watermark must hold the bytes the sender transmits before seeing RTS.
+	With byte callbacks, this UART checks CTS before each byte, so it sends at most 1 or 2 bytes once the peer raised it;
+	with a span tx callback, it checks CTS before each burst filling the hardware fifo, so up to 5 bytes.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	buffer
+			fifo storage, owned by the caller
+	\param	size
+			size of buffer, a power of two
+	\param	high_watermark
+			fifo level at which RTS is raised, from 1 to size
+	\param	low_watermark
+			fifo level at which RTS is lowered again, lower than high_watermark
+*/
+void uart_set_fifo(int uart_id, unsigned char* buffer, unsigned int size, unsigned int high_watermark, unsigned int low_watermark)
+{
+	UART_Data* uart = get_data(uart_id);
+	
+	if (size < 2 || (size & (size - 1)))
+		ERROR(UART_ERROR_INVALID_FIFO_SIZE, &size);
+	if (high_watermark == 0 || high_watermark > size || low_watermark >= high_watermark)
+		ERROR(UART_ERROR_INVALID_WATERMARKS, &high_watermark);
+	
+	uart->fifo = buffer;
+	uart->fifo_mask = size - 1;
+	uart->high_watermark = high_watermark;
+	uart->low_watermark = low_watermark;
+}
+
+/**
+	Get the reception counters of an UART.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	statistics
+			structure to fill
+*/
+void uart_get_statistics(int uart_id, UART_Statistics* statistics)
+{
+	UART_Data* uart = get_data(uart_id);
+	int flags;
+	
+	RAISE_IPL(flags, uart->th_ipl);
+	*statistics = uart->statistics;
+	IRQ_ENABLE(flags);
+}
+
+/**
+	Clear the reception counters of an UART.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+*/
+void uart_reset_statistics(int uart_id)
+{
+	UART_Data* uart = get_data(uart_id);
+	int flags;
+	
+	RAISE_IPL(flags, uart->th_ipl);
+	uart->statistics.rts_assertions = 0;
+	uart->statistics.overruns = 0;
+	uart->statistics.framing_errors = 0;
+	uart->statistics.max_level = 0;
+	IRQ_ENABLE(flags);
+}
+
 /**
 	Transmit a byte on UART.
 	
@@ -333,19 +611,8 @@ void uart_read_pending_data(int uart_id)
 			barrier();
 			// It is valid to access the fifo here only because UART_1_Data.user_program_busy == true
 			// So the softirq will not access it concurrently
-			while(UART_1_Data.fifo_w - UART_1_Data.fifo_r)
-			{
-				if (UART_1_Data.byte_received_callback(UART_1, UART_1_Data.internal_buffer[(UART_1_Data.fifo_r++) & FIFO_MASK], UART_1_Data.user_data) == false)
-				{
-					if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
-					return;
-				}
-			}
-			if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
+			if (!deliver_fifo(UART_1, &UART_1_Data))
+				return;
 			UART_1_Data.user_program_busy = false;
 		}
 	}
@@ -356,19 +623,8 @@ void uart_read_pending_data(int uart_id)
 			barrier();
 			// It is valid to access the fifo here only because UART_2_Data.user_program_busy == true
 			// So the softirq will not access it concurrently
-			while(UART_2_Data.fifo_w - UART_2_Data.fifo_r)
-			{
-				if (UART_2_Data.byte_received_callback(UART_2, UART_2_Data.internal_buffer[(UART_2_Data.fifo_r++) & FIFO_MASK], UART_2_Data.user_data) == false)
-				{
-					if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
-					return;
-				}
-			}
-			if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
+			if (!deliver_fifo(UART_2, &UART_2_Data))
+				return;
 			UART_2_Data.user_program_busy = false;
 		}
 	}
@@ -508,14 +764,14 @@ void __attribute((interrupt(preprologue("push w0\n"
 								// Why ? because if we recieve a character
 								// while the callback run, we don't want to get recalled immediatly 
 								// after going out
-		// warning: I do not protect the fifo against overrun, because flow control will not allow us to fill it completly
 		if(U1STAbits.FERR)
+		{
 			// Frame error, grabbage on uart
 			(void *) U1RXREG;
+			UART_1_Data.statistics.framing_errors++;
+		}
 		else
-			UART_1_Data.internal_buffer[(UART_1_Data.fifo_w++) & FIFO_MASK] = U1RXREG;
-		if(UART_1_Data.fifo_w - UART_1_Data.fifo_r > STOP_RX_LEVEL) 
-			gpio_write(UART_1_Data.rts, true);
+			fifo_push(&UART_1_Data, U1RXREG);
 			
 	}
 	
@@ -523,7 +779,10 @@ void __attribute((interrupt(preprologue("push w0\n"
 	// Clear Receive Buffer Overrun Error if any, possible despite the use of hardware handshake
 	
 	if(U1STAbits.OERR)
-		U1STAbits.OERR = 0;	
+	{
+		U1STAbits.OERR = 0;
+		UART_1_Data.statistics.overruns++;
+	}
 	
 	// We are already in the softirq part, avoid recursion
 	if(inside_softirq)
@@ -551,22 +810,8 @@ void __attribute((interrupt(preprologue("push w0\n"
 		
 		if (!UART_1_Data.user_program_busy)
 		{
-			while(UART_1_Data.fifo_w - UART_1_Data.fifo_r)
-			{
-				if (UART_1_Data.byte_received_callback(UART_1, UART_1_Data.internal_buffer[(UART_1_Data.fifo_r++) & FIFO_MASK], UART_1_Data.user_data) == false)
-				{
-					if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
-					
-					UART_1_Data.user_program_busy = true;
-					break;
-				} else {
-					if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
-				}
-			}
+			if (!deliver_fifo(UART_1, &UART_1_Data))
+				UART_1_Data.user_program_busy = true;
 		}
 		
 		
@@ -589,8 +834,6 @@ void __attribute((interrupt(preprologue("push w0\n"
 */
 void _ISR _U1TXInterrupt(void)
 {
-	unsigned char data;
-
 	_U1TXIF = 0;			// Clear transmission interrupt flag
 
 	if(gpio_read(UART_1_Data.cts)) {
@@ -602,8 +845,8 @@ void _ISR _U1TXInterrupt(void)
 		return;
 	}
 
-	while(!U1STAbits.UTXBF && UART_1_Data.tx_ready_callback(UART_1, &data, UART_1_Data.user_data))
-		U1TXREG = data;
+	// The interrupt happens when the hardware fifo has room for a burst
+	transmit_span(UART_1, &UART_1_Data, UART_1_Data.tx_burst);
 }
 
 /** UART 1 TX flow control timer
@@ -612,8 +855,6 @@ void _ISR _U1TXInterrupt(void)
 */
  
 void uart1_timer_cb(int  timer_id) {
-	unsigned char data;
-	
 	if(UART_1_Data.fake_timer) {
 		if(UART_1_Data.fake_timer == 2) 
 			timer_disable_interrupt(timer_id);
@@ -621,22 +862,8 @@ void uart1_timer_cb(int  timer_id) {
 		UART_1_Data.fake_timer = 0;
 		if (!UART_1_Data.user_program_busy)
 		{
-			while(UART_1_Data.fifo_w - UART_1_Data.fifo_r)
-			{
-				if (UART_1_Data.byte_received_callback(UART_1, UART_1_Data.internal_buffer[(UART_1_Data.fifo_r++) & FIFO_MASK], UART_1_Data.user_data) == false)
-				{
-					if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
-					
-					UART_1_Data.user_program_busy = true;
-					break;
-				} else {
-					if(UART_1_Data.fifo_w - UART_1_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_1_Data.rts, false);
-				}
-			}
+			if (!deliver_fifo(UART_1, &UART_1_Data))
+				UART_1_Data.user_program_busy = true;
 		}
 		return;
 	}
@@ -644,8 +871,8 @@ void uart1_timer_cb(int  timer_id) {
 	if(!gpio_read(UART_1_Data.cts)) {
 		// Restart TX
 		if(UART_1_Data.stop_tx)
-			if(!U1STAbits.UTXBF && UART_1_Data.tx_ready_callback(UART_1, &data, UART_1_Data.user_data))
-				U1TXREG = data;
+			if(!U1STAbits.UTXBF)
+				transmit_span(UART_1, &UART_1_Data, U1STAbits.TRMT ? UART_1_Data.tx_burst : 1);
 		
 		timer_disable(UART_1_Data.timer_id);
 		UART_1_Data.stop_tx = 0;	
@@ -675,14 +902,14 @@ void __attribute((interrupt(preprologue("push w0\n"
 								// Why ? because if we recieve a character
 								// while the callback run, we don't want to get recalled immediatly 
 								// after going out
-		// warning: I do not protect the fifo against overrun, because flow control will not allow us to fill it completly
 		if(U2STAbits.FERR)
+		{
 			// Frame error, grabbage on uart
 			(void *) U2RXREG;
+			UART_2_Data.statistics.framing_errors++;
+		}
 		else
-			UART_2_Data.internal_buffer[(UART_2_Data.fifo_w++) & FIFO_MASK] = U2RXREG;
-		if(UART_2_Data.fifo_w - UART_2_Data.fifo_r > STOP_RX_LEVEL) 
-			gpio_write(UART_2_Data.rts, true);
+			fifo_push(&UART_2_Data, U2RXREG);
 			
 	}
 	
@@ -690,7 +917,10 @@ void __attribute((interrupt(preprologue("push w0\n"
 	// Clear Receive Buffer Overrun Error if any, possible despite the use of hardware handshake
 	
 	if(U2STAbits.OERR)
-		U2STAbits.OERR = 0;	
+	{
+		U2STAbits.OERR = 0;
+		UART_2_Data.statistics.overruns++;
+	}
 	
 	// We are already in the softirq part, avoid recursion
 	if(inside_softirq)
@@ -716,22 +946,8 @@ void __attribute((interrupt(preprologue("push w0\n"
 		
 		if (!UART_2_Data.user_program_busy)
 		{
-			while(UART_2_Data.fifo_w - UART_2_Data.fifo_r)
-			{
-				if (UART_2_Data.byte_received_callback(UART_2, UART_2_Data.internal_buffer[(UART_2_Data.fifo_r++) & FIFO_MASK], UART_2_Data.user_data) == false)
-				{
-					if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
-					
-					UART_2_Data.user_program_busy = true;
-					break;
-				} else {
-					if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
-				}
-			}
+			if (!deliver_fifo(UART_2, &UART_2_Data))
+				UART_2_Data.user_program_busy = true;
 		}
 		
 		
@@ -754,8 +970,6 @@ void __attribute((interrupt(preprologue("push w0\n"
 */
 void _ISR _U2TXInterrupt(void)
 {
-	unsigned char data;
-
 	_U2TXIF = 0;			// Clear transmission interrupt flag
 
 	if(gpio_read(UART_2_Data.cts)) {
@@ -767,8 +981,8 @@ void _ISR _U2TXInterrupt(void)
 		return;
 	}
 
-	while(!U2STAbits.UTXBF && UART_2_Data.tx_ready_callback(UART_2, &data, UART_2_Data.user_data))
-		U2TXREG = data;
+	// The interrupt happens when the hardware fifo has room for a burst
+	transmit_span(UART_2, &UART_2_Data, UART_2_Data.tx_burst);
 }
 
 /** UART 2 TX flow control timer
@@ -777,8 +991,6 @@ void _ISR _U2TXInterrupt(void)
 */
  
 void uart2_timer_cb(int __attribute((unused)) timer_id) {
-	unsigned char data;
-	
 	if(UART_2_Data.fake_timer) {
 		if(UART_2_Data.fake_timer == 2) 
 			timer_disable_interrupt(timer_id);
@@ -786,22 +998,8 @@ void uart2_timer_cb(int __attribute((unused)) timer_id) {
 		UART_2_Data.fake_timer = 0;
 		if (!UART_2_Data.user_program_busy)
 		{
-			while(UART_2_Data.fifo_w - UART_2_Data.fifo_r)
-			{
-				if (UART_2_Data.byte_received_callback(UART_2, UART_2_Data.internal_buffer[(UART_2_Data.fifo_r++) & FIFO_MASK], UART_2_Data.user_data) == false)
-				{
-					if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
-					
-					UART_2_Data.user_program_busy = true;
-					break;
-				} else {
-					if(UART_2_Data.fifo_w - UART_2_Data.fifo_r < STOP_RX_LEVEL) 
-						// Restart RX
-						gpio_write(UART_2_Data.rts, false);
-				}
-			}
+			if (!deliver_fifo(UART_2, &UART_2_Data))
+				UART_2_Data.user_program_busy = true;
 		}
 		return;
 	}
@@ -809,8 +1007,8 @@ void uart2_timer_cb(int __attribute((unused)) timer_id) {
 	if(!gpio_read(UART_2_Data.cts)) {
 		// Restart TX
 		if(UART_2_Data.stop_tx)
-			if(!U2STAbits.UTXBF && UART_2_Data.tx_ready_callback(UART_2, &data, UART_2_Data.user_data))
-				U2TXREG = data;
+			if(!U2STAbits.UTXBF)
+				transmit_span(UART_2, &UART_2_Data, U2STAbits.TRMT ? UART_2_Data.tx_burst : 1);
 		timer_disable(UART_2_Data.timer_id);
 		UART_2_Data.stop_tx = 0;
 	}
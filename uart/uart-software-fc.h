@@ -49,6 +49,9 @@ enum uart_errors
 {
 	UART_ERROR_BASE = 0x0600,
 	UART_ERROR_INVALID_ID,			/**< The specified UART does not exists. */
+	UART_ERROR_INVALID_FIFO_SIZE,	/**< The fifo size is not a power of two of at least 2. */
+	UART_ERROR_INVALID_WATERMARKS,	/**< The fifo watermarks are not 0 <= low < high <= size. */
+	UART_ERROR_INVALID_BAUD_RATE,	/**< The baud rate is 0 or higher than the cycle frequency divided by 4. */
 }; 
 
 /** UART callback when a byte is received
@@ -60,6 +63,25 @@ typedef bool (*uart_byte_received)(int uart_id, unsigned char data, void* user_d
 	Return true if there is any data to send, false otherwise. */
 typedef bool (*uart_tx_ready)(int uart_id, unsigned char* data, void* user_data);
 
+/** UART callback when bytes are received, data being a contiguous span of the internal fifo
+	On entry, length is the number of bytes available; on return, it must be the number of bytes consumed.
+	Return true if new data may be accepted later, false otherwise. */
+typedef bool (*uart_span_received)(int uart_id, const unsigned char* data, unsigned int* length, void* user_data);
+
+/** UART callback when tx is available
+	Copy up to length bytes to send into data.
+	Return the number of bytes copied, 0 if there is nothing to send. */
+typedef unsigned int (*uart_span_tx_ready)(int uart_id, unsigned char* data, unsigned int length, void* user_data);
+
+/** Reception counters of an UART */
+typedef struct
+{
+	unsigned long rts_assertions;	/**< number of times RTS was raised because the fifo reached its high watermark */
+	unsigned long overruns;			/**< number of bytes lost, because the hardware or the software fifo was full */
+	unsigned long framing_errors;	/**< number of bytes dropped because of a framing error */
+	unsigned int max_level;			/**< highest fifo level seen */
+} UART_Statistics;
+
 // Functions, doc in the .c
 
 void uart_init(
@@ -75,6 +97,25 @@ void uart_init(
 	void* user_data
 );
 
+void uart_init_span(
+	int uart_id,
+	unsigned long baud_rate,
+	gpio cts,
+	gpio rts,
+	int timer_id,
+	uart_span_received span_received_callback,
+	uart_span_tx_ready span_tx_ready_callback,
+	int th_priority,
+	int bh_priority,
+	void* user_data
+);
+
+void uart_set_fifo(int uart_id, unsigned char* buffer, unsigned int size, unsigned int high_watermark, unsigned int low_watermark);
+
+void uart_get_statistics(int uart_id, UART_Statistics* statistics);
+
+void uart_reset_statistics(int uart_id);
+
 bool uart_transmit_byte(int uart_id, unsigned char data);
 
 void uart_read_pending_data(int uart_id);
@@ -73,6 +73,27 @@ int main(void)
 }
 \endcode
 Note that if flow control is disabled and if data are not read in time, they are silently dropped.
+
+	\section RS-485
+	
+	uart_init_rs485() configures an UART for a half-duplex multi-drop RS-485 bus.
+	The transceiver driver-enable (and receiver-disable) line is a gpio, raised when a byte is written
+	and lowered by the transmission interrupt once the last bit has been shifted out.
+	The UART runs in 9-bit mode: a frame starts with an address byte, sent with uart_transmit_address(),
+	and the address-detect mode of the UART makes a node ignore, without any interrupt,
+	the data bytes of frames addressed to other nodes. Address bytes are not passed to the byte received callback.
+	
+	\section Baud rate
+	
+	uart_init() chooses the baud rate generator setting, in low speed (16 clocks per bit) or high speed (4 clocks per bit) mode,
+	that is the closest to the requested baud rate; low speed is preferred when both are as close, as it samples each bit 3 times.
+	uart_get_baud_rate() returns the baud rate actually obtained and its error, which should stay within 2 % for a reliable link.
+	After uart_start_auto_baud(), the error is relative to the measured rate.
+	If the application runs on a silicon revision whose high speed mode is affected by an errata,
+	define UART_HIGH_SPEED_ERRATA when compiling this library to use the low speed mode only.
+	
+	uart_start_auto_baud() measures the baud rate on the next received byte, which must be a 0x55 synchronization byte.
+	This byte is not passed to the byte received callback, and the measured baud rate is then returned by uart_get_baud_rate().
 */
 /*@{*/
 
@@ -88,6 +109,7 @@ Note that if flow control is disabled and if data are not read in time, they are
 //#include <p33Fxxxx.h>
 
 #include "uart.h"
+#include "uart_priv.h"
 #include "../error/error.h"
 #include "../clock/clock.h"
 
@@ -103,6 +125,11 @@ typedef struct
 	uart_tx_ready tx_ready_callback; /**< function to call when a byte has been transmitted */
 	bool user_program_busy; /**< true if user program is busy and cannot read any more data, false otherwise */
 	void* user_data; /**< pointer to user-specified data to be passed in interrupt, may be 0 */
+	bool rs485; /**< true if in RS-485 mode */
+	gpio de; /**< RS-485 driver-enable line */
+	int address; /**< RS-485 address of this node, or UART_RS485_ANY_ADDRESS */
+	unsigned long baud_rate; /**< baud rate requested in uart_init() */
+	bool auto_baud; /**< true while the baud rate is being measured */
 } UART_Data;
 
 /** data for UART 1 wrapper */
@@ -112,6 +139,33 @@ static UART_Data UART_1_Data;
 static UART_Data UART_2_Data;
 
 
+//-------------------
+// Internal functions
+//-------------------
+
+/** Check baud_rate, and return the baud rate generator value closest to it, see uart_compute_brg() */
+static unsigned int compute_brg(unsigned long baud_rate, bool* high_speed)
+{
+	unsigned long fcy = clock_get_cycle_frequency();
+	
+	if (baud_rate == 0 || baud_rate > fcy / 4)
+		ERROR(UART_ERROR_INVALID_BAUD_RATE, &baud_rate);
+	
+	return uart_compute_brg(fcy, baud_rate, high_speed);
+}
+
+/** An RS-485 address byte was received, listen to the following data bytes only if they are for us */
+static void rs485_address_received(int uart_id, UART_Data* uart, unsigned int data)
+{
+	bool other = uart->address != UART_RS485_ANY_ADDRESS && (int)(data & 0xFF) != uart->address;
+	
+	if (uart_id == UART_1)
+		U1STAbits.ADDEN = other;
+	else
+		U2STAbits.ADDEN = other;
+}
+
+
 //-------------------
 // Exported functions
 //-------------------
@@ -124,7 +178,7 @@ static UART_Data UART_2_Data;
 	\param	uart_id
 			identifier of the UART, \ref UART_1 or \ref UART_2
 	\param	baud_rate
-			baud rate in bps
+			baud rate in bps, the closest achievable one is used, see uart_get_baud_rate()
 	\param	hardware_flow_control
 			wether hardware flow control (CTS/RTS) should be used or not
 	\param	byte_received_callback
@@ -138,6 +192,8 @@ static UART_Data UART_2_Data;
 */
 void uart_init(int uart_id, unsigned long baud_rate, bool hardware_flow_control, uart_byte_received byte_received_callback, uart_tx_ready tx_ready_callback, int priority, void* user_data)
 {
+	bool high_speed;
+	
 	ERROR_CHECK_RANGE(priority, 1, 7, GENERIC_ERROR_INVALID_INTERRUPT_PRIORITY);
 
 	if (uart_id == UART_1)
@@ -146,23 +202,13 @@ void uart_init(int uart_id, unsigned long baud_rate, bool hardware_flow_control,
 		UART_1_Data.byte_received_callback = byte_received_callback;
 		UART_1_Data.tx_ready_callback = tx_ready_callback;
 		UART_1_Data.user_data = user_data;
+		UART_1_Data.rs485 = false;
 		
 		// Setup baud rate
-		/*
-		UART high speed mode is buggy on current dsPIC 33, see erratas for details
-		if (baud_rate <= CLOCK_FCY / 16)
-		{
-			U1MODEbits.BRGH = 0;// Low Speed mode
-			U1BRG = (clock_get_cycle_frequency() / baud_rate) / 16 - 1;
-		}
-		else
-		{
-			U1MODEbits.BRGH = 1;// High Speed mode
-			U1BRG = clock_get_cycle_frequency() / (4*baud_rate) - 1;
-		}
-		*/
-		U1MODEbits.BRGH = 0;	// Low Speed mode
-		U1BRG = (clock_get_cycle_frequency()/baud_rate) / 16 - 1;
+		UART_1_Data.baud_rate = baud_rate;
+		UART_1_Data.auto_baud = false;
+		U1BRG = compute_brg(baud_rate, &high_speed);
+		U1MODEbits.BRGH = high_speed;
 		
 		// Setup other parameters
 		U1MODEbits.USIDL = 0;	// Continue module operation in idle mode
@@ -192,23 +238,13 @@ void uart_init(int uart_id, unsigned long baud_rate, bool hardware_flow_control,
 		UART_2_Data.byte_received_callback = byte_received_callback;
 		UART_2_Data.tx_ready_callback = tx_ready_callback;
 		UART_2_Data.user_data = user_data;
+		UART_2_Data.rs485 = false;
 		
 		// Setup baud rate
-		/*
-		UART high speed mode is buggy on current dsPIC 33, see erratas for details
-		if (baud_rate <= clock_get_cycle_frequency() / 16)
-		{
-			U2MODEbits.BRGH = 0;// Low Speed mode
-			U2BRG = (clock_get_cycle_frequency() / baud_rate) / 16 - 1;
-		}
-		else
-		{
-			U2MODEbits.BRGH = 1;// High Speed mode
-			U2BRG = clock_get_cycle_frequency() / (4*baud_rate) - 1;
-		}
-		*/
-		U2MODEbits.BRGH = 0;	// Low Speed mode
-		U2BRG = (clock_get_cycle_frequency()/baud_rate) / 16 - 1;
+		UART_2_Data.baud_rate = baud_rate;
+		UART_2_Data.auto_baud = false;
+		U2BRG = compute_brg(baud_rate, &high_speed);
+		U2MODEbits.BRGH = high_speed;
 		
 		// Setup other parameters
 		U2MODEbits.USIDL = 0;	// Continue module operation in idle mode
@@ -240,6 +276,194 @@ void uart_init(int uart_id, unsigned long baud_rate, bool hardware_flow_control,
 	}
 }
 
+/**
+	Init an UART subsystem in RS-485 half-duplex mode.
+	
+	The parameters are 9 bits, 1 stop bit, no parity, the ninth bit marking address bytes.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	baud_rate
+			baud rate in bps
+	\param	de
+			gpio driving the driver-enable line of the transceiver, high when transmitting
+	\param	address
+			address of this node, from 0 to 255; only the data bytes following this address are received.
+			If \ref UART_RS485_ANY_ADDRESS, all data bytes are received.
+	\param	byte_received_callback
+			function to call when a new data byte is received
+	\param  tx_ready_callback
+			function to call when a byte has been transmitted
+	\param 	priority
+			Interrupt priority, from 1 (lowest priority) to 6 (highest normal priority)
+	\param 	user_data
+			Pointer to user-specified data to be passed in interrupt, may be 0
+*/
+void uart_init_rs485(int uart_id, unsigned long baud_rate, gpio de, int address, uart_byte_received byte_received_callback, uart_tx_ready tx_ready_callback, int priority, void* user_data)
+{
+	UART_Data* uart;
+	
+	if (address != UART_RS485_ANY_ADDRESS)
+		ERROR_CHECK_RANGE(address, 0, 255, UART_ERROR_INVALID_ADDRESS);
+	
+	// Receive while idle
+	gpio_write(de, false);
+	gpio_set_dir(de, GPIO_OUTPUT);
+	
+	uart_init(uart_id, baud_rate, false, byte_received_callback, tx_ready_callback, priority, user_data);
+	
+	if (uart_id == UART_1)
+	{
+		uart = &UART_1_Data;
+		U1MODEbits.UARTEN = 0;	// Disable UART to change the data format
+		U1MODEbits.PDSEL = 3;	// No Parity, 9-data bits
+		U1STAbits.ADDEN = address != UART_RS485_ANY_ADDRESS;	// Wait for our address
+		U1MODEbits.UARTEN = 1;	// Enable UART
+		U1STAbits.UTXEN = 1; 	// Enable transmit
+	}
+	else
+	{
+		uart = &UART_2_Data;
+		U2MODEbits.UARTEN = 0;	// Disable UART to change the data format
+		U2MODEbits.PDSEL = 3;	// No Parity, 9-data bits
+		U2STAbits.ADDEN = address != UART_RS485_ANY_ADDRESS;	// Wait for our address
+		U2MODEbits.UARTEN = 1;	// Enable UART
+		U2STAbits.UTXEN = 1; 	// Enable transmit
+	}
+	
+	uart->de = de;
+	uart->address = address;
+	uart->rs485 = true;
+}
+
+/**
+	Transmit an RS-485 address byte, starting a frame for that node.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2, initialized with uart_init_rs485()
+	\param	address
+			address of the destination node
+	\return true if byte was transmitted, false if transmit buffer was full
+*/
+bool uart_transmit_address(int uart_id, unsigned char address)
+{
+	if (uart_id == UART_1)
+	{
+		if (!UART_1_Data.rs485)
+			ERROR_RET_0(UART_ERROR_NOT_RS485, &uart_id);
+		if (U1STAbits.UTXBF)
+			return false;
+		
+		gpio_write(UART_1_Data.de, true);
+		U1TXREG = UART_RS485_ADDRESS_FLAG | address;
+		return true;
+	}
+	else if (uart_id == UART_2)
+	{
+		if (!UART_2_Data.rs485)
+			ERROR_RET_0(UART_ERROR_NOT_RS485, &uart_id);
+		if (U2STAbits.UTXBF)
+			return false;
+		
+		gpio_write(UART_2_Data.de, true);
+		U2TXREG = UART_RS485_ADDRESS_FLAG | address;
+		return true;
+	}
+	else
+	{
+		ERROR_RET_0(UART_ERROR_INVALID_ID, &uart_id);
+	}
+}
+
+/**
+	Get the baud rate actually used by an UART.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\param	error
+			if not 0, filled with the error relative to the baud rate passed to uart_init(), or measured by the last
+			uart_start_auto_baud(), in hundredths of percent, saturated to INT_MIN or INT_MAX
+	\return the baud rate in bps, as set by uart_init() or measured by uart_start_auto_baud()
+*/
+unsigned long uart_get_baud_rate(int uart_id, int* error)
+{
+	unsigned long divider;
+	unsigned long baud_rate;
+	unsigned long requested;
+	
+	if (uart_id == UART_1)
+	{
+		divider = (U1BRG + 1UL) * (U1MODEbits.BRGH ? 4 : 16);
+		requested = UART_1_Data.baud_rate;
+	}
+	else if (uart_id == UART_2)
+	{
+		divider = (U2BRG + 1UL) * (U2MODEbits.BRGH ? 4 : 16);
+		requested = UART_2_Data.baud_rate;
+	}
+	else
+	{
+		ERROR_RET_0(UART_ERROR_INVALID_ID, &uart_id);
+	}
+	
+	baud_rate = (clock_get_cycle_frequency() + divider / 2) / divider;
+	if (error)
+		*error = uart_relative_error(baud_rate, requested);
+	
+	return baud_rate;
+}
+
+/**
+	Measure the baud rate on the next received byte.
+	
+	The remote device must send a 0x55 synchronization byte, which is not passed to the byte received callback.
+	The baud rate generator is set by the hardware from the measure, keeping the speed mode chosen by uart_init().
+	Bytes received until then are dropped.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+*/
+void uart_start_auto_baud(int uart_id)
+{
+	if (uart_id == UART_1)
+	{
+		UART_1_Data.auto_baud = true;
+		U1MODEbits.ABAUD = 1;
+	}
+	else if (uart_id == UART_2)
+	{
+		UART_2_Data.auto_baud = true;
+		U2MODEbits.ABAUD = 1;
+	}
+	else
+	{
+		ERROR(UART_ERROR_INVALID_ID, &uart_id);
+	}
+}
+
+/**
+	Return whether the baud rate is still being measured.
+	
+	\param	uart_id
+			identifier of the UART, \ref UART_1 or \ref UART_2
+	\return true until the synchronization byte requested by uart_start_auto_baud() has been received
+*/
+bool uart_is_auto_baud_pending(int uart_id)
+{
+	if (uart_id == UART_1)
+	{
+		return UART_1_Data.auto_baud;
+	}
+	else if (uart_id == UART_2)
+	{
+		return UART_2_Data.auto_baud;
+	}
+	else
+	{
+		ERROR_RET_0(UART_ERROR_INVALID_ID, &uart_id);
+	}
+}
+
 /**
 	Transmit a byte on UART.
 	
@@ -256,6 +480,8 @@ bool uart_transmit_byte(int uart_id, unsigned char data)
 		if (U1STAbits.UTXBF)
 			return false;
 		
+		if (UART_1_Data.rs485)
+			gpio_write(UART_1_Data.de, true);
 		U1TXREG = data;
 		return true;
 	}
@@ -263,7 +489,9 @@ bool uart_transmit_byte(int uart_id, unsigned char data)
 	{
 		if (U2STAbits.UTXBF)
 			return false;
-	
+		
+		if (UART_2_Data.rs485)
+			gpio_write(UART_2_Data.de, true);
 		U2TXREG = data;
 		return true;
 	}
@@ -281,13 +509,18 @@ bool uart_transmit_byte(int uart_id, unsigned char data)
 */
 void uart_read_pending_data(int uart_id)
 {
+	unsigned int data;
+	
 	if (uart_id == UART_1)
 	{
 		if (UART_1_Data.user_program_busy)
 		{
 			while (U1STAbits.URXDA)
 			{
-				if (UART_1_Data.byte_received_callback(UART_1, U1RXREG, UART_1_Data.user_data) == false)
+				data = U1RXREG;
+				if (UART_1_Data.rs485 && (data & UART_RS485_ADDRESS_FLAG))
+					rs485_address_received(UART_1, &UART_1_Data, data);
+				else if (UART_1_Data.byte_received_callback(UART_1, data, UART_1_Data.user_data) == false)
 					return;
 			}
 			UART_1_Data.user_program_busy = false;
@@ -299,7 +532,10 @@ void uart_read_pending_data(int uart_id)
 		{
 			while (U2STAbits.URXDA)
 			{
-				if (UART_2_Data.byte_received_callback(UART_2, U2RXREG, UART_2_Data.user_data) == false)
+				data = U2RXREG;
+				if (UART_2_Data.rs485 && (data & UART_RS485_ADDRESS_FLAG))
+					rs485_address_received(UART_2, &UART_2_Data, data);
+				else if (UART_2_Data.byte_received_callback(UART_2, data, UART_2_Data.user_data) == false)
 					return;
 			}
 			UART_2_Data.user_program_busy = false;
@@ -373,7 +609,23 @@ void uart_enable_tx_interrupt(int uart_id, int flags) {
 */
 void _ISR _U1RXInterrupt(void)
 {
+	unsigned int data;
+	
 	_U1RXIF = 0;			// Clear reception interrupt flag
+	if (UART_1_Data.auto_baud)
+	{
+		// Drop the synchronization byte, the measure is done when the hardware clears ABAUD
+		while (U1STAbits.URXDA)
+			(void) U1RXREG;
+		U1STAbits.OERR = 0;
+		if (!U1MODEbits.ABAUD)
+		{
+			// The measured rate is the reference of the error returned by uart_get_baud_rate() from now on
+			UART_1_Data.baud_rate = uart_get_baud_rate(UART_1, 0);
+			UART_1_Data.auto_baud = false;
+		}
+		return;
+	}
 	if (!UART_1_Data.user_program_busy)
 	{
 		while(U1STAbits.URXDA)
@@ -386,11 +638,16 @@ void _ISR _U1RXInterrupt(void)
 				// Frame error, grabbage on uart
 				(void *) U1RXREG;
 			else
-				if (UART_1_Data.byte_received_callback(UART_1, U1RXREG, UART_1_Data.user_data) == false)
+			{
+				data = U1RXREG;
+				if (UART_1_Data.rs485 && (data & UART_RS485_ADDRESS_FLAG))
+					rs485_address_received(UART_1, &UART_1_Data, data);
+				else if (UART_1_Data.byte_received_callback(UART_1, data, UART_1_Data.user_data) == false)
 				{
 					UART_1_Data.user_program_busy = true;
 					break;
 				}
+			}
 		}
 		// Work around for the dsPIC33 Rev. A2 Silicon Errata
 		// Clear Receive Buffer Overrun Error if any, possible despite the use of hardware handshake
@@ -412,7 +669,21 @@ void _ISR _U1TXInterrupt(void)
 	_U1TXIF = 0;			// Clear transmission interrupt flag
 
 	if (UART_1_Data.tx_ready_callback(UART_1, &data, UART_1_Data.user_data))
+	{
+		if (UART_1_Data.rs485)
+		{
+			gpio_write(UART_1_Data.de, true);
+			U1STAbits.UTXISEL0 = 0;	// Interrupt when there is room in the fifo
+		}
 		U1TXREG = data;
+	}
+	else if (UART_1_Data.rs485)
+	{
+		// Release the bus once the last bit has been shifted out
+		U1STAbits.UTXISEL0 = 1;	// Interrupt when the transmission is complete
+		if (U1STAbits.TRMT)
+			gpio_write(UART_1_Data.de, false);
+	}
 }
 
 /**
@@ -422,8 +693,23 @@ void _ISR _U1TXInterrupt(void)
 */
 void _ISR _U2RXInterrupt(void)
 {
+	unsigned int data;
+	
 	_U2RXIF = 0;			// Clear reception interrupt flag
-
+	if (UART_2_Data.auto_baud)
+	{
+		// Drop the synchronization byte, the measure is done when the hardware clears ABAUD
+		while (U2STAbits.URXDA)
+			(void) U2RXREG;
+		U2STAbits.OERR = 0;
+		if (!U2MODEbits.ABAUD)
+		{
+			// The measured rate is the reference of the error returned by uart_get_baud_rate() from now on
+			UART_2_Data.baud_rate = uart_get_baud_rate(UART_2, 0);
+			UART_2_Data.auto_baud = false;
+		}
+		return;
+	}
 	if (!UART_2_Data.user_program_busy)
 	{
 		while(U2STAbits.URXDA)
@@ -436,11 +722,16 @@ void _ISR _U2RXInterrupt(void)
 				// Frame error, grabbage on uart
 				(void *) U2RXREG;
 			else
-				if (UART_2_Data.byte_received_callback(UART_2, U2RXREG, UART_2_Data.user_data) == false)
+			{
+				data = U2RXREG;
+				if (UART_2_Data.rs485 && (data & UART_RS485_ADDRESS_FLAG))
+					rs485_address_received(UART_2, &UART_2_Data, data);
+				else if (UART_2_Data.byte_received_callback(UART_2, data, UART_2_Data.user_data) == false)
 				{
 					UART_2_Data.user_program_busy = true;
 					break;
 				}
+			}
 		}
 		// Work around for the dsPIC33 Rev. A2 Silicon Errata
 		// Clear Receive Buffer Overrun Error if any, possible despite the use of hardware handshake
@@ -462,7 +753,21 @@ void _ISR _U2TXInterrupt(void)
 	_U2TXIF = 0;			// Clear transmission interrupt flag
 
 	if (UART_2_Data.tx_ready_callback(UART_2, &data, UART_2_Data.user_data))
+	{
+		if (UART_2_Data.rs485)
+		{
+			gpio_write(UART_2_Data.de, true);
+			U2STAbits.UTXISEL0 = 0;	// Interrupt when there is room in the fifo
+		}
 		U2TXREG = data;
+	}
+	else if (UART_2_Data.rs485)
+	{
+		// Release the bus once the last bit has been shifted out
+		U2STAbits.UTXISEL0 = 1;	// Interrupt when the transmission is complete
+		if (U2STAbits.TRMT)
+			gpio_write(UART_2_Data.de, false);
+	}
 }
 
 
@@ -26,6 +26,8 @@
 #define _MOLOLE_UART_H
 
 #include "../types/types.h"
+#include "../dma/dma.h"
+#include "../gpio/gpio.h"
 
 /** \addtogroup uart */
 /*@{*/
@@ -48,9 +50,20 @@ enum uart_errors
 {
 	UART_ERROR_BASE = 0x0600,
 	UART_ERROR_INVALID_ID,			/**< The specified UART does not exists. */
+	UART_ERROR_INVALID_BUFFER_SIZE,	/**< The DMA reception buffer size is not an even number of at least 2 bytes. */
+	UART_ERROR_DMA_NOT_INITIALIZED,	/**< uart_init_dma() was not called, or without the required DMA channel. */
+	UART_ERROR_INVALID_ADDRESS,		/**< The RS-485 address is not from 0 to 255, nor UART_RS485_ANY_ADDRESS. */
+	UART_ERROR_INVALID_BAUD_RATE,	/**< The baud rate is 0 or higher than the cycle frequency divided by 4. */
+	UART_ERROR_NOT_RS485,			/**< The UART was not initialized with uart_init_rs485(). */
 }; 
 
 
+/** RS-485 address meaning that all frames are received */
+#define UART_RS485_ANY_ADDRESS -1
+
+/** Ninth bit, marking RS-485 address bytes */
+#define UART_RS485_ADDRESS_FLAG 0x100
+
 /** UART callback when a byte is received
 	Return true if new data is accepted, false otherwise. */
 typedef bool (*uart_byte_received)(int uart_id, unsigned char data, void* user_data);
@@ -59,6 +72,13 @@ typedef bool (*uart_byte_received)(int uart_id, unsigned char data, void* user_d
 	Return true if a new one should be sent, false otherwise. */
 typedef bool (*uart_tx_ready)(int uart_id, unsigned char* data, void* user_data);
 
+/** UART callback when a block of data is received
+	The data are valid only during the call. */
+typedef void (*uart_block_received)(int uart_id, const unsigned char* data, unsigned int length, void* user_data);
+
+/** UART callback when a block of data has been transmitted */
+typedef void (*uart_block_transmitted)(int uart_id, void* user_data);
+
 // Functions, doc in the .c
 
 void uart_init(
@@ -71,14 +91,55 @@ void uart_init(
 	void* user_data
 );
 
+void uart_init_rs485(
+	int uart_id,
+	unsigned long baud_rate,
+	gpio de,
+	int address,
+	uart_byte_received byte_received_callback,
+	uart_tx_ready tx_ready_callback,
+	int priority,
+	void* user_data
+);
+
+unsigned long uart_get_baud_rate(int uart_id, int* error);
+
+void uart_start_auto_baud(int uart_id);
+
+bool uart_is_auto_baud_pending(int uart_id);
+
 bool uart_transmit_byte(int uart_id, unsigned char data);
 
+bool uart_transmit_address(int uart_id, unsigned char address);
+
 void uart_read_pending_data(int uart_id);
 
 void uart_enable_tx_interrupt(int uart_id, int flags);
 
 int uart_disable_tx_interrupt(int uart_id);
 
+void uart_init_dma(
+	int uart_id,
+	unsigned long baud_rate,
+	bool hardware_flow_control,
+	int rx_dma_channel,
+	unsigned char* rx_buffer,
+	unsigned int rx_buffer_size,
+	uart_block_received block_received_callback,
+	int tx_dma_channel,
+	uart_block_transmitted block_transmitted_callback,
+	int priority,
+	void* user_data
+);
+
+void uart_flush_dma_rx(int uart_id);
+
+bool uart_transmit_block(int uart_id, const unsigned char* data, unsigned int length);
+
+bool uart_transmit_blocks(int uart_id, const DMA_Descriptor* descriptors, unsigned int count);
+
+bool uart_is_dma_tx_busy(int uart_id);
+
 
 /*@}*/
 
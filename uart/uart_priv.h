@@ -0,0 +1,11 @@
+#ifndef _UART_PRIV_H
+#define _UART_PRIV_H
+
+#include "../types/types.h"
+
+// Helper function, shared between the UART drivers
+unsigned int uart_compute_brg(unsigned long fcy, unsigned long baud_rate, bool* high_speed);
+
+int uart_relative_error(unsigned long baud_rate, unsigned long reference);
+
+#endif // _UART_PRIV_H